@@ -0,0 +1,44 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef ARDUINOPLATFORM_H
+#define ARDUINOPLATFORM_H
+
+#include <Arduino.h>
+#include <SoftwareSerial.h>
+#include "SETransport.h"
+
+class ArduinoClock : public SEClock
+{
+public:
+    unsigned long Millis() override;
+    unsigned long Micros() override;
+};
+
+class SoftwareSerialTransport : public SETransport
+{
+private:
+    SoftwareSerial Port;
+
+public:
+    SoftwareSerialTransport(uint8_t rxPin, uint8_t txPin, unsigned long baud);
+    int Available() override;
+    int Read() override;
+    size_t Write(const uint8_t *buffer, size_t length) override;
+};
+
+// One file on LittleFS, which spreads the writes over the flash. LittleFS.begin() must have been called.
+class LittleFSStorage : public SEStorage
+{
+private:
+    char Path[32];
+
+public:
+    explicit LittleFSStorage(const char *path);
+    size_t Load(uint8_t *buffer, size_t size) override;
+    bool Save(const uint8_t *buffer, size_t length) override;
+};
+
+#endif
@@ -0,0 +1,87 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef CONNECTIONMANAGER_H
+#define CONNECTIONMANAGER_H
+
+#include <Arduino.h>
+#include "MqttBridge.h"
+#include "ReconnectBackoff.h"
+
+// A WiFi association that does not complete within this time counts as failed.
+#define WIFI_CONNECT_TIMEOUT_MILLIS 15000
+#define WIFI_BACKOFF_MIN_MILLIS 1000
+#define WIFI_BACKOFF_MAX_MILLIS 60000
+#define MQTT_BACKOFF_MIN_MILLIS 1000
+#define MQTT_BACKOFF_MAX_MILLIS 60000
+// One broker connection per SEC-Touch unit.
+#define CONNECTION_MAX_MQTT_BRIDGES 4
+
+enum ConnectionState : uint8_t
+{
+    CONNECTION_DOWN,
+    CONNECTION_CONNECTING,
+    CONNECTION_UP
+};
+
+struct ConnectionStats
+{
+    unsigned long Attempts;
+    unsigned long Connects;
+    unsigned long Disconnects;
+    unsigned long DownMillis; // completed outages; see ConnectionManager::GetDownMillis()
+    unsigned long DownSinceMillis;
+};
+
+// Keeps WiFi and the MQTT broker connected without ever waiting in a loop:
+// Poll() advances one state machine step per link and returns, so the main
+// loop keeps servicing the SEC-Touch at full rate through network outages.
+// With several bridges, at most one of them runs a connection step per Poll().
+class ConnectionManager
+{
+private:
+    const char *Hostname;
+    const char *Ssid;
+    const char *Password;
+    struct MqttLink
+    {
+        MqttBridge *Bridge;
+        ConnectionState State;
+        ConnectionStats Stats;
+        ReconnectBackoff Backoff;
+
+        MqttLink(MqttBridge *bridge, uint32_t seed);
+    };
+
+    MqttLink *Mqtt[CONNECTION_MAX_MQTT_BRIDGES];
+    uint8_t MqttCount = 0;
+
+    ConnectionState WiFiState = CONNECTION_DOWN;
+    ConnectionStats WiFiStats;
+    ReconnectBackoff WiFiBackoff;
+    unsigned long WiFiAttemptMillis = 0;
+    bool WiFiStarted = false;
+
+    void SetWiFiState(ConnectionState state, unsigned long nowMillis);
+    void SetMqttState(uint8_t bridge, ConnectionState state, unsigned long nowMillis);
+    void PollWiFi(unsigned long nowMillis);
+    void PollMqtt(unsigned long nowMillis);
+
+public:
+    ConnectionManager(const char *hostname, const char *ssid, const char *password);
+    // Returns false if all CONNECTION_MAX_MQTT_BRIDGES are taken.
+    bool AddMqttBridge(MqttBridge *mqtt);
+    void Poll();
+
+    bool IsWiFiConnected() const { return WiFiState == CONNECTION_UP; }
+    size_t GetMqttCount() const { return MqttCount; }
+    bool IsMqttConnected(size_t bridge) const { return Mqtt[bridge]->State == CONNECTION_UP; }
+    const ConnectionStats &GetWiFiStats() const { return WiFiStats; }
+    const ConnectionStats &GetMqttStats(size_t bridge) const { return Mqtt[bridge]->Stats; }
+    // Total time the link has been down, including a running outage.
+    unsigned long GetDownMillis(const ConnectionStats &stats, bool isUp) const;
+};
+
+#endif
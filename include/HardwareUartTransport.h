@@ -0,0 +1,42 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef HARDWAREUARTTRANSPORT_H
+#define HARDWAREUARTTRANSPORT_H
+
+#include <Arduino.h>
+#include "SERingBuffer.h"
+#include "SETransport.h"
+
+#define HARDWARE_UART_RX_BUFFER_SIZE 512
+#define HARDWARE_UART_RX_FIFO_THRESHOLD 16
+#define HARDWARE_UART_RX_TIMEOUT_BYTES 2
+
+// UART0 with its pins swapped to GPIO13 (RX, D7) and GPIO15 (TX, D8). The
+// receive interrupt moves the hardware FIFO into a lock-free ring buffer, so
+// bytes are never lost to WiFi or MQTT work in loop(). UART0 is taken over
+// completely: Serial must not be used while this transport is active.
+class HardwareUartTransport : public SETransport
+{
+private:
+    SERingBuffer<HARDWARE_UART_RX_BUFFER_SIZE> RxBuffer;
+    volatile uint32_t FifoOverflows = 0;
+
+    static void HandleInterrupt(void *arg, void *frame);
+
+public:
+    explicit HardwareUartTransport(unsigned long baud);
+    ~HardwareUartTransport();
+
+    int Available() override;
+    int Read() override;
+    size_t ReadBytes(uint8_t *buffer, size_t length) override;
+    size_t Write(const uint8_t *buffer, size_t length) override;
+
+    // Receive overruns: bytes the ring buffer had to drop plus hardware FIFO overflows.
+    uint32_t DroppedBytes() const;
+};
+
+#endif
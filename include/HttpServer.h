@@ -0,0 +1,204 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef HTTPSERVER_H
+#define HTTPSERVER_H
+
+#include <ESP8266WiFi.h>
+#include <functional>
+#include <pgmspace.h>
+#include "JsonWriter.h"
+
+// Connections served at the same time, open event streams included.
+#define HTTP_CONNECTIONS_MAX 6
+// Request line, kept header values and form body of one request.
+#define HTTP_REQUEST_LENGTH 256
+// Response head, one piece of the body and the chunk framing around it.
+#define HTTP_OUTPUT_LENGTH 512
+#define HTTP_HANDLERS_MAX 16
+// Request headers a handler can read, see HttpServer::CollectHeader().
+#define HTTP_HEADERS_MAX 2
+// Bytes taken from one connection per Poll(), so a fast sender cannot hold up the loop.
+#define HTTP_READ_PER_POLL 512
+#define HTTP_REQUEST_TIMEOUT_MILLIS 3000 // first byte until the request is complete
+#define HTTP_KEEPALIVE_MILLIS 5000       // idle connection between two requests
+#define HTTP_SEND_TIMEOUT_MILLIS 5000    // response without progress
+// WiFiClient::stop() waits this long for the peer to acknowledge; lwIP still sends what is left.
+#define HTTP_CLOSE_WAIT_MILLIS 1
+
+enum HttpMethod : uint8_t
+{
+    HTTP_METHOD_ANY,
+    HTTP_METHOD_GET,
+    HTTP_METHOD_POST,
+    HTTP_METHOD_OTHER
+};
+
+enum HttpState : uint8_t
+{
+    HTTP_STATE_FREE,
+    HTTP_STATE_HEAD,     // request line and headers, or idle between two requests
+    HTTP_STATE_BODY,     // form body after Content-Length
+    HTTP_STATE_RESPONSE, // sending, see HttpBody
+    HTTP_STATE_STREAM    // event stream, see HttpServer::Broadcast()
+};
+
+enum HttpBody : uint8_t
+{
+    HTTP_BODY_BUFFERED, // head and body are in the output buffer
+    HTTP_BODY_FLASH,    // copied from flash piece by piece
+    HTTP_BODY_ITEMS     // produced by an item writer, chunked
+};
+
+struct HttpServerStats
+{
+    unsigned long Accepted;
+    unsigned long Rejected; // all connections busy, answered with 503
+    unsigned long Requests;
+    unsigned long KeepAliveRequests; // on a connection that served a request before
+    unsigned long Timeouts;
+    unsigned long BadRequests; // malformed or too large
+    unsigned long StreamsDropped; // event stream closed or too slow to take an event
+    uint32_t HeapPerConnection; // heap freed by the last closed connection
+    uint32_t LastResponseMicros; // head queued until the last byte was handed to TCP
+    uint32_t MaxResponseMicros;
+};
+
+// Writes item number item of a response body into out and returns false if
+// there is no such item. An item must fit into the output buffer; a writer
+// may also write nothing for an item it skips.
+typedef std::function<bool(JsonWriter &out, uint32_t item)> HttpItemWriter;
+
+// One request on a connection, handed to the handler. The handler only
+// queues the response; it is sent from HttpServer::Poll() as fast as the
+// client takes it.
+class HttpConnection
+{
+    friend class HttpServer;
+
+private:
+    WiFiClient Client;
+    HttpState State = HTTP_STATE_FREE;
+    HttpMethod Method = HTTP_METHOD_OTHER;
+    bool Http11 = false;
+    bool KeepAlive = false;
+    bool Skipping = false; // rest of a header line that did not fit
+    bool FormBody = false;
+    bool RequestLine = true;
+    uint8_t Requests = 0;
+    char Request[HTTP_REQUEST_LENGTH];
+    uint16_t RequestLength = 0; // stored fields; the line being read follows
+    uint16_t LineLength = 0;
+    uint16_t QueryOffset = 0; // 0: no query
+    uint16_t BodyOffset = 0;  // 0: no body
+    uint16_t BodyLength = 0;
+    uint16_t ContentLength = 0;
+    uint16_t HeaderOffsets[HTTP_HEADERS_MAX];
+    const char *const *HeaderNames = NULL;
+    uint8_t HeaderCount = 0;
+    unsigned long StartMillis = 0; // accept, last response or first byte of the request
+    unsigned long ProgressMillis = 0;
+    uint32_t ResponseMicros = 0; // head queued
+    uint32_t FreeHeapAtAccept = 0;
+
+    char Output[HTTP_OUTPUT_LENGTH];
+    uint16_t OutputStart = 0;
+    uint16_t OutputEnd = 0;
+    HttpBody Body = HTTP_BODY_BUFFERED;
+    bool Chunked = false;
+    bool BodyDone = true;
+    bool Broken = false; // an item did not fit; the response cannot be completed
+    PGM_P Flash = NULL;
+    size_t FlashRemaining = 0;
+    HttpItemWriter Items;
+    uint32_t Item = 0;
+    JsonWriter Writer;
+    bool WriterOpen = false;
+
+    void Open(WiFiClient &client, const char *const *headerNames, uint8_t headerCount);
+    void StartRequest();
+    bool IsIdle() const; // waiting for the first byte of a request
+    void ReadLine(char *line, size_t length);
+    bool Read(); // true when a request is complete and has no response yet
+    const char *FindArg(const char *text, const char *name) const;
+    bool WriteHead(int code, const char *contentType, long contentLength, const char *headers);
+    void Refill();
+    bool SendOutput(); // false when the connection broke
+    void Fail(int code);
+
+public:
+    HttpConnection();
+
+    HttpMethod GetMethod() const { return Method; }
+    const char *GetPath() const { return Request; }
+    bool HasArg(const char *name) const;
+    // URL-decoded value from the query or the form body; false if missing or longer than size.
+    bool GetArg(const char *name, char *value, size_t size) const;
+    long GetArgNumber(const char *name) const; // 0 if missing
+    // Only headers named in HttpServer::CollectHeader() are kept; "" otherwise.
+    const char *GetHeader(const char *name) const;
+
+    // The body is copied; together with the head it has to fit into the output buffer.
+    // headers are extra header lines, each ending in \r\n.
+    void Send(int code, const char *contentType, const char *body, const char *headers = NULL);
+    void SendFlash(int code, const char *contentType, PGM_P body, size_t length, const char *headers = NULL);
+    // Chunked body from items 0, 1, ... until the writer returns false; one JSON
+    // document can span several items.
+    void SendItems(int code, const char *contentType, HttpItemWriter items);
+    // Keeps the connection for Server-Sent Events after the head.
+    void BeginEventStream();
+};
+
+// HTTP/1.1 server that never waits: Poll() accepts at most one connection,
+// reads what has arrived, runs handlers for complete requests and writes
+// only as much as the TCP send buffer takes. All memory is in the fixed
+// connection table. Idle connections stay open for the next request; when
+// all are taken, the one idle for longest is closed for a new client, or
+// the new client gets a 503. Pipelined requests are not supported: such a
+// connection is closed after the first response.
+class HttpServer
+{
+public:
+    typedef std::function<void(HttpConnection &request)> Handler;
+
+private:
+    struct Route
+    {
+        const char *Path;
+        HttpMethod Method;
+        Handler Function;
+    };
+
+    WiFiServer Listener;
+    HttpConnection Connections[HTTP_CONNECTIONS_MAX];
+    Route Routes[HTTP_HANDLERS_MAX];
+    uint8_t RouteCount = 0;
+    const char *HeaderNames[HTTP_HEADERS_MAX];
+    uint8_t HeaderCount = 0;
+    HttpServerStats Stats = {};
+
+    void Accept(unsigned long nowMillis);
+    void Service(HttpConnection &connection, unsigned long nowMillis);
+    void Dispatch(HttpConnection &connection);
+    void Close(HttpConnection &connection);
+
+public:
+    explicit HttpServer(int port);
+
+    void On(const char *path, HttpMethod method, Handler handler);
+    void CollectHeader(const char *name);
+    void Begin();
+    void Poll();
+
+    // Queues an event on every open event stream; a stream without room for it is dropped.
+    // Returns the number of streams that took it.
+    size_t Broadcast(const char *data, size_t length);
+
+    size_t GetConnectionCount() const;
+    size_t GetStreamCount() const;
+    const HttpServerStats &GetStats() const { return Stats; }
+};
+
+#endif
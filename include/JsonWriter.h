@@ -0,0 +1,86 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define JSONWRITER_MAX_DEPTH 16
+
+// Receives the buffer contents whenever a JsonWriter runs full, e.g. an HTTP
+// response sent in chunks.
+class JsonSink
+{
+public:
+    virtual void Write(const char *data, size_t length) = 0;
+};
+
+// Builds JSON or plain text in a caller-provided buffer without touching the
+// heap. Commas between members and elements are inserted automatically.
+// Without a sink, output that does not fit is cut off and HasOverflowed()
+// reports it; with a sink, the buffer is handed over and reused.
+class JsonWriter
+{
+private:
+    char *Buffer;
+    size_t Size;
+    size_t Length = 0;
+    JsonSink *Sink;
+    bool Overflowed = false;
+    uint8_t Depth = 0;
+    uint16_t HasElements = 0; // bit per nesting level
+    bool AfterKey = false;
+
+    void Put(char c);
+    void Put(const char *data, size_t length);
+    void Separator();
+    void Open(char c);
+    void Close(char c);
+    void Escaped(const char *value);
+
+public:
+    JsonWriter(char *buffer, size_t size, JsonSink *sink = NULL);
+
+    JsonWriter &BeginObject() { Open('{'); return *this; }
+    JsonWriter &EndObject() { Close('}'); return *this; }
+    JsonWriter &BeginArray() { Open('['); return *this; }
+    JsonWriter &EndArray() { Close(']'); return *this; }
+    JsonWriter &Key(const char *key);
+
+    JsonWriter &Value(const char *value); // NULL is written as null
+    JsonWriter &Value(int value) { return Value((long)value); }
+    JsonWriter &Value(unsigned int value) { return Value((unsigned long)value); }
+    JsonWriter &Value(long value);
+    JsonWriter &Value(unsigned long value);
+    JsonWriter &Value(double value, uint8_t decimals);
+    JsonWriter &Bool(bool value);
+
+    template <typename T>
+    JsonWriter &Member(const char *key, T value) { return Key(key).Value(value); }
+    JsonWriter &Member(const char *key, double value, uint8_t decimals) { return Key(key).Value(value, decimals); }
+    JsonWriter &Member(const char *key, bool value) { return Key(key).Bool(value); }
+
+    // Text output, not escaped and without separators.
+    JsonWriter &Raw(const char *text);
+    JsonWriter &Printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+    JsonWriter &VPrintf(const char *format, va_list args);
+
+    // Hands everything written so far to the sink.
+    void Flush();
+    void Reset();
+    // Empties the buffer after its content was taken out, e.g. sent, but keeps
+    // the nesting, so the output continues where it left off.
+    void Consume();
+
+    // NUL-terminated unless the buffer was handed to a sink.
+    const char *c_str() const { return Buffer; }
+    size_t GetLength() const { return Length; }
+    bool HasOverflowed() const { return Overflowed; }
+};
+
+#endif
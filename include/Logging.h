@@ -6,7 +6,49 @@
 #ifndef LOGGING_H
 #define LOGGING_H
 
-#include <Arduino.h>
-void Log(const String& message);
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+// Set with -DLOG_LEVEL=LOG_LEVEL_INFO in build_flags. Calls above the level
+// are removed by the preprocessor, arguments included, so a disabled log line
+// costs neither code nor time.
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_NONE
+#endif
+
+#define LOG_LINE_LENGTH 128
+
+// Formats into a LOG_LINE_LENGTH stack buffer and writes one line: Serial1
+// (GPIO2, TX only) on the ESP8266, stderr on the host.
+void LogFormat(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+#define LOG_DISCARD(...) do { } while (0)
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) LogFormat(__VA_ARGS__)
+#else
+#define LOG_ERROR(...) LOG_DISCARD(__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) LogFormat(__VA_ARGS__)
+#else
+#define LOG_WARN(...) LOG_DISCARD(__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) LogFormat(__VA_ARGS__)
+#else
+#define LOG_INFO(...) LOG_DISCARD(__VA_ARGS__)
+#endif
+
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) LogFormat(__VA_ARGS__)
+#else
+#define LOG_DEBUG(...) LOG_DISCARD(__VA_ARGS__)
+#endif
 
 #endif
@@ -5,20 +5,134 @@
 
 #ifndef MQTTBRIDGE_H
 #define MQTTBRIDGE_H
+#include <ESP8266WiFi.h>
 #include <MQTT.h>
+#include "ArduinoPlatform.h"
+#include "SEAreaNames.h"
+#include "SECommandArbiter.h"
 #include "SEController.h"
+#include "SEMetrics.h"
+#include "SETopicRouter.h"
+#include "SEWriteTracker.h"
 
-class MqttBridge
+// Upper bound for each wait of a connection attempt: DNS lookup, TCP connect,
+// CONNACK and every SUBACK are separate steps, see MqttConnectStep. The UART
+// ring buffer holds about 170 ms of SEC-Touch traffic.
+#define MQTT_CONNECT_TIMEOUT_MILLIS 150
+// Acknowledgement deadline once the session is up. The client closes the
+// connection when it passes, so a slow broker must not trip it.
+#define MQTT_COMMAND_TIMEOUT_MILLIS 2000
+
+// Home automation yields to a person at the local web interface; see SECommandArbiter.
+#define MQTT_SOURCE_PRECEDENCE 0
+
+#define MQTT_PAYLOAD_LENGTH 64
+
+// Client read and write buffer each; the Home Assistant discovery config with the longest
+// topic prefix is the largest message.
+#define MQTT_BUFFER_LENGTH 768
+#define MQTT_DISCOVERY_LENGTH 640
+
+// Payload of one trace dump message. It sits on the stack while the message is built, so it
+// stays well below MQTT_BUFFER_LENGTH; a dump simply takes more messages.
+#define MQTT_TRACE_CHUNK_LENGTH 192
+static_assert(MQTT_TRACE_CHUNK_LENGTH + SETOPICROUTER_TOPIC_LENGTH + 8 <= MQTT_BUFFER_LENGTH, "A trace chunk must fit into the client buffer");
+
+#define MQTT_TELEMETRY_INTERVAL_MILLIS 60000
+
+#define MQTT_DEFAULT_TOPIC_PREFIX "airsystem"
+#define MQTT_DEFAULT_CLIENT_ID "AirSystem"
+#define MQTT_CLIENT_ID_LENGTH 32
+
+// Steps of one connection attempt; ConnectionManager runs one per Poll().
+enum MqttConnectStep : uint8_t
+{
+    MQTT_STEP_RESOLVE, // DNS lookup, once per boot
+    MQTT_STEP_TCP,
+    MQTT_STEP_SESSION, // CONNECT and CONNACK
+    MQTT_STEP_SUBSCRIBE_SET,
+    MQTT_STEP_SUBSCRIBE_SCAN,
+    MQTT_STEP_SUBSCRIBE_TRACE,
+    MQTT_STEP_SUBSCRIBE_STATUS,
+    MQTT_STEP_ONLINE, // availability and retained state, no wait
+    MQTT_STEP_DONE
+};
+
+enum MqttConnectResult : uint8_t
+{
+    MQTT_CONNECT_FAILED,
+    MQTT_CONNECT_PENDING,
+    MQTT_CONNECT_DONE
+};
+
+struct MqttBridgeStats
+{
+    unsigned long Connects;
+    unsigned long ConsistentMillis; // last connect until the snapshot held every area
+};
+
+class MqttBridge : public SERegisterListener
 {
 private:
-    void ConnectToMQTT();
+    void PublishScanResults();
+    void PublishTrace();
+    void PublishTelemetry();
+    void PublishState(int registerId, const char *value);
+    void PublishStates();
+    void PublishSnapshot();
+    void PublishDiscovery();
+    void PublishWriteReports();
+    void OnMessage(const char *topic, const char *payload);
+    void OnSetRegister(int registerId, const char *payload);
     SEController *SEC;
+    SECommandArbiter *Arbiter;
+    SEMetrics *Metrics = NULL;
+    int Source;
+    SETopicRouter Topics;
+    ArduinoClock Clock;
+    WiFiClient Net;
+    char ClientId[MQTT_CLIENT_ID_LENGTH];
+    char DeviceId[SETOPICROUTER_PREFIX_LENGTH + 16]; // Home Assistant device and unique id stem
+    SEWriteTracker Tracker;
     MQTTClient Client;
+    const char *Hostname;
+    int Port;
+    IPAddress BrokerAddress;
+    bool HostResolved = false;
+    MqttConnectStep Step = MQTT_STEP_DONE;
+    bool Online = false; // all steps done on the current connection
+    unsigned long LastScanStatusMillis = 0;
+    bool TraceDumping = false;
+    uint32_t TraceDumpNext = 0;
+    uint32_t TraceDumpEnd = 0;
+    unsigned long LastTelemetryMillis = 0;
+    MqttBridgeStats Stats = {};
+    uint8_t PendingDiscovery = 0; // bit per area
+    bool DiscoverySent = false;
+    SEAreaLanguage Language = SEAREA_LANGUAGE_DE; // of the discovery names sent last
+    bool SnapshotPending = false;
+    bool Consistent = false;
+    unsigned long ConnectedMillis = 0;
 
 public:
-    MqttBridge(const char hostname[], int port, SEController *sec);
+    MqttBridge(const char hostname[], int port, SEController *sec, SECommandArbiter *arbiter);
     ~MqttBridge();
+    // Starts a connection attempt; ConnectionManager decides when to retry.
+    void BeginConnect();
+    // Runs the next MqttConnectStep. Each step waits for the network at most
+    // once, for MQTT_CONNECT_TIMEOUT_MILLIS at most.
+    MqttConnectResult ConnectStep();
+    bool IsConnected();
+    // Must be unique per broker connection, so every unit needs its own.
+    void SetClientId(const char *clientId);
+    // Root of all bridge topics, e.g. "building/unit-2"; takes effect with the next BeginConnect().
+    void SetTopicPrefix(const char *prefix);
+    // Publishes SEMetrics::WriteTelemetry() to <prefix>/telemetry every MQTT_TELEMETRY_INTERVAL_MILLIS.
+    void SetMetrics(SEMetrics *metrics);
+    const MqttBridgeStats &GetStats() const { return Stats; }
+    const SEWriteTracker &GetWriteTracker() const { return Tracker; }
     void Poll();
+    void OnRegisterChanged(SEController *controller, int registerId, const char *value) override;
 };
 
 #endif
@@ -0,0 +1,56 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef RECONNECTBACKOFF_H
+#define RECONNECTBACKOFF_H
+
+#include <stdint.h>
+
+// Exponential backoff with jitter for reconnect attempts. After the n-th
+// failure in a row the next attempt is due after a random delay between half
+// and all of min * 2^n (capped at max), so devices that lost the same access
+// point or broker do not all retry in lockstep.
+class ReconnectBackoff
+{
+private:
+    unsigned long MinMillis;
+    unsigned long MaxMillis;
+    unsigned long CurrentMillis = 0;
+    unsigned long DueMillis = 0;
+    uint32_t Random;
+
+    uint32_t NextRandom()
+    {
+        // xorshift32
+        Random ^= Random << 13;
+        Random ^= Random >> 17;
+        Random ^= Random << 5;
+        return Random;
+    }
+
+public:
+    ReconnectBackoff(unsigned long minMillis, unsigned long maxMillis, uint32_t seed)
+        : MinMillis(minMillis), MaxMillis(maxMillis), Random(seed != 0 ? seed : 1) {}
+
+    bool IsDue(unsigned long nowMillis) const { return (long)(nowMillis - DueMillis) >= 0; }
+
+    void Fail(unsigned long nowMillis)
+    {
+        CurrentMillis = CurrentMillis == 0 ? MinMillis : CurrentMillis * 2;
+        if (CurrentMillis > MaxMillis) CurrentMillis = MaxMillis;
+        unsigned long half = CurrentMillis / 2;
+        DueMillis = nowMillis + half + NextRandom() % (CurrentMillis - half + 1);
+    }
+
+    void Reset(unsigned long nowMillis)
+    {
+        CurrentMillis = 0;
+        DueMillis = nowMillis;
+    }
+
+    unsigned long GetDelayMillis() const { return CurrentMillis; }
+};
+
+#endif
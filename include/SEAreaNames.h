@@ -0,0 +1,45 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SEAREANAMES_H
+#define SEAREANAMES_H
+
+#include <stddef.h>
+#include "SEController.h"
+
+// The six ventilation areas: fan level registers 173-178 and their label registers 78-83.
+#define SEAREA_COUNT 6
+#define SEAREA_LEVEL_REGISTER 173
+#define SEAREA_LABEL_REGISTER 78
+#define SEAREA_MAX_LEVEL 6
+
+// Longest room name in any language, including the terminating NUL.
+#define SEAREA_NAME_LENGTH 32
+
+// Languages of the room names. The SEC-Touch itself only knows German.
+enum SEAreaLanguage
+{
+    SEAREA_LANGUAGE_DE,
+    SEAREA_LANGUAGE_EN,
+    SEAREA_LANGUAGE_COUNT
+};
+
+// The language applies to all names resolved afterwards; frontends that
+// cache labels compare SEGetAreaLanguage() to notice a change.
+SEAreaLanguage SEGetAreaLanguage();
+void SESetAreaLanguage(SEAreaLanguage language);
+// "de", "en"; NULL for an unknown language.
+const char *SEAreaLanguageCode(SEAreaLanguage language);
+bool SEParseAreaLanguage(const char *code, SEAreaLanguage &language);
+
+// Room name a label register value refers to. The names are kept in flash
+// and copied into buffer, which is returned; NULL for an unknown index.
+const char *SEAreaName(int nameIndex, char *buffer, size_t size);
+
+// Label of an area (0-based) from the cached label register, written into
+// buffer. Until the register has been read it is "Lüfter <n>" / "Fan <n>".
+const char *SEAreaLabel(const SEController &controller, int area, char *buffer, size_t size);
+
+#endif
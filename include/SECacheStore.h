@@ -0,0 +1,83 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SECACHESTORE_H
+#define SECACHESTORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SEController.h"
+#include "SETransport.h"
+
+// Changes are saved once no further change came for this long, or when the
+// oldest unsaved change is SECACHESTORE_INTERVAL_MILLIS old...
+#define SECACHESTORE_DELAY_MILLIS 10000
+// ...but never sooner than this after the previous save, to spare the flash.
+#define SECACHESTORE_INTERVAL_MILLIS 300000
+
+#define SECACHESTORE_MAGIC 0x31434553 // "SEC1"
+
+struct SECacheStoreStats
+{
+    unsigned long Restored; // registers seeded at boot
+    unsigned long Saves;
+    unsigned long Skipped;  // changes that ended in the saved state again
+    unsigned long Failures;
+};
+
+// Keeps the register cache of a controller across restarts. Restore() seeds
+// the cache before the first poll, so frontends serve the last known levels
+// and room labels right after boot; the registers are still read from the bus
+// at the usual time and replace the saved values. Changes are collected from
+// the dirty bits of the register cache and written as one record, at most every SECACHESTORE_INTERVAL_MILLIS, and only
+// if the content differs from what is saved. The record is keyed by register
+// id and protected by a CRC, so a torn or outdated record is ignored.
+class SECacheStore
+{
+private:
+    struct Header
+    {
+        uint32_t Magic;
+        uint16_t Count;
+        uint16_t Crc; // XModem CRC of the entries
+    };
+
+    struct Entry
+    {
+        uint16_t RegisterId;
+        char Value[SEREGISTER_VALUE_LENGTH];
+    };
+
+    SEController *Controller;
+    SEStorage *Storage;
+    SEClock *Clock;
+    bool Changed = false;
+    bool Saved = false;     // SavedCrc and SavedCount describe the stored record
+    bool Attempted = false; // AttemptMillis is set
+    unsigned long ChangedMillis = 0;      // last unsaved change
+    unsigned long PendingSinceMillis = 0; // oldest unsaved change
+    unsigned long AttemptMillis = 0;      // last save, failed or not, or the restore
+    uint16_t SavedCrc = 0;
+    uint16_t SavedCount = 0;
+
+    size_t Encode(uint8_t *buffer, Header &header) const;
+    // Takes the dirty bits of the register cache.
+    void CollectChanges(unsigned long now);
+
+public:
+    SECacheStoreStats Stats;
+
+    SECacheStore(SEController *controller, SEStorage *storage, SEClock *clock);
+
+    // Call once before the controller is polled. Returns the number of registers restored.
+    size_t Restore();
+    // Collects the registers changed since the last call and saves them when
+    // they are due. A save blocks for a flash write.
+    void Poll();
+    // Saves pending changes now, e.g. before a restart.
+    void Flush();
+};
+
+#endif
@@ -0,0 +1,71 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SECOMMANDARBITER_H
+#define SECOMMANDARBITER_H
+
+#include "SEController.h"
+
+#define SEARBITER_MAX_SOURCES 4
+
+// After a source wrote a register, sources of lower precedence cannot
+// overwrite it for this long. Equal or higher precedence always wins.
+#define SEARBITER_HOLD_MILLIS 2000
+
+#define SEARBITER_NO_SOURCE 0xFF
+
+struct SEArbiterSource
+{
+    const char *Name;
+    uint8_t Precedence;
+    unsigned long Writes;
+    unsigned long Rejected;
+};
+
+struct SEArbiterStats
+{
+    unsigned long Writes;
+    unsigned long Accepted;
+    unsigned long Superseded; // replaced a still-queued write of another source
+    unsigned long Rejected;   // register held by a source of higher precedence
+    unsigned long Failed;     // value out of range or command queue full
+};
+
+// Single entry point for writes from all frontends (MQTT, web interface, ...).
+// Writes are handed to SEController one at a time, where a pending write to
+// the same register is replaced by the newer one. Conflicts are resolved by a
+// fixed rule: the newer write wins unless a source of higher precedence wrote
+// the register within the last SEARBITER_HOLD_MILLIS.
+class SECommandArbiter
+{
+private:
+    struct RegisterOwner
+    {
+        uint8_t Source;
+        unsigned long WriteMillis;
+    };
+
+    SEController *Controller;
+    SEClock *Clock;
+    SEArbiterSource Sources[SEARBITER_MAX_SOURCES];
+    uint8_t SourceCount = 0;
+    RegisterOwner Owners[SERegisterMap::COUNT];
+
+public:
+    SEArbiterStats Stats;
+
+    SECommandArbiter(SEController *controller, SEClock *clock);
+
+    // Returns the source id, or -1 if all SEARBITER_MAX_SOURCES are taken.
+    int AddSource(const char *name, uint8_t precedence);
+    bool Write(int source, int registerId, const char *value);
+
+    // Source that wrote the register last, or -1.
+    int GetOwner(int registerId) const;
+    uint8_t GetSourceCount() const { return SourceCount; }
+    const SEArbiterSource &GetSource(uint8_t source) const { return Sources[source]; }
+};
+
+#endif
@@ -0,0 +1,80 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SECOMMANDQUEUE_H
+#define SECOMMANDQUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SECOMMANDQUEUE_CAPACITY 16
+#define SECOMMAND_VALUE_LENGTH 16
+
+// Waiting this long raises an entry by one priority level (never above
+// confirmations), so label polls are not starved by the fan level polls.
+#define SECOMMANDQUEUE_AGING_MILLIS 100
+
+// Lower value = sent first.
+enum SECommandPriority
+{
+    SECOMMAND_PRIORITY_WRITE = 0,   // SETs from the frontends
+    SECOMMAND_PRIORITY_CONFIRM = 1, // read-back of a written register
+    SECOMMAND_PRIORITY_POLL = 2,    // periodic fan level polling
+    SECOMMAND_PRIORITY_LABEL = 3,   // periodic label polling
+    SECOMMAND_PRIORITY_SCAN = 4,    // register discovery, only sent when the bus is idle
+    SECOMMAND_PRIORITY_COUNT = 5
+};
+
+struct SECommand
+{
+    int RegisterId;
+    bool IsSet;
+    uint8_t Priority;
+    char Value[SECOMMAND_VALUE_LENGTH];
+    unsigned long QueuedMillis;
+};
+
+struct SECommandQueueStats
+{
+    unsigned long Enqueued;
+    unsigned long Coalesced; // SET replaced the value of a pending SET, or duplicate GET
+    unsigned long Dropped;   // queue full, nothing of lower priority to evict
+    unsigned long Evicted;   // lower priority entry pushed out by a higher priority one
+    unsigned int MaxDepth;
+    unsigned long Dequeued[SECOMMAND_PRIORITY_COUNT];
+    unsigned long TotalWaitMillis[SECOMMAND_PRIORITY_COUNT];
+    unsigned long MaxWaitMillis[SECOMMAND_PRIORITY_COUNT];
+};
+
+// Fixed-capacity priority queue for outgoing requests. Entries of the same
+// priority leave in FIFO order. Pending writes to the same register are
+// coalesced (last value wins, the original queue position is kept), so a
+// burst of slider moves costs one bus transaction.
+class SECommandQueue
+{
+private:
+    SECommand Entries[SECOMMANDQUEUE_CAPACITY];
+    uint32_t Sequence[SECOMMANDQUEUE_CAPACITY];
+    bool Used[SECOMMANDQUEUE_CAPACITY];
+    uint32_t NextSequence = 0;
+    unsigned int Count = 0;
+
+    int Find(int registerId, bool isSet) const;
+    uint8_t EffectivePriority(int index, unsigned long nowMillis) const;
+    int FindLowestPriority() const;
+
+public:
+    SECommandQueueStats Stats;
+
+    SECommandQueue();
+
+    bool Push(int registerId, bool isSet, const char *value, uint8_t priority, unsigned long nowMillis);
+    bool Pop(SECommand &command, unsigned long nowMillis);
+    bool Contains(uint8_t priority) const;
+    bool Contains(int registerId, bool isSet) const;
+    unsigned int Depth() const { return Count; }
+};
+
+#endif
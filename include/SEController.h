@@ -3,32 +3,40 @@
   Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
 */
 
-// Documentation for future changes
-
-// Dim screen
-// Register: 58 = [minutes]
-// Register: 59 = [by xx percent]
-
-// Summer ventilation (no heat recovery)
-// Register: 48 = [0A00 = on]; [0800 = off]
-
-// Snooze time
-// Register: 56 = [xx minutes]
+// The known registers and their meaning are listed in SERegisterMap.h.
 
 #ifndef SECONTROLLER_H
 #define SECONTROLLER_H
 
-#include <SoftwareSerial.h>
-#include <functional>
+#include "SECommandQueue.h"
+#include "SEFrameParser.h"
+#include "SEHistogram.h"
+#include "SEPollScheduler.h"
+#include "SERegisterCache.h"
+#include "SERegisterMap.h"
+#include "SERegisterScanner.h"
+#include "SETrace.h"
+#include "SETransport.h"
 
 #define STX 0x02
 #define ETX 0x0A
 #define ACK 0x06
 #define TAB 0x09
 
-#define RESET_ACK_MILLIS 8000
+// A request that is not acknowledged within its wire time plus this
+// turnaround is sent again, at most SECONTROLLER_MAX_RETRIES times.
+#define SECONTROLLER_ACK_TURNAROUND_MILLIS 25
+#define SECONTROLLER_MAX_RETRIES 3
+
+// Poll interval bounds per register group (POLL_GROUP_* in SERegisterMap.h); see SEPollScheduler.
+#define POLL_FAN_LEVEL_MIN_MILLIS 250
+#define POLL_FAN_LEVEL_MAX_MILLIS 4000
+#define POLL_LABEL_MIN_MILLIS 60000
+#define POLL_LABEL_MAX_MILLIS 600000
+#define POLL_SETTING_MIN_MILLIS 30000
+#define POLL_SETTING_MAX_MILLIS 600000
 
-#define PROCESS_REQUESTREGISTER_DELAY_MILLIS 10
+#define BUS_UTILIZATION_WINDOW_MILLIS 10000
 #define PROCESS_SENDBUFFER_DELAY_MILLIS 10
 #define SEND_ACK_DELAY_MILLIS 2
 
@@ -38,62 +46,179 @@
 #define SECONTROLLER_BAUD 28800
 
 #define ON_REGISTERCHANGED_MAX 10
+#define ON_WRITECOMPLETED_MAX 4
 
-class SEController
-{
-private:
-    bool InsideMessageFlag = false;
-    bool ReceivedSTXFlag = false;
-
-    bool LastMessageAccepted = true;
-    bool SendMessageAck = false;
-
-    unsigned long PreviousMillisProcessFanLevels = 0;
-    unsigned long PreviousMillisProcessLabels = 0;
-    unsigned long PreviousMillisAckReceived = 0;
-    unsigned long PreviousSerialAvailable = 0;
+#define SECONTROLLER_READ_CHUNK 32
+#define SECONTROLLER_VALUE_LENGTH SECOMMAND_VALUE_LENGTH
+#define SECONTROLLER_CONFIRMATION_SLOTS 8
 
-    const unsigned long LABEL_UPDATE_INTERVAL = 600000; // 10 Minuten
+class SEController;
 
-    int FanLevelRegisterIndex = 0;
-    int LabelRegisterIndex = 0;
-
-    typedef std::function<void(SEController*, int, const char*)> RegisterChangedCallback;
-    RegisterChangedCallback OnRegisterChanged[ON_REGISTERCHANGED_MAX];
-    unsigned int OnRegisterChangedCount = 0;
+// Receives every change of a cached register value. A plain virtual call per
+// listener; registered with SEController::AddRegisterListener.
+class SERegisterListener
+{
+public:
+    virtual ~SERegisterListener() {}
+    virtual void OnRegisterChanged(SEController *controller, int registerId, const char *value) = 0;
+};
 
-    static const int FAN_LEVEL_COUNT = 6;
-    static const int FAN_LEVEL_REGISTERS[FAN_LEVEL_COUNT];
+enum SEWriteResult
+{
+    SEWRITE_CONFIRMED,  // acknowledged and read back with the written value
+    SEWRITE_FAILED,     // no ACK or a differing read-back after all retries
+    SEWRITE_SUPERSEDED  // a newer write to the register took its place before it was confirmed
+};
 
-    static const int LABEL_COUNT = 6;
-    static const int LABEL_REGISTERS[LABEL_COUNT];
+// Learns how a write accepted by SendMessageResponse ended; registered with
+// SEController::AddWriteListener. value is the value that was written.
+class SEWriteListener
+{
+public:
+    virtual ~SEWriteListener() {}
+    virtual void OnWriteCompleted(SEController *controller, int registerId, const char *value, SEWriteResult result) = 0;
+};
 
-    char FanLevelValues[FAN_LEVEL_COUNT][16];
-    char LabelValues[LABEL_COUNT][16];
+struct SEControllerStats
+{
+    unsigned long RequestsSent;
+    unsigned long AckTimeouts;
+    unsigned long Retransmits;
+    unsigned long RequestsFailed;  // no ACK after all retries
+    unsigned long WritesConfirmed; // read-back matched the written value
+    unsigned long WritesMismatched; // read-back differed; the SET is repeated
+    unsigned long WritesFailed;    // not acknowledged, not read back or still differing after all retries
+};
 
-    char SendMessageBuffer[64];
-    char ReceiveMessageBuffer[64];
+class SEController
+{
+private:
+    // The request currently on the wire. It is kept until the controller
+    // acknowledges it, so it can be retransmitted after an ACK timeout.
+    struct InFlightRequest
+    {
+        char Frame[64];
+        size_t Length;
+        int RegisterId;
+        bool IsSet;
+        uint8_t Priority;
+        char Value[SECONTROLLER_VALUE_LENGTH];
+        unsigned long SentMillis;
+        unsigned long SentMicros;
+        unsigned long TimeoutMillis;
+        unsigned int Attempts;
+        bool AwaitingAck;
+        bool RetransmitPending;
+    };
+
+    // An acknowledged write that waits for the register to read back the written value.
+    struct WriteConfirmation
+    {
+        int RegisterId; // -1 = slot free
+        char Value[SECONTROLLER_VALUE_LENGTH];
+        unsigned int Attempts;
+    };
 
-    SoftwareSerial *SECSerial;
+    bool SendMessageAck = false;
 
-    bool IsSendBufferEmpty();
-    void SendMessageRequest(int commandId, int registerId);
+    unsigned long PreviousSerialAvailable = 0;
+    unsigned long PreviousMillisPollScheduler = 0;
+
+    unsigned long BusBytes = 0;
+    unsigned long BusWindowBytes = 0;
+    unsigned long BusWindowStartMillis = 0;
+    float BusUtilization = 0;
+
+    SERegisterListener *RegisterListeners[ON_REGISTERCHANGED_MAX];
+    unsigned int RegisterListenerCount = 0;
+    SEWriteListener *WriteListeners[ON_WRITECOMPLETED_MAX];
+    unsigned int WriteListenerCount = 0;
+
+    SERegisterCache RegisterCache;
+    SECommandQueue CommandQueue;
+    SEPollScheduler PollScheduler;
+    SERegisterScanner Scanner;
+    InFlightRequest InFlight;
+    WriteConfirmation Confirmations[SECONTROLLER_CONFIRMATION_SLOTS];
+    SEControllerStats Stats;
+    SEHistogram AckLatencyMicros;
+    SEHistogram QueueDepth;
+    SETrace Trace;
+
+    SEFrameParser Parser;
+
+    SETransport *Transport;
+    SEClock *Clock;
+
+    bool IsRequestInFlight();
+    size_t EncodeMessage(char* buffer, size_t size, const SECommand &command);
+    WriteConfirmation *FindConfirmation(int registerId, bool allocate);
     void ProcessMessageResponseIncome(int commandId, int registerId, const char* content);
     void ProcessSendMessageAck();
-    void ProcessMessage(const char* message);
-    void ProcessFanLevelRegisters();
-    void ProcessLabelRegisters();
+    void ProcessMessage(const SEFrame &frame);
+    void ProcessRequestCompleted();
+    void ProcessWriteConfirmation(int registerId, const char* content);
+    void NotifyWriteCompleted(int registerId, const char* value, SEWriteResult result);
+    unsigned long AckTimeoutMillis(size_t frameLength);
+    void ProcessAckTimeout(unsigned long currentMillis);
+    void ProcessPollScheduler(unsigned long currentMillis);
+    void ProcessScanner(unsigned long currentMillis);
+    void ProcessBusUtilization(unsigned long currentMillis);
+    void WriteToBus(const uint8_t* buffer, size_t length);
     void ProcessMessageSendBuffer();
+    void TransmitInFlight();
+    void TraceEvent(uint8_t event, int registerId, long value, uint8_t detail = 0);
+    void TraceFrameErrors(const SEFrameErrors &before);
 
-    int getFanLevelRegisterIndex(int registerId);
-    int getLabelRegisterIndex(int registerId);
+    friend class SEControllerBenchmark;
 
 public:
-    SEController(uint8_t rxPin, uint8_t txPin);
+    // The transport and clock are owned by the caller and must outlive the controller.
+    SEController(SETransport *transport, SEClock *clock);
     ~SEController();
-    void SendMessageResponse(int registerId, const char* content);
-    void AddOnRegisterChanged(RegisterChangedCallback callback);
+    // Queues a SET; a pending SET to the same register is replaced. Returns false if the queue is
+    // full or if the register is known to be read-only or the value is out of its range.
+    bool SendMessageResponse(int registerId, const char* content);
+    // Frontends normally write through SECommandArbiter instead of calling SendMessageResponse directly.
+    bool HasPendingWrite(int registerId) const;
+    void AddRegisterListener(SERegisterListener *listener);
+    void AddWriteListener(SEWriteListener *listener);
     void Poll();
+
+    // Cached value of a register, NULL if it is unknown or has not been read yet. No bus access.
+    const char* GetRegisterValue(int registerId) const;
+    // Clock->Millis() of the last read of the register, 0 if it has not been read yet.
+    unsigned long GetRegisterUpdatedMillis(int registerId) const;
+    const SERegisterCache &GetRegisterCache() const;
+    // Slots whose cached value changed since the last call, see SERegisterCache::TakeDirty().
+    uint32_t TakeChangedRegisters();
+    // Seeds an unknown register with a value saved before a restart, see SECacheStore. Listeners
+    // are not notified and the register is still read at the usual time.
+    bool RestoreRegisterValue(int registerId, const char* value);
+
+    // Discovery: GETs every register in the range whenever the bus is otherwise idle; see SERegisterScanner.
+    void StartScan(int firstRegister, int lastRegister, bool continuous);
+    void StopScan();
+    SERegisterScanner &GetScanner();
+
+    const SEFrameErrors &GetFrameErrors() const;
+    // Recent bus frames and state changes; see SETrace.
+    SETrace &GetTrace();
+    void SetPollIntervals(uint8_t group, unsigned long minIntervalMillis, unsigned long maxIntervalMillis);
+    const SEPollScheduler &GetPollScheduler() const;
+
+    // Share of the line time used by both directions over the last BUS_UTILIZATION_WINDOW_MILLIS (0..1).
+    float GetBusUtilization() const;
+    unsigned long GetBusBytes() const;
+
+    const SEControllerStats &GetStats() const;
+    // Request on the wire until its ACK (or the value answering a GET), in microseconds.
+    const SEHistogram &GetAckLatency() const;
+    // Queue depth seen by every request taken from the queue, the request included.
+    const SEHistogram &GetQueueDepthHistogram() const;
+    const SECommandQueueStats &GetQueueStats() const;
+    unsigned int GetQueueDepth() const;
+    unsigned long GetFramesReceived() const;
 };
 
 #endif
@@ -0,0 +1,26 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SEFRAMEENCODER_H
+#define SEFRAMEENCODER_H
+
+#include <stddef.h>
+
+// STX 32800 TAB <register> TAB <crc> ETX with a register id of up to 5 digits.
+#define SEFRAME_GET_LENGTH 20
+
+// Request frames as SEController sends them. GET frames of the registers in
+// SERegisterMap are copied from a table in flash that is complete with CRC;
+// other registers, e.g. during a scan, and SET frames are written in one
+// pass that updates the CRC per byte and converts numbers without printf.
+class SEFrameEncoder
+{
+public:
+    // Return the frame length, 0 if the buffer is too small.
+    static size_t EncodeGet(char *buffer, size_t size, int registerId);
+    static size_t EncodeSet(char *buffer, size_t size, int registerId, const char *value);
+};
+
+#endif
@@ -0,0 +1,63 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SEFRAMEPARSER_H
+#define SEFRAMEPARSER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SEFRAME_BUFFER_SIZE 64
+
+// A received frame. Value points into the parser buffer, is NUL-terminated
+// and stays valid until the next byte is pushed.
+struct SEFrame
+{
+    bool IsAck;
+    long CommandId;
+    long RegisterId;
+    const char *Value;
+    size_t ValueLength;
+};
+
+struct SEFrameErrors
+{
+    unsigned long Overflows;     // frame longer than the receive buffer
+    unsigned long CrcMismatches; // trailing CRC does not match the frame
+    unsigned long Truncated;     // STX arrived before the ETX of the previous frame
+    unsigned long Malformed;     // fields missing or not numeric
+};
+
+// Incremental parser for STX <command> TAB <register> TAB <value> TAB <crc> ETX
+// frames and the short STX ACK ETX acknowledge. The CRC is computed while the
+// bytes arrive, so a completed frame is validated without a second pass.
+class SEFrameParser
+{
+private:
+    char Buffer[SEFRAME_BUFFER_SIZE];
+    size_t Length = 0;
+    bool InsideFrame = false;
+    bool Overflow = false;
+
+    unsigned short Crc = 0;
+    unsigned short CrcAtLastTab = 0;
+    size_t FirstTabs[3];
+    size_t TabCount = 0;
+    size_t LastTab = 0;
+
+    SEFrame Current;
+
+    bool CompleteFrame();
+
+public:
+    SEFrameErrors Errors = {0, 0, 0, 0};
+    unsigned long FramesReceived = 0;
+
+    // Returns true when value completed a valid frame, available through Frame().
+    bool Push(uint8_t value);
+    const SEFrame &Frame() const { return Current; }
+};
+
+#endif
@@ -0,0 +1,48 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SEHISTOGRAM_H
+#define SEHISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SEHISTOGRAM_BOUNDS 8
+
+// Counts observations into SEHISTOGRAM_BOUNDS fixed buckets plus one for
+// everything above the last bound. Observe() is a short scan over the bounds
+// and a few additions, cheap enough for the serial path.
+class SEHistogram
+{
+private:
+    const uint32_t *Bounds; // ascending, SEHISTOGRAM_BOUNDS entries, upper bound inclusive
+    uint32_t Buckets[SEHISTOGRAM_BOUNDS + 1] = {};
+    uint32_t Count = 0;
+    uint32_t Max = 0;
+    uint64_t Sum = 0;
+
+public:
+    explicit SEHistogram(const uint32_t *bounds) : Bounds(bounds) {}
+
+    void Observe(uint32_t value)
+    {
+        size_t bucket = 0;
+        while (bucket < SEHISTOGRAM_BOUNDS && value > Bounds[bucket]) bucket++;
+        Buckets[bucket]++;
+        Count++;
+        Sum += value;
+        if (value > Max) Max = value;
+    }
+
+    uint32_t GetBound(size_t bucket) const { return Bounds[bucket]; }
+    // Observations in the bucket alone, not cumulative; bucket SEHISTOGRAM_BOUNDS is the overflow.
+    uint32_t GetBucket(size_t bucket) const { return Buckets[bucket]; }
+    uint32_t GetCount() const { return Count; }
+    uint64_t GetSum() const { return Sum; }
+    uint32_t GetMax() const { return Max; }
+    uint32_t GetMean() const { return Count ? (uint32_t)(Sum / Count) : 0; }
+};
+
+#endif
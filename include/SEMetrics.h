@@ -0,0 +1,59 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SEMETRICS_H
+#define SEMETRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "JsonWriter.h"
+#include "SEController.h"
+#include "SEHistogram.h"
+#include "SEUnitScheduler.h"
+
+#define SEMETRICS_HEAP_SAMPLE_MILLIS 1000
+#define SEMETRICS_LABEL_LENGTH 48
+#define SEMETRICS_ALL_LINES 0xFFFFFFFF
+
+class SEPrometheusLines;
+
+// Metrics of the bridge around the controllers: main loop duration and heap.
+// Together with the counters and histograms each controller keeps itself,
+// labelled with the unit name, they are exported as Prometheus text and as a
+// compact JSON telemetry message per unit. Recording only happens in
+// OnLoop(); all formatting is done when an export is asked for, between two
+// controller polls.
+class SEMetrics
+{
+private:
+    SEHistogram LoopMicros;
+    uint32_t FreeHeap = 0;
+    uint32_t FreeHeapMin = 0;
+    uint32_t MaxFreeBlock = 0;
+    uint32_t MaxFreeBlockMin = 0;
+    unsigned long LastHeapSampleMillis = 0;
+    bool HeapSampled = false;
+
+    void WritePrometheusLines(SEPrometheusLines &out, const SEUnitScheduler &units) const;
+
+public:
+    SEMetrics();
+
+    // Called once per main loop iteration; samples the heap every SEMETRICS_HEAP_SAMPLE_MILLIS on the device.
+    void OnLoop(uint32_t loopMicros, unsigned long nowMillis);
+    void SampleHeap(uint32_t freeHeap, uint32_t maxFreeBlock);
+
+    const SEHistogram &GetLoopMicros() const { return LoopMicros; }
+
+    // Prometheus text exposition format, version 0.0.4; controller metrics carry a unit label.
+    void WritePrometheus(JsonWriter &out, const SEUnitScheduler &units) const;
+    // Only the given line (from 0) of the same text; false past the last one.
+    // Lets a web server send the export in pieces without buffering all of it.
+    bool WritePrometheusLine(JsonWriter &out, const SEUnitScheduler &units, uint32_t line) const;
+    // One JSON object with means, maxima and counters; small enough for a single MQTT message.
+    void WriteTelemetry(JsonWriter &json, const SEController &controller) const;
+};
+
+#endif
@@ -0,0 +1,66 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SEPOLLSCHEDULER_H
+#define SEPOLLSCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SEPOLL_MAX_REGISTERS 32
+#define SEPOLL_MAX_GROUPS 4
+
+struct SEPollGroup
+{
+    unsigned long MinIntervalMillis;
+    unsigned long MaxIntervalMillis;
+    uint8_t Priority; // SECommandPriority used for the GET
+};
+
+struct SEPollEntry
+{
+    int RegisterId;
+    uint8_t Group;
+    unsigned long IntervalMillis;
+    unsigned long DueMillis;
+    bool HasValue;
+    unsigned long LastValueMillis;
+    unsigned long LastChangeMillis;
+    unsigned long Polls;
+    unsigned long Changes;
+};
+
+// Decides when each register is read next. Every register starts at its
+// group's minimum interval; each poll that returns the same value doubles the
+// interval up to the group's maximum, a changed value or a write from a
+// frontend drops it back to the minimum.
+class SEPollScheduler
+{
+private:
+    SEPollGroup Groups[SEPOLL_MAX_GROUPS];
+    SEPollEntry Entries[SEPOLL_MAX_REGISTERS];
+    size_t Count = 0;
+
+    SEPollEntry *Find(int registerId);
+
+public:
+    SEPollScheduler();
+
+    void SetGroup(uint8_t group, unsigned long minIntervalMillis, unsigned long maxIntervalMillis, uint8_t priority);
+    const SEPollGroup &GetGroup(uint8_t group) const { return Groups[group]; }
+    bool AddRegister(int registerId, uint8_t group, unsigned long nowMillis);
+
+    // The most overdue register, or NULL if nothing is due yet.
+    const SEPollEntry *NextDue(unsigned long nowMillis) const;
+
+    void OnPolled(int registerId, unsigned long nowMillis);
+    void OnValue(int registerId, bool changed, unsigned long nowMillis);
+    void OnWrite(int registerId, unsigned long nowMillis);
+
+    size_t GetCount() const { return Count; }
+    const SEPollEntry &GetEntry(size_t index) const { return Entries[index]; }
+};
+
+#endif
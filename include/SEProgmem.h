@@ -0,0 +1,35 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SEPROGMEM_H
+#define SEPROGMEM_H
+
+// Constant tables live in flash on the ESP8266 and are read through the
+// pgm_read_* accessors. On the host both collapse to plain memory access.
+#ifdef ARDUINO
+#include <pgmspace.h>
+#else
+#include <stdint.h>
+#include <string.h>
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define pgm_read_dword(address) (*(const uint32_t *)(address))
+#define memcpy_P memcpy
+#define strncpy_P strncpy
+#define snprintf_P snprintf
+#endif
+
+#include <stddef.h>
+
+// Wraps a table built by a constexpr function, so it can be returned by
+// value and stored with PROGMEM.
+template <typename T, size_t N>
+struct SEFlashArray
+{
+    T Items[N];
+};
+
+#endif
@@ -0,0 +1,46 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SEREGISTERCACHE_H
+#define SEREGISTERCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SERegisterMap.h"
+
+// Longest register value kept, including the terminating NUL.
+#define SEREGISTER_VALUE_LENGTH 8
+
+// Last value read from every register in SERegisterMap, indexed by slot.
+// Frontends read from here instead of asking the controller again.
+class SERegisterCache
+{
+private:
+    static_assert(SERegisterMap::COUNT <= 32, "Valid and dirty bits are kept in one 32 bit mask");
+
+    char Values[SERegisterMap::COUNT][SEREGISTER_VALUE_LENGTH];
+    uint32_t UpdatedMillis[SERegisterMap::COUNT];
+    uint32_t ValidMask = 0;
+    uint32_t DirtyMask = 0;
+
+public:
+    SERegisterCache();
+
+    // Stores a value read from the bus. Returns true if it differs from the
+    // cached one; the slot is then marked dirty.
+    bool Update(size_t slot, const char *value, unsigned long nowMillis);
+
+    // NULL until the register has been read once.
+    const char *Get(size_t slot) const;
+    bool IsValid(size_t slot) const { return ValidMask & (1UL << slot); }
+    unsigned long GetUpdatedMillis(size_t slot) const { return UpdatedMillis[slot]; }
+
+    bool IsDirty(size_t slot) const { return DirtyMask & (1UL << slot); }
+    // Returns the slots changed since the last call as a bit mask and clears
+    // them. There is one reader, SECacheStore; frontends use SERegisterListener.
+    uint32_t TakeDirty();
+};
+
+#endif
@@ -0,0 +1,89 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SEREGISTERMAP_H
+#define SEREGISTERMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define POLL_GROUP_FAN_LEVEL 0
+#define POLL_GROUP_LABEL 1
+#define POLL_GROUP_SETTING 2
+#define POLL_GROUP_NONE 0xFF
+
+enum SERegisterType : uint8_t
+{
+    SEREGISTER_TYPE_LEVEL,  // fan level of an area
+    SEREGISTER_TYPE_LABEL,  // index into the room name table
+    SEREGISTER_TYPE_NUMBER, // plain decimal number
+    SEREGISTER_TYPE_FLAGS   // hex bit field, e.g. 0A00
+};
+
+enum SERegisterAccess : uint8_t
+{
+    SEREGISTER_READ = 1,
+    SEREGISTER_WRITE = 2,
+    SEREGISTER_READ_WRITE = 3
+};
+
+struct SERegisterDescriptor
+{
+    uint16_t Id;
+    uint8_t Type;
+    uint8_t Access;
+    uint8_t PollGroup;
+    int16_t Min;
+    int16_t Max;
+};
+
+// All known controller registers. The table and the id -> slot index built
+// from it are generated at compile time and stored in flash; the only RAM a
+// register costs is its slot in SERegisterCache.
+constexpr SERegisterDescriptor SE_REGISTER_DESCRIPTORS[] = {
+    // id  type                    access                 poll group            min  max
+    {173, SEREGISTER_TYPE_LEVEL,  SEREGISTER_READ_WRITE, POLL_GROUP_FAN_LEVEL, 0, 6},
+    {174, SEREGISTER_TYPE_LEVEL,  SEREGISTER_READ_WRITE, POLL_GROUP_FAN_LEVEL, 0, 6},
+    {175, SEREGISTER_TYPE_LEVEL,  SEREGISTER_READ_WRITE, POLL_GROUP_FAN_LEVEL, 0, 6},
+    {176, SEREGISTER_TYPE_LEVEL,  SEREGISTER_READ_WRITE, POLL_GROUP_FAN_LEVEL, 0, 6},
+    {177, SEREGISTER_TYPE_LEVEL,  SEREGISTER_READ_WRITE, POLL_GROUP_FAN_LEVEL, 0, 6},
+    {178, SEREGISTER_TYPE_LEVEL,  SEREGISTER_READ_WRITE, POLL_GROUP_FAN_LEVEL, 0, 6},
+    {78,  SEREGISTER_TYPE_LABEL,  SEREGISTER_READ,       POLL_GROUP_LABEL,     0, 255},
+    {79,  SEREGISTER_TYPE_LABEL,  SEREGISTER_READ,       POLL_GROUP_LABEL,     0, 255},
+    {80,  SEREGISTER_TYPE_LABEL,  SEREGISTER_READ,       POLL_GROUP_LABEL,     0, 255},
+    {81,  SEREGISTER_TYPE_LABEL,  SEREGISTER_READ,       POLL_GROUP_LABEL,     0, 255},
+    {82,  SEREGISTER_TYPE_LABEL,  SEREGISTER_READ,       POLL_GROUP_LABEL,     0, 255},
+    {83,  SEREGISTER_TYPE_LABEL,  SEREGISTER_READ,       POLL_GROUP_LABEL,     0, 255},
+    {48,  SEREGISTER_TYPE_FLAGS,  SEREGISTER_READ_WRITE, POLL_GROUP_SETTING,   0, 0},   // summer ventilation: 0A00 = on, 0800 = off
+    {56,  SEREGISTER_TYPE_NUMBER, SEREGISTER_READ_WRITE, POLL_GROUP_SETTING,   0, 999}, // snooze time [minutes]
+    {58,  SEREGISTER_TYPE_NUMBER, SEREGISTER_READ_WRITE, POLL_GROUP_SETTING,   0, 999}, // dim screen after [minutes]
+    {59,  SEREGISTER_TYPE_NUMBER, SEREGISTER_READ_WRITE, POLL_GROUP_SETTING,   0, 100}, // dim screen by [percent]
+};
+
+constexpr int SERegisterMaxId()
+{
+    int maxId = 0;
+    for (const SERegisterDescriptor &descriptor : SE_REGISTER_DESCRIPTORS)
+    {
+        if (descriptor.Id > maxId) maxId = descriptor.Id;
+    }
+    return maxId;
+}
+
+class SERegisterMap
+{
+public:
+    static constexpr size_t COUNT = sizeof(SE_REGISTER_DESCRIPTORS) / sizeof(SE_REGISTER_DESCRIPTORS[0]);
+    static constexpr int MAX_REGISTER_ID = SERegisterMaxId();
+
+    // Slot of the register in the table and in SERegisterCache, or -1. O(1).
+    static int Find(int registerId);
+    static SERegisterDescriptor Get(size_t slot);
+
+    // Checks access mode and range of a value about to be written.
+    static bool IsValidWrite(size_t slot, const char *value);
+};
+
+#endif
@@ -0,0 +1,94 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SEREGISTERSCANNER_H
+#define SEREGISTERSCANNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SERegisterCache.h"
+
+#define SESCAN_MAX_RESULTS 64
+
+// Pause between two scan requests after a request went unanswered; doubled
+// on every further timeout up to the maximum, reset by the next answer.
+#define SESCAN_BACKOFF_MIN_MILLIS 50
+#define SESCAN_BACKOFF_MAX_MILLIS 2000
+
+struct SEScanResult
+{
+    int RegisterId;
+    char Value[SEREGISTER_VALUE_LENGTH];
+    unsigned long FirstSeenMillis;
+    unsigned long LastChangeMillis;
+    unsigned long Reads;
+    unsigned long Changes;
+    bool Reported; // false until TakeUnreported() handed out the current value
+};
+
+struct SEScanStats
+{
+    unsigned long Requests;
+    unsigned long Answers;
+    unsigned long Timeouts;       // no ACK after all retries
+    unsigned long Sweeps;         // completed passes over the range
+    unsigned long ResultsDropped; // answering registers beyond SESCAN_MAX_RESULTS
+};
+
+// Discovery mode: sweeps a register range with GETs and records every
+// register that answers, its value and how often it changes. The controller
+// only asks for the next register when nothing else is queued, so the scan
+// uses the idle time of the bus and never delays fan control.
+class SERegisterScanner
+{
+private:
+    SEScanResult Results[SESCAN_MAX_RESULTS];
+    size_t Count = 0;
+
+    bool Active = false;
+    bool Continuous = false;
+    int FirstRegister = 0;
+    int LastRegister = -1;
+    int NextRegister = 0;
+    unsigned long IntervalMillis = 0;
+    unsigned long BackoffMillis = 0;
+    unsigned long LastRequestMillis = 0;
+    unsigned long StartMillis = 0;
+    unsigned long StopMillis = 0;
+
+    SEScanResult *Find(int registerId);
+
+public:
+    SEScanStats Stats;
+
+    SERegisterScanner();
+
+    // Sweeps firstRegister..lastRegister once, or over and over if continuous.
+    // Previous results are kept so repeated scans show which values change.
+    void Start(int firstRegister, int lastRegister, bool continuous, unsigned long nowMillis);
+    void Stop(unsigned long nowMillis);
+    bool IsActive() const { return Active; }
+    bool IsInRange(int registerId) const { return registerId >= FirstRegister && registerId <= LastRegister; }
+
+    // Minimum pause between two scan requests; 0 = as fast as the bus allows.
+    void SetInterval(unsigned long intervalMillis) { IntervalMillis = intervalMillis; }
+
+    // Register to ask for next, or -1 if the scan is not due yet or finished.
+    int Next(unsigned long nowMillis);
+    // Every value in range is recorded; only the answer to a scan request counts
+    // for the statistics and ends the backoff.
+    void OnValue(int registerId, const char *value, bool scanAnswer, unsigned long nowMillis);
+    void OnTimeout(int registerId, unsigned long nowMillis);
+
+    // Scan requests per second since Start().
+    float GetRegistersPerSecond(unsigned long nowMillis) const;
+
+    size_t GetCount() const { return Count; }
+    const SEScanResult &GetResult(size_t index) const { return Results[index]; }
+    // A result that is new or changed since it was last taken, or NULL.
+    const SEScanResult *TakeUnreported();
+};
+
+#endif
@@ -0,0 +1,74 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SERINGBUFFER_H
+#define SERINGBUFFER_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Lock-free single-producer/single-consumer byte queue. The producer (an
+// interrupt handler) only writes Head, the consumer (the main loop) only
+// writes Tail; both indices run freely and wrap through the power-of-two size.
+template <size_t SIZE>
+class SERingBuffer
+{
+    static_assert(SIZE > 0 && (SIZE & (SIZE - 1)) == 0, "SERingBuffer size must be a power of two");
+
+private:
+    uint8_t Data[SIZE];
+    std::atomic<uint32_t> Head{0};
+    std::atomic<uint32_t> Tail{0};
+
+public:
+    // Bytes lost because the consumer did not keep up. Only written by the producer.
+    volatile uint32_t Overflows = 0;
+
+    // Producer side.
+    bool Push(uint8_t value)
+    {
+        uint32_t head = Head.load(std::memory_order_relaxed);
+        if (head - Tail.load(std::memory_order_acquire) >= SIZE)
+        {
+            Overflows = Overflows + 1;
+            return false;
+        }
+        Data[head & (SIZE - 1)] = value;
+        Head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side.
+    size_t Available() const
+    {
+        return Head.load(std::memory_order_acquire) - Tail.load(std::memory_order_relaxed);
+    }
+
+    // Consumer side. Copies up to length bytes in at most two memcpy calls.
+    size_t Pop(uint8_t *buffer, size_t length)
+    {
+        uint32_t tail = Tail.load(std::memory_order_relaxed);
+        size_t count = Head.load(std::memory_order_acquire) - tail;
+        if (count > length) count = length;
+
+        size_t offset = tail & (SIZE - 1);
+        size_t first = count < SIZE - offset ? count : SIZE - offset;
+        memcpy(buffer, Data + offset, first);
+        memcpy(buffer + first, Data, count - first);
+
+        Tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    int Pop()
+    {
+        uint8_t value;
+        return Pop(&value, 1) == 1 ? value : -1;
+    }
+};
+
+#endif
@@ -0,0 +1,59 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SESTRINGPOOL_H
+#define SESTRINGPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A table of strings packed back to back into one block, addressed by index
+// through an offset table. It is built at compile time from a constexpr
+// array of literals and meant to be stored in PROGMEM: the literals
+// themselves are only used by the compiler, so neither they nor a pointer
+// per string take up RAM.
+template <size_t SIZE, size_t COUNT>
+struct SEStringPool
+{
+    char Text[SIZE];
+    uint16_t Offsets[COUNT];
+};
+
+constexpr size_t SEStringLength(const char *text)
+{
+    return *text == '\0' ? 0 : 1 + SEStringLength(text + 1);
+}
+
+// Bytes needed for all strings including their terminating NUL.
+template <size_t COUNT>
+constexpr size_t SEStringPoolSize(const char *const (&strings)[COUNT])
+{
+    size_t size = 0;
+    for (size_t i = 0; i < COUNT; i++)
+    {
+        size += SEStringLength(strings[i]) + 1;
+    }
+    return size;
+}
+
+template <size_t SIZE, size_t COUNT>
+constexpr SEStringPool<SIZE, COUNT> SEBuildStringPool(const char *const (&strings)[COUNT])
+{
+    static_assert(SIZE <= 0xFFFF, "Offsets are 16 bit");
+    SEStringPool<SIZE, COUNT> pool = {};
+    size_t offset = 0;
+    for (size_t i = 0; i < COUNT; i++)
+    {
+        pool.Offsets[i] = (uint16_t)offset;
+        for (const char *c = strings[i]; *c != '\0'; c++)
+        {
+            pool.Text[offset++] = *c;
+        }
+        pool.Text[offset++] = '\0';
+    }
+    return pool;
+}
+
+#endif
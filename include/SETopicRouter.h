@@ -0,0 +1,87 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SETOPICROUTER_H
+#define SETOPICROUTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SETOPICROUTER_PREFIX_LENGTH 32
+#define SETOPICROUTER_TOPIC_LENGTH 64
+
+// Hash table size; a power of two of at least twice the number of routes.
+#define SETOPICROUTER_SLOTS 64
+
+enum SETopicAction : uint8_t
+{
+    SETOPIC_SET_REGISTER, // "set/<name>": write the register
+    SETOPIC_SCAN,         // discovery scan control
+    SETOPIC_TRACE         // trace control
+};
+
+struct SETopicRoute
+{
+    const char *Name; // set/, state/ and ack/ topics of a register end in this name
+    uint8_t Action;
+    uint16_t RegisterId;
+};
+
+// Topics the bridge listens to, below the runtime prefix. A register gets
+// set/<name>, state/<name> and ack/<name> topics by appearing here.
+constexpr SETopicRoute SE_TOPIC_ROUTES[] = {
+    {"area-1", SETOPIC_SET_REGISTER, 173},
+    {"area-2", SETOPIC_SET_REGISTER, 174},
+    {"area-3", SETOPIC_SET_REGISTER, 175},
+    {"area-4", SETOPIC_SET_REGISTER, 176},
+    {"area-5", SETOPIC_SET_REGISTER, 177},
+    {"area-6", SETOPIC_SET_REGISTER, 178},
+    {"summer-ventilation", SETOPIC_SET_REGISTER, 48},
+    {"snooze", SETOPIC_SET_REGISTER, 56},
+    {"dim-after", SETOPIC_SET_REGISTER, 58},
+    {"dim-percent", SETOPIC_SET_REGISTER, 59},
+    {"scan/set", SETOPIC_SCAN, 0},
+    {"trace/set", SETOPIC_TRACE, 0},
+};
+
+// FNV-1a, usable at compile time.
+constexpr uint32_t SETopicHash(const char *text, uint32_t hash = 2166136261u)
+{
+    return *text == '\0' ? hash : SETopicHash(text + 1, (hash ^ (uint8_t)*text) * 16777619u);
+}
+
+// Routes an incoming topic to its SE_TOPIC_ROUTES entry in constant time:
+// the prefix is compared once, the rest is hashed and looked up in an open
+// addressing table that is built at compile time and kept in flash. The cost
+// does not grow with the number of routes. The prefix (e.g. "airsystem" or
+// "building/zone-2") is set at runtime and also used to build outgoing topics.
+class SETopicRouter
+{
+private:
+    char Prefix[SETOPICROUTER_PREFIX_LENGTH];
+    size_t PrefixLength;
+
+public:
+    static constexpr size_t COUNT = sizeof(SE_TOPIC_ROUTES) / sizeof(SE_TOPIC_ROUTES[0]);
+
+    explicit SETopicRouter(const char *prefix);
+    void SetPrefix(const char *prefix);
+    const char *GetPrefix() const { return Prefix; }
+
+    // Index into SE_TOPIC_ROUTES of a complete topic, or -1.
+    int Route(const char *topic) const;
+    // Index of the route below the prefix, e.g. "set/area-1", or -1.
+    static int Find(const char *suffix);
+    // Index of the set/<name> route of a register, or -1.
+    static int FindRegister(int registerId);
+    static const SETopicRoute &Get(int route) { return SE_TOPIC_ROUTES[route]; }
+
+    // "<prefix>/<group>/<name>" of a register route, e.g. group "state"; returns the length, 0 if cut off.
+    size_t Format(char *buffer, size_t size, const char *group, int route) const;
+    // "<prefix>/<suffix>"; returns the length, 0 if cut off.
+    size_t Format(char *buffer, size_t size, const char *suffix) const;
+};
+
+#endif
@@ -0,0 +1,108 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SETRACE_H
+#define SETRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Number of entries kept; a power of two. 12 bytes each.
+#ifndef SETRACE_CAPACITY
+#define SETRACE_CAPACITY 256
+#endif
+
+// After an armed trigger fired, this many entries are still recorded before
+// the trace freezes, so the dump shows what led up to the failure and what followed.
+#define SETRACE_POST_TRIGGER_ENTRIES (SETRACE_CAPACITY / 4)
+
+#define SETRACE_LINE_LENGTH 64
+
+enum SETraceEvent
+{
+    SETRACE_TX_GET = 1,      // value: attempt, detail: priority
+    SETRACE_TX_SET,          // value: written value, detail: attempt
+    SETRACE_TX_ACK,
+    SETRACE_RX_ACK,
+    SETRACE_RX_VALUE,        // value: received value
+    SETRACE_RX_ERROR,        // value: new parser errors, detail: SETRACE_ERROR_* bits
+    SETRACE_ACK_TIMEOUT,     // value: attempt
+    SETRACE_REQUEST_FAILED,  // no ACK after all retries; fires an armed trigger
+    SETRACE_WRITE_CONFIRMED,
+    SETRACE_WRITE_MISMATCH,  // value: value read back
+    SETRACE_WRITE_FAILED,
+    SETRACE_SCAN_START,      // register: first, value: last
+    SETRACE_SCAN_STOP,
+    SETRACE_EVENT_COUNT
+};
+
+#define SETRACE_ERROR_OVERFLOW 0x01
+#define SETRACE_ERROR_CRC 0x02
+#define SETRACE_ERROR_TRUNCATED 0x04
+#define SETRACE_ERROR_MALFORMED 0x08
+
+struct SETraceEntry
+{
+    uint32_t Micros;
+    uint8_t Event;
+    uint8_t Detail;
+    uint16_t RegisterId;
+    int32_t Value;
+};
+
+// Binary record of every frame on the bus and every state change of the
+// controller. Recording is a few stores into a fixed array, cheap enough to
+// stay on in production. Entries are addressed by a running sequence number;
+// the buffer keeps the last SETRACE_CAPACITY of them. There is one writer
+// (the main loop), and readers detect overwritten entries through the
+// sequence number instead of taking a lock.
+class SETrace
+{
+private:
+    SETraceEntry Entries[SETRACE_CAPACITY];
+    uint32_t Head = 0; // sequence number of the next entry
+    bool Armed = false;
+    bool Frozen = false;
+    uint32_t FreezeAt = 0;
+
+public:
+    void Record(uint32_t micros, uint8_t event, int registerId, int32_t value, uint8_t detail = 0)
+    {
+        if (Frozen) return;
+        SETraceEntry &entry = Entries[Head & (SETRACE_CAPACITY - 1)];
+        entry.Micros = micros;
+        entry.Event = event;
+        entry.Detail = detail;
+        entry.RegisterId = (uint16_t)registerId;
+        entry.Value = value;
+        Head++;
+
+        if (Armed && event == SETRACE_REQUEST_FAILED)
+        {
+            Armed = false;
+            FreezeAt = Head + SETRACE_POST_TRIGGER_ENTRIES;
+        }
+        if (FreezeAt != 0 && Head == FreezeAt) Frozen = true;
+    }
+
+    // Freezes the trace shortly after the next request that fails for good.
+    void Arm();
+    // Starts recording again after a freeze and disarms the trigger.
+    void Resume();
+    void Clear();
+    bool IsArmed() const { return Armed; }
+    bool IsFrozen() const { return Frozen; }
+
+    uint32_t GetHead() const { return Head; }
+    uint32_t GetOldest() const { return Head > SETRACE_CAPACITY ? Head - SETRACE_CAPACITY : 0; }
+    // Copies the entry with the given sequence number; false if it was overwritten or not written yet.
+    bool Get(uint32_t sequence, SETraceEntry &entry) const;
+
+    static const char *EventName(uint8_t event);
+    // One text line "sequence micros event register value detail\n"; returns its length.
+    static size_t Format(uint32_t sequence, const SETraceEntry &entry, char *buffer, size_t size);
+};
+
+#endif
@@ -0,0 +1,58 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SETRANSPORT_H
+#define SETRANSPORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Byte stream between the bridge and the SEC-Touch. The SEController only
+// talks to this interface, so the protocol core runs unchanged on the
+// ESP8266 (SoftwareSerial) and on a Linux host (in-memory streams).
+class SETransport
+{
+public:
+    virtual ~SETransport() {}
+    virtual int Available() = 0;
+    virtual int Read() = 0;
+    virtual size_t Write(const uint8_t *buffer, size_t length) = 0;
+
+    // Reads up to length bytes that are already available, without waiting.
+    // Buffered transports override this to avoid a virtual call per byte.
+    virtual size_t ReadBytes(uint8_t *buffer, size_t length)
+    {
+        size_t count = 0;
+        while (count < length && Available() > 0)
+        {
+            int value = Read();
+            if (value < 0) break;
+            buffer[count++] = (uint8_t)value;
+        }
+        return count;
+    }
+};
+
+// Time source used for all protocol timeouts and poll intervals.
+class SEClock
+{
+public:
+    virtual ~SEClock() {}
+    virtual unsigned long Millis() = 0;
+    virtual unsigned long Micros() = 0;
+};
+
+// A small block of data kept across restarts, e.g. a file on LittleFS.
+class SEStorage
+{
+public:
+    virtual ~SEStorage() {}
+    // Returns the number of bytes read, 0 if nothing was saved yet.
+    virtual size_t Load(uint8_t *buffer, size_t size) = 0;
+    // Replaces the saved data as a whole.
+    virtual bool Save(const uint8_t *buffer, size_t length) = 0;
+};
+
+#endif
@@ -0,0 +1,57 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SEUNITSCHEDULER_H
+#define SEUNITSCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SEController.h"
+#include "SEHistogram.h"
+
+// One hardware UART plus SoftwareSerial ports on the remaining free pin pairs.
+#define SEUNITSCHEDULER_MAX_UNITS 4
+
+// Services several SEController instances, one per SEC-Touch unit, from one
+// loop. Every Poll() polls each unit once. The unit that goes first moves on
+// by one per call, so a unit whose poll takes long does not always delay the
+// same neighbour. The time between two polls of a unit is recorded per unit;
+// as long as it stays below the wire time of a frame, adding units does not
+// cost any unit throughput.
+class SEUnitScheduler
+{
+private:
+    struct Unit
+    {
+        const char *Name;
+        SEController *Controller;
+        SEHistogram GapMicros;
+        unsigned long LastPollMicros;
+        unsigned long Polls;
+
+        Unit();
+    };
+
+    SEClock *Clock;
+    Unit Units[SEUNITSCHEDULER_MAX_UNITS];
+    uint8_t Count = 0;
+    uint8_t Next = 0;
+
+public:
+    explicit SEUnitScheduler(SEClock *clock);
+
+    // Returns the unit index, or -1 if all SEUNITSCHEDULER_MAX_UNITS are taken. The name must stay valid.
+    int Add(const char *name, SEController *controller);
+    void Poll();
+
+    size_t GetCount() const { return Count; }
+    const char *GetName(size_t unit) const { return Units[unit].Name; }
+    SEController *GetController(size_t unit) const { return Units[unit].Controller; }
+    // Microseconds between two polls of the unit.
+    const SEHistogram &GetGapMicros(size_t unit) const { return Units[unit].GapMicros; }
+    unsigned long GetPolls(size_t unit) const { return Units[unit].Polls; }
+};
+
+#endif
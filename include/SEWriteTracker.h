@@ -0,0 +1,101 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SEWRITETRACKER_H
+#define SEWRITETRACKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "SEController.h"
+#include "SEHistogram.h"
+
+#define SEWRITETRACKER_ID_LENGTH 16
+#define SEWRITETRACKER_REPORTS 8
+
+// A write without outcome after this long is reported as timed out.
+#define SEWRITETRACKER_TIMEOUT_MILLIS 10000
+// The same command arriving again within this window is a redelivery, not a new write.
+#define SEWRITETRACKER_DEDUP_MILLIS 5000
+
+enum SETrackedResult
+{
+    SETRACKED_CONFIRMED,
+    SETRACKED_FAILED,
+    SETRACKED_SUPERSEDED, // replaced by a newer write before it was confirmed
+    SETRACKED_REJECTED,   // refused by SECommandArbiter or the register map
+    SETRACKED_TIMEOUT
+};
+
+struct SEWriteReport
+{
+    int RegisterId;
+    char Id[SEWRITETRACKER_ID_LENGTH]; // empty if the sender gave none
+    char Value[SECONTROLLER_VALUE_LENGTH];
+    uint8_t Result;
+    unsigned long LatencyMillis; // received until the outcome was known
+};
+
+struct SEWriteTrackerStats
+{
+    unsigned long Writes;
+    unsigned long Duplicates;
+    unsigned long Results[SETRACKED_TIMEOUT + 1];
+    unsigned long ReportsDropped; // report queue full, oldest report lost
+};
+
+// Follows writes of one frontend from the command to the confirmed read-back,
+// so the sender can be told the outcome. A command may carry an id; a
+// repeated command within SEWRITETRACKER_DEDUP_MILLIS is recognised as a
+// redelivery and answered with the outcome of the first one instead of being
+// written again. Without an id, only the same value counts, and only while the
+// first write is pending or the register still holds the value; a change at
+// the panel in between makes it a new command. Outcomes are
+// queued as reports and taken by the frontend outside of SEController::Poll().
+class SEWriteTracker : public SEWriteListener
+{
+private:
+    struct Entry
+    {
+        char Id[SEWRITETRACKER_ID_LENGTH];
+        char Value[SECONTROLLER_VALUE_LENGTH];
+        unsigned long ReceivedMillis;
+        unsigned long CompletedMillis;
+        bool Used;
+        bool Pending;
+        uint8_t Result;
+    };
+
+    SEController *Controller;
+    SEClock *Clock;
+    Entry Entries[SERegisterMap::COUNT];
+    SEWriteReport Reports[SEWRITETRACKER_REPORTS];
+    uint8_t ReportHead = 0;
+    uint8_t ReportCount = 0;
+
+    void Complete(size_t slot, uint8_t result);
+    void QueueReport(size_t slot, uint8_t result, unsigned long latencyMillis);
+
+public:
+    SEWriteTrackerStats Stats;
+    // Command received until confirmed read-back, in milliseconds.
+    SEHistogram LatencyMillis;
+
+    SEWriteTracker(SEController *controller, SEClock *clock);
+
+    // Call before writing. Returns false for a redelivered command, which must not be written again.
+    bool Begin(int registerId, const char *value, const char *id);
+    // The write handed over in Begin() was not accepted.
+    void Reject(int registerId);
+    // Reports timeouts.
+    void Poll();
+    // Oldest unsent report, or NULL. Valid until the next call of any method.
+    const SEWriteReport *TakeReport();
+
+    void OnWriteCompleted(SEController *controller, int registerId, const char *value, SEWriteResult result) override;
+
+    static const char *ResultName(uint8_t result);
+};
+
+#endif
@@ -6,31 +6,91 @@
 #ifndef WEBINTERFACE_H
 #define WEBINTERFACE_H
 
-#include <ESP8266WebServer.h>
+#include "HttpServer.h"
+#include "SECommandArbiter.h"
 #include "SEController.h"
+#include "SEAreaNames.h"
+#include "SEMetrics.h"
+#include "SETransport.h"
 
-class WebInterface {
+#define WEB_SOURCE_PRECEDENCE 1
+#define WEB_DEFAULT_PORT 80
+// Time for the answer to /restart to leave before the restart.
+#define WEB_RESTART_DELAY_MILLIS 100
+
+// Open /events connections; each one takes a connection of the HTTP server.
+#define EVENT_CLIENTS_MAX 4
+#define EVENT_KEEPALIVE_MILLIS 30000
+
+struct WebEventStats {
+    unsigned long Accepted;
+    unsigned long Rejected; // EVENT_CLIENTS_MAX reached
+    unsigned long EventsSent;
+};
+
+struct WebPageStats {
+    unsigned long Requests;
+    unsigned long NotModified; // answered with 304
+};
+
+class WebInterface : public SERegisterListener {
 private:
-    ESP8266WebServer server;
+    HttpServer server;
     SEController* SEC;
+    SECommandArbiter* arbiter;
+    SEMetrics* metrics = NULL;
+    const SEUnitScheduler* units = NULL;
+    SEStorage* languageStorage = NULL;
+    int source;
+
+    static const int FAN_COUNT = SEAREA_COUNT;
+
+    WebEventStats eventStats = {};
+    WebPageStats pageStats = {};
+    uint8_t pendingLevels = 0;
+    uint8_t pendingLabels = 0;
+    unsigned long lastKeepAliveMillis = 0;
+
+    bool restartPending = false;
+    unsigned long restartMillis = 0;
 
-    static const int FAN_COUNT = 6;
-    int fanLevels[FAN_COUNT];
-    String fanLabels[FAN_COUNT];
+    void handleRoot(HttpConnection& request);
+    void handleSetLevel(HttpConnection& request);
+    void handleGetLevels(HttpConnection& request);
+    void handleRestart(HttpConnection& request);
+    void handleGetScan(HttpConnection& request);
+    void handleSetScan(HttpConnection& request);
+    void handleEvents(HttpConnection& request);
+    void handleStats(HttpConnection& request);
+    void handleGetTrace(HttpConnection& request);
+    void handleSetTrace(HttpConnection& request);
+    void handleMetrics(HttpConnection& request);
+    void handleSetLanguage(HttpConnection& request);
 
-    void handleRoot();
-    void handleSetLevel();
-    void handleGetLevels();
-    void handleRestart();
+    // Items of the chunked responses, see HttpItemWriter.
+    bool writeLevels(JsonWriter& json, uint32_t item);
+    bool writeStats(JsonWriter& json, uint32_t item);
+    bool writeScan(JsonWriter& json, uint32_t item, size_t count);
+    bool writeTrace(JsonWriter& text, uint32_t item, uint32_t head);
 
-    void onRegisterChanged(SEController* seController, int registerId, const char* value);
+    void sendEvent(const char* data, size_t length);
+    void flushEvents();
 
-    String escapeJsonString(const String& input);
+    // Read from the controller's register cache; no bus traffic.
+    int getFanLevel(int index);
+    // Either a name from the label table or a fallback written into buffer.
+    const char* getFanLabel(int index, char* buffer, size_t size);
 
 public:
-    WebInterface(SEController* sec);
+    WebInterface(SEController* sec, SECommandArbiter* arbiter, int port = WEB_DEFAULT_PORT);
     void begin();
+    // Enables the Prometheus endpoint /metrics with the metrics of all units.
+    void setMetrics(SEMetrics* metrics, const SEUnitScheduler* units);
+    // Keeps the language chosen with POST /language across restarts: the saved
+    // language is applied now and every change is saved.
+    void setLanguageStorage(SEStorage* storage);
     void loop();
+    void OnRegisterChanged(SEController* controller, int registerId, const char* value) override;
 };
 
 #endif
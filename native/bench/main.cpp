@@ -0,0 +1,631 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+// Host benchmark for the SEController protocol core.
+//
+//   pio run -e native -t exec                         (built-in capture)
+//   .pio/build/native/program capture.bin             (raw capture of the RX line)
+//   .pio/build/native/program --soak 10000000         (long run, fails on heap growth)
+//
+// Reports frames/second, per-frame latency and heap use of Poll(),
+// SEFrameParser, ProcessMessage(), GetXModemCRC(), MQTT topic routing and request encoding. The soak run feeds the
+// capture through Poll() and serializes the levels and scan results the way
+// the MQTT bridge and the web interface do, and exits non-zero if the heap
+// grows after the warm-up.
+
+#include <algorithm>
+#include <chrono>
+#include <malloc.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "HostPlatform.h"
+#include "JsonWriter.h"
+#include "SEController.h"
+#include "SEFrameEncoder.h"
+#include "SERingBuffer.h"
+#include "SETopicRouter.h"
+#include "XModemCRC.h"
+
+// ---- heap accounting --------------------------------------------------------
+
+static size_t HeapAllocations = 0;
+static size_t HeapCurrent = 0;
+static size_t HeapPeak = 0;
+
+void *operator new(size_t size)
+{
+    void *p = malloc(size);
+    if (p == NULL) throw std::bad_alloc();
+    HeapAllocations++;
+    HeapCurrent += malloc_usable_size(p);
+    HeapPeak = std::max(HeapPeak, HeapCurrent);
+    return p;
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void *p) noexcept
+{
+    if (p == NULL) return;
+    HeapCurrent -= malloc_usable_size(p);
+    free(p);
+}
+
+void operator delete[](void *p) noexcept { operator delete(p); }
+void operator delete(void *p, size_t) noexcept { operator delete(p); }
+void operator delete[](void *p, size_t) noexcept { operator delete(p); }
+
+struct HeapSnapshot
+{
+    size_t Allocations;
+    size_t Current;
+
+    // Also restarts peak tracking, so HeapPeak - Current is the high-water mark since the snapshot.
+    static HeapSnapshot Take()
+    {
+        HeapPeak = HeapCurrent;
+        return HeapSnapshot{HeapAllocations, HeapCurrent};
+    }
+};
+
+// ---- access to the controller internals -------------------------------------
+
+class SEControllerBenchmark
+{
+public:
+    static void ProcessMessage(SEController &controller, const SEFrame &frame)
+    {
+        controller.ProcessMessage(frame);
+    }
+};
+
+// ---- capture ----------------------------------------------------------------
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double ElapsedNanos(BenchClock::time_point start, BenchClock::time_point end)
+{
+    return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+}
+
+static void AppendFrame(std::string &capture, int commandId, int registerId, const char *value)
+{
+    char frame[64];
+    int len = snprintf(frame, sizeof(frame), "%c%d%c%d%c%s%c", STX, commandId, TAB, registerId, TAB, value, TAB);
+    unsigned short crc = GetXModemCRC(frame, len);
+    len += snprintf(frame + len, sizeof(frame) - len, "%u%c", crc, ETX);
+    capture.append(frame, len);
+}
+
+static void AppendAck(std::string &capture)
+{
+    const char ack[] = {STX, ACK, ETX};
+    capture.append(ack, sizeof(ack));
+}
+
+// Mirrors what the SEC-Touch sends while the bridge polls: an ACK for every
+// request followed by the register value. Values change every few rounds so
+// the register-changed path is exercised as well.
+static std::string BuildCapture(int rounds)
+{
+    static const int registers[] = {173, 174, 175, 176, 177, 178, 78, 79, 80, 81, 82, 83};
+    std::string capture;
+    for (int round = 0; round < rounds; round++)
+    {
+        for (int registerId : registers)
+        {
+            char value[16];
+            snprintf(value, sizeof(value), "%d", registerId >= 173 ? (round / 4 + registerId) % 7 : registerId - 70);
+            AppendAck(capture);
+            AppendFrame(capture, COMMANDID_SET, registerId, value);
+        }
+    }
+    return capture;
+}
+
+static bool LoadCapture(const char *path, std::string &capture)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) return false;
+    char chunk[4096];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    {
+        capture.append(chunk, read);
+    }
+    fclose(file);
+    return true;
+}
+
+// Splits the capture into complete frames (STX ... ETX).
+static std::vector<std::string> SplitFrames(const std::string &capture)
+{
+    std::vector<std::string> frames;
+    size_t start = capture.find((char)STX);
+    while (start != std::string::npos)
+    {
+        size_t end = capture.find((char)ETX, start);
+        if (end == std::string::npos) break;
+        frames.push_back(capture.substr(start, end - start + 1));
+        start = capture.find((char)STX, end);
+    }
+    return frames;
+}
+
+// ---- reporting --------------------------------------------------------------
+
+static void PrintHeader()
+{
+    printf("%-20s %12s %10s %10s %10s %10s %10s %10s\n", "benchmark", "ops/s", "mean ns", "p50 ns", "p99 ns", "max ns", "allocs/op", "heap B");
+}
+
+static void PrintResult(const char *name, std::vector<double> &samples, double totalNanos, size_t operations, const HeapSnapshot &heap)
+{
+    std::sort(samples.begin(), samples.end());
+    double p50 = samples.empty() ? 0 : samples[samples.size() / 2];
+    double p99 = samples.empty() ? 0 : samples[(samples.size() * 99) / 100];
+    double max = samples.empty() ? 0 : samples.back();
+    printf("%-20s %12.0f %10.1f %10.0f %10.0f %10.0f %10.2f %10zu\n",
+           name,
+           operations / (totalNanos / 1e9),
+           totalNanos / operations,
+           p50, p99, max,
+           (double)(HeapAllocations - heap.Allocations) / operations,
+           HeapPeak - heap.Current);
+}
+
+// ---- benchmarks -------------------------------------------------------------
+
+static void BenchmarkCRC(const std::vector<std::string> &frames, int iterations)
+{
+    // Pass 0 reads the lookup table, pass 1 uses the shift form the frame encoder uses.
+    for (int pass = 0; pass < 2; pass++)
+    {
+        std::vector<double> samples;
+        samples.reserve(iterations);
+        HeapSnapshot heap = HeapSnapshot::Take();
+        volatile unsigned short sink = 0;
+        double total = 0;
+        size_t operations = 0;
+
+        for (int i = 0; i < iterations; i++)
+        {
+            const std::string &frame = frames[i % frames.size()];
+            BenchClock::time_point start = BenchClock::now();
+            unsigned short crc = 0;
+            if (pass == 0)
+            {
+                crc = GetXModemCRC(frame.data(), frame.size() - 1);
+            }
+            else
+            {
+                for (size_t j = 0; j + 1 < frame.size(); j++) crc = UpdateXModemCRCShift(crc, frame[j]);
+            }
+            sink = sink ^ crc;
+            double elapsed = ElapsedNanos(start, BenchClock::now());
+            samples.push_back(elapsed);
+            total += elapsed;
+            operations++;
+        }
+        PrintResult(pass == 0 ? "GetXModemCRC" : "XModemCRC shift", samples, total, operations, heap);
+    }
+}
+
+static void BenchmarkParser(const std::vector<std::string> &frames, int iterations)
+{
+    SEFrameParser parser;
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    HeapSnapshot heap = HeapSnapshot::Take();
+    double total = 0;
+    size_t completed = 0;
+
+    for (int i = 0; i < iterations; i++)
+    {
+        const std::string &frame = frames[i % frames.size()];
+        const uint8_t *bytes = (const uint8_t *)frame.data();
+        BenchClock::time_point start = BenchClock::now();
+        for (size_t j = 0; j < frame.size(); j++)
+        {
+            if (parser.Push(bytes[j])) completed++;
+        }
+        double elapsed = ElapsedNanos(start, BenchClock::now());
+        samples.push_back(elapsed);
+        total += elapsed;
+    }
+    PrintResult("SEFrameParser", samples, total, iterations, heap);
+    printf("%-20s %12zu frames, %lu overflow, %lu CRC, %lu truncated, %lu malformed\n", "", completed,
+           parser.Errors.Overflows, parser.Errors.CrcMismatches, parser.Errors.Truncated, parser.Errors.Malformed);
+}
+
+static void BenchmarkProcessMessage(const std::vector<std::string> &frames, int iterations)
+{
+    MemoryTransport transport;
+    ManualClock clock;
+    SEController controller(&transport, &clock);
+
+    // ProcessMessage() gets the frame the parser completed, as Poll() hands it over.
+    std::vector<SEFrameParser> parsed(frames.size());
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        for (char value : frames[i]) parsed[i].Push((uint8_t)value);
+    }
+
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    HeapSnapshot heap = HeapSnapshot::Take();
+    double total = 0;
+
+    for (int i = 0; i < iterations; i++)
+    {
+        const SEFrameParser &parser = parsed[i % parsed.size()];
+        BenchClock::time_point start = BenchClock::now();
+        SEControllerBenchmark::ProcessMessage(controller, parser.Frame());
+        double elapsed = ElapsedNanos(start, BenchClock::now());
+        samples.push_back(elapsed);
+        total += elapsed;
+    }
+    PrintResult("ProcessMessage", samples, total, iterations, heap);
+}
+
+static void BenchmarkPoll(const std::vector<std::string> &frames, int iterations)
+{
+    MemoryTransport transport;
+    ManualClock clock;
+    SEController controller(&transport, &clock);
+
+    std::vector<double> samples;
+    samples.reserve(iterations);
+    HeapSnapshot heap = HeapSnapshot::Take();
+    double total = 0;
+    size_t polls = 0;
+
+    for (int i = 0; i < iterations; i++)
+    {
+        const std::string &frame = frames[i % frames.size()];
+
+        // Leave the idle gap of a request cycle before every frame so the ACK
+        // and send paths of Poll() run as they do on the wire.
+        clock.AdvanceMillis(PROCESS_SENDBUFFER_DELAY_MILLIS + 2);
+        BenchClock::time_point start = BenchClock::now();
+        controller.Poll();
+        polls++;
+        transport.SetInput((const uint8_t *)frame.data(), frame.size());
+        while (transport.Remaining() > 0)
+        {
+            controller.Poll();
+            polls++;
+        }
+        double elapsed = ElapsedNanos(start, BenchClock::now());
+        samples.push_back(elapsed);
+        total += elapsed;
+    }
+    PrintResult("Poll (per frame)", samples, total, iterations, heap);
+    printf("%-20s %12.2f polls/frame, %zu bytes sent\n", "", (double)polls / iterations, transport.BytesWritten);
+}
+
+// Cost per received byte of the old per-byte Available()/Read() path compared
+// with draining the ring buffer of the hardware UART transport in one call.
+static void BenchmarkRingBuffer(const std::string &capture, int rounds)
+{
+    static SERingBuffer<512> ring;
+    uint8_t chunk[64];
+    volatile uint8_t sink = 0;
+    double perByteNanos = 0;
+    double bulkNanos = 0;
+    size_t bytes = 0;
+
+    for (int round = 0; round < rounds; round++)
+    {
+        for (size_t offset = 0; offset < capture.size(); offset += 256)
+        {
+            size_t count = std::min<size_t>(256, capture.size() - offset);
+
+            for (size_t i = 0; i < count; i++) ring.Push(capture[offset + i]);
+            BenchClock::time_point start = BenchClock::now();
+            while (ring.Available() > 0) sink = sink ^ (uint8_t)ring.Pop();
+            perByteNanos += ElapsedNanos(start, BenchClock::now());
+
+            for (size_t i = 0; i < count; i++) ring.Push(capture[offset + i]);
+            start = BenchClock::now();
+            size_t read;
+            while ((read = ring.Pop(chunk, sizeof(chunk))) > 0) sink = sink ^ chunk[read - 1];
+            bulkNanos += ElapsedNanos(start, BenchClock::now());
+
+            bytes += count;
+        }
+    }
+    printf("%-20s %12.2f ns/byte per-byte, %.2f ns/byte bulk, %u overflows\n", "SERingBuffer", perByteNanos / bytes, bulkNanos / bytes, (unsigned)ring.Overflows);
+}
+
+// Topic to route with one strcmp per known topic, as the bridge did before,
+// compared with the hashed lookup of SETopicRouter.
+static void BenchmarkTopicRouting(int iterations)
+{
+    SETopicRouter router("building/unit-2");
+    std::vector<std::string> known;
+    for (size_t route = 0; route < SETopicRouter::COUNT; route++)
+    {
+        char topic[SETOPICROUTER_TOPIC_LENGTH];
+        const SETopicRoute &entry = SETopicRouter::Get(route);
+        if (entry.Action == SETOPIC_SET_REGISTER) router.Format(topic, sizeof(topic), "set", route);
+        else router.Format(topic, sizeof(topic), entry.Name);
+        known.push_back(topic);
+    }
+    std::vector<std::string> topics = known;
+    topics.push_back("building/unit-2/set/unknown");
+    topics.push_back("building/unit-1/set/area-1");
+
+    // One sample routes every topic once; the clock would dominate a single lookup.
+    volatile int sink = 0;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        std::vector<double> samples;
+        samples.reserve(iterations);
+        HeapSnapshot heap = HeapSnapshot::Take();
+        double total = 0;
+        for (int i = 0; i < iterations; i++)
+        {
+            BenchClock::time_point start = BenchClock::now();
+            for (const std::string &topic : topics)
+            {
+                int route = -1;
+                if (pass == 0)
+                {
+                    for (size_t index = 0; index < known.size(); index++)
+                    {
+                        if (strcmp(topic.c_str(), known[index].c_str()) == 0)
+                        {
+                            route = index;
+                            break;
+                        }
+                    }
+                }
+                else
+                {
+                    route = router.Route(topic.c_str());
+                }
+                sink = sink + route;
+            }
+            double elapsed = ElapsedNanos(start, BenchClock::now()) / topics.size();
+            samples.push_back(elapsed);
+            total += elapsed;
+        }
+        PrintResult(pass == 0 ? "topic strcmp" : "SETopicRouter", samples, total, iterations, heap);
+    }
+}
+
+// Request encoding as SEController did it before, with two snprintf calls
+// and a second pass for the CRC.
+static size_t EncodePrintf(char *buffer, size_t size, int registerId, const char *value)
+{
+    int len;
+    if (value != NULL) len = snprintf(buffer, size, "%c%d%c%d%c%s%c", STX, COMMANDID_SET, TAB, registerId, TAB, value, TAB);
+    else len = snprintf(buffer, size, "%c%d%c%d%c", STX, COMMANDID_GET, TAB, registerId, TAB);
+    unsigned short crc = GetXModemCRC(buffer, len);
+    len += snprintf(buffer + len, size - len, "%u%c", crc, ETX);
+    return len;
+}
+
+// GET frames of the polled registers (from flash), GET frames of scanned
+// registers and SET frames, each encoded the old way and with SEFrameEncoder.
+// The frames must match byte for byte.
+static void BenchmarkEncoder(int iterations)
+{
+    struct Case
+    {
+        const char *Name;
+        int RegisterId;
+        const char *Value;
+    };
+    static const Case cases[] = {
+        {"GET mapped", 173, NULL}, {"GET mapped", 78, NULL}, {"GET mapped", 59, NULL},
+        {"GET scan", 7, NULL}, {"GET scan", 250, NULL}, {"GET scan", 1200, NULL},
+        {"SET", 173, "4"}, {"SET", 48, "0A00"}, {"SET", 56, "120"}};
+
+    size_t mismatches = 0;
+    for (const Case &test : cases)
+    {
+        char expected[64];
+        char actual[64];
+        size_t expectedLength = EncodePrintf(expected, sizeof(expected), test.RegisterId, test.Value);
+        size_t actualLength = test.Value != NULL
+                                  ? SEFrameEncoder::EncodeSet(actual, sizeof(actual), test.RegisterId, test.Value)
+                                  : SEFrameEncoder::EncodeGet(actual, sizeof(actual), test.RegisterId);
+        if (actualLength != expectedLength || memcmp(expected, actual, expectedLength) != 0) mismatches++;
+    }
+
+    const char *kinds[] = {"GET mapped", "GET scan", "SET"};
+    for (const char *kind : kinds)
+    {
+        std::vector<Case> selected;
+        for (const Case &test : cases)
+        {
+            if (strcmp(test.Name, kind) == 0) selected.push_back(test);
+        }
+        for (int pass = 0; pass < 2; pass++)
+        {
+            std::vector<double> samples;
+            samples.reserve(iterations);
+            HeapSnapshot heap = HeapSnapshot::Take();
+            volatile size_t sink = 0;
+            double total = 0;
+            for (int i = 0; i < iterations; i++)
+            {
+                // One sample encodes every frame of the kind ten times; the clock would dominate a single one.
+                char frame[64];
+                BenchClock::time_point start = BenchClock::now();
+                for (int repeat = 0; repeat < 10; repeat++)
+                {
+                    for (const Case &test : selected)
+                    {
+                        if (pass == 0) sink = sink + EncodePrintf(frame, sizeof(frame), test.RegisterId, test.Value);
+                        else if (test.Value != NULL) sink = sink + SEFrameEncoder::EncodeSet(frame, sizeof(frame), test.RegisterId, test.Value);
+                        else sink = sink + SEFrameEncoder::EncodeGet(frame, sizeof(frame), test.RegisterId);
+                    }
+                }
+                double elapsed = ElapsedNanos(start, BenchClock::now()) / (10 * selected.size());
+                samples.push_back(elapsed);
+                total += elapsed;
+            }
+            char name[32];
+            snprintf(name, sizeof(name), "%s %s", pass == 0 ? "snprintf" : "encoder", kind);
+            PrintResult(name, samples, total, iterations, heap);
+        }
+    }
+    printf("%-20s %12zu of %zu frames differ from the snprintf encoding\n", "", mismatches, sizeof(cases) / sizeof(cases[0]));
+    if (mismatches != 0) exit(1);
+}
+
+// ---- soak -------------------------------------------------------------------
+
+class CountingSink : public JsonSink
+{
+public:
+    size_t Bytes = 0;
+
+    void Write(const char *data, size_t length) override
+    {
+        Bytes += length;
+    }
+};
+
+static void SerializeLevels(SEController &controller, JsonWriter &json)
+{
+    json.BeginArray();
+    for (int i = 0; i < 6; i++)
+    {
+        const char *level = controller.GetRegisterValue(173 + i);
+        json.BeginObject()
+            .Member("index", i)
+            .Member("level", level == NULL ? 0 : atoi(level))
+            .Member("label", controller.GetRegisterValue(78 + i))
+            .EndObject();
+    }
+    json.EndArray();
+}
+
+static void SerializeScan(SERegisterScanner &scanner, JsonWriter &json, unsigned long now)
+{
+    json.BeginObject()
+        .Member("active", scanner.IsActive())
+        .Member("registersPerSecond", scanner.GetRegistersPerSecond(now), 1)
+        .Member("requests", scanner.Stats.Requests);
+    json.Key("registers").BeginArray();
+    for (size_t i = 0; i < scanner.GetCount(); i++)
+    {
+        const SEScanResult &result = scanner.GetResult(i);
+        json.BeginObject()
+            .Member("register", result.RegisterId)
+            .Member("value", (const char *)result.Value)
+            .Member("changes", result.Changes)
+            .EndObject();
+    }
+    json.EndArray().EndObject();
+}
+
+static bool Soak(const std::vector<std::string> &frames, unsigned long iterations)
+{
+    MemoryTransport transport;
+    ManualClock clock;
+    SEController controller(&transport, &clock);
+    controller.StartScan(0, 255, true);
+
+    CountingSink sink;
+    char buffer[256];
+    const unsigned long warmup = std::min<unsigned long>(iterations / 10, 10000);
+    HeapSnapshot heap = HeapSnapshot::Take();
+    BenchClock::time_point start = BenchClock::now();
+
+    for (unsigned long i = 0; i < iterations; i++)
+    {
+        if (i == warmup) heap = HeapSnapshot::Take();
+
+        const std::string &frame = frames[i % frames.size()];
+        clock.AdvanceMillis(PROCESS_SENDBUFFER_DELAY_MILLIS + 2);
+        controller.Poll();
+        transport.SetInput((const uint8_t *)frame.data(), frame.size());
+        while (transport.Remaining() > 0) controller.Poll();
+
+        JsonWriter json(buffer, sizeof(buffer), &sink);
+        SerializeLevels(controller, json);
+        json.Flush();
+        if (i % 16 == 0)
+        {
+            json.Reset();
+            SerializeScan(controller.GetScanner(), json, clock.Millis());
+            json.Flush();
+        }
+    }
+
+    double seconds = ElapsedNanos(start, BenchClock::now()) / 1e9;
+    size_t allocations = HeapAllocations - heap.Allocations;
+    long growth = (long)HeapCurrent - (long)heap.Current;
+    printf("soak: %lu frames in %.1f s, %zu JSON bytes, %zu allocations and %ld bytes heap growth after warm-up\n",
+           iterations, seconds, sink.Bytes, allocations, growth);
+    return allocations == 0 && growth == 0;
+}
+
+int main(int argc, char **argv)
+{
+    std::string capture;
+    const char *capturePath = NULL;
+    unsigned long soakIterations = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--soak") == 0 && i + 1 < argc)
+        {
+            soakIterations = strtoul(argv[++i], NULL, 10);
+        }
+        else
+        {
+            capturePath = argv[i];
+        }
+    }
+
+    if (capturePath != NULL)
+    {
+        if (!LoadCapture(capturePath, capture))
+        {
+            fprintf(stderr, "Cannot read capture %s\n", capturePath);
+            return 1;
+        }
+    }
+    else
+    {
+        capture = BuildCapture(100);
+    }
+
+    std::vector<std::string> frames = SplitFrames(capture);
+    if (frames.empty())
+    {
+        fprintf(stderr, "Capture contains no complete frames\n");
+        return 1;
+    }
+
+    if (soakIterations > 0)
+    {
+        return Soak(frames, soakIterations) ? 0 : 1;
+    }
+
+    printf("capture: %zu bytes, %zu frames, sizeof(SEController) = %zu bytes\n\n", capture.size(), frames.size(), sizeof(SEController));
+    size_t allocations = HeapAllocations;
+
+    PrintHeader();
+    BenchmarkCRC(frames, 1000000);
+    BenchmarkParser(frames, 200000);
+    BenchmarkProcessMessage(frames, 200000);
+    BenchmarkPoll(frames, 200000);
+    BenchmarkRingBuffer(capture, 200);
+    BenchmarkTopicRouting(200000);
+    BenchmarkEncoder(200000);
+
+    printf("\nheap: %zu allocations in total (including harness buffers)\n", HeapAllocations - allocations);
+    return 0;
+}
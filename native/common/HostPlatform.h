@@ -0,0 +1,112 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef HOSTPLATFORM_H
+#define HOSTPLATFORM_H
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include "SETransport.h"
+
+// Wall clock of the Linux host.
+class HostClock : public SEClock
+{
+private:
+    std::chrono::steady_clock::time_point Start = std::chrono::steady_clock::now();
+
+public:
+    unsigned long Millis() override
+    {
+        return (unsigned long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - Start).count();
+    }
+
+    unsigned long Micros() override
+    {
+        return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - Start).count();
+    }
+};
+
+// Virtual clock that only moves when told to; keeps replays deterministic.
+class ManualClock : public SEClock
+{
+public:
+    unsigned long Now = 0;
+
+    unsigned long Millis() override { return Now / 1000; }
+    unsigned long Micros() override { return Now; }
+    void AdvanceMillis(unsigned long millis) { Now += millis * 1000; }
+};
+
+// Replays a fixed byte buffer as RX data and counts what is written back.
+class MemoryTransport : public SETransport
+{
+private:
+    const uint8_t *Input = NULL;
+    size_t InputLength = 0;
+    size_t InputPosition = 0;
+
+public:
+    size_t BytesWritten = 0;
+
+    void SetInput(const uint8_t *input, size_t length)
+    {
+        Input = input;
+        InputLength = length;
+        InputPosition = 0;
+    }
+
+    size_t Remaining() const { return InputLength - InputPosition; }
+
+    int Available() override { return (int)Remaining(); }
+
+    int Read() override
+    {
+        return InputPosition < InputLength ? Input[InputPosition++] : -1;
+    }
+
+    size_t ReadBytes(uint8_t *buffer, size_t length) override
+    {
+        size_t count = length < Remaining() ? length : Remaining();
+        memcpy(buffer, Input + InputPosition, count);
+        InputPosition += count;
+        return count;
+    }
+
+    size_t Write(const uint8_t *buffer, size_t length) override
+    {
+        BytesWritten += length;
+        return length;
+    }
+};
+
+// A file on the host, standing in for LittleFS.
+class FileStorage : public SEStorage
+{
+private:
+    const char *Path;
+
+public:
+    explicit FileStorage(const char *path) : Path(path) {}
+
+    size_t Load(uint8_t *buffer, size_t size) override
+    {
+        FILE *file = fopen(Path, "rb");
+        if (file == NULL) return 0;
+        size_t length = fread(buffer, 1, size, file);
+        fclose(file);
+        return length;
+    }
+
+    bool Save(const uint8_t *buffer, size_t length) override
+    {
+        FILE *file = fopen(Path, "wb");
+        if (file == NULL) return false;
+        bool written = fwrite(buffer, 1, length, file) == length;
+        return fclose(file) == 0 && written;
+    }
+};
+
+#endif
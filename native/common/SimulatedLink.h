@@ -0,0 +1,105 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SIMULATEDLINK_H
+#define SIMULATEDLINK_H
+
+#include <deque>
+#include "SETransport.h"
+
+// In-process serial line between two endpoints. Bytes become readable on the
+// other side only after their wire time at the configured baud rate (8N1,
+// 10 bits per byte) has passed on the shared clock, so a virtual clock can
+// run hours of traffic at full line speed in seconds.
+class SimulatedLink
+{
+public:
+    class Endpoint : public SETransport
+    {
+    private:
+        struct TimedByte
+        {
+            unsigned long DeliverAt;
+            uint8_t Value;
+        };
+
+        SimulatedLink *Link = NULL;
+        Endpoint *Peer = NULL;
+        std::deque<TimedByte> Incoming;
+        unsigned long LineFreeAt = 0;
+
+        friend class SimulatedLink;
+
+    public:
+        size_t BytesWritten = 0;
+
+        int Available() override
+        {
+            unsigned long now = Link->Clock->Micros();
+            int count = 0;
+            for (const TimedByte &entry : Incoming)
+            {
+                if ((long)(now - entry.DeliverAt) < 0) break;
+                count++;
+            }
+            return count;
+        }
+
+        int Read() override
+        {
+            if (Incoming.empty() || (long)(Link->Clock->Micros() - Incoming.front().DeliverAt) < 0) return -1;
+            uint8_t value = Incoming.front().Value;
+            Incoming.pop_front();
+            return value;
+        }
+
+        size_t ReadBytes(uint8_t *buffer, size_t length) override
+        {
+            unsigned long now = Link->Clock->Micros();
+            size_t count = 0;
+            while (count < length && !Incoming.empty() && (long)(now - Incoming.front().DeliverAt) >= 0)
+            {
+                buffer[count++] = Incoming.front().Value;
+                Incoming.pop_front();
+            }
+            return count;
+        }
+
+        size_t Write(const uint8_t *buffer, size_t length) override
+        {
+            unsigned long now = Link->Clock->Micros();
+            if ((long)(LineFreeAt - now) < 0) LineFreeAt = now;
+            for (size_t i = 0; i < length; i++)
+            {
+                LineFreeAt += Link->MicrosPerByte;
+                Peer->Incoming.push_back(TimedByte{LineFreeAt, buffer[i]});
+            }
+            BytesWritten += length;
+            return length;
+        }
+
+        // Wire time of everything queued but not yet delivered, in microseconds.
+        unsigned long Backlog() const
+        {
+            unsigned long now = Link->Clock->Micros();
+            return (long)(LineFreeAt - now) > 0 ? LineFreeAt - now : 0;
+        }
+    };
+
+    SimulatedLink(SEClock *clock, unsigned long baud) : Clock(clock), MicrosPerByte(10000000UL / baud)
+    {
+        A.Link = this;
+        A.Peer = &B;
+        B.Link = this;
+        B.Peer = &A;
+    }
+
+    SEClock *Clock;
+    unsigned long MicrosPerByte;
+    Endpoint A;
+    Endpoint B;
+};
+
+#endif
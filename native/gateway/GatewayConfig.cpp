@@ -0,0 +1,165 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "GatewayConfig.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char *Trim(char *text)
+{
+    while (isspace((unsigned char)*text)) text++;
+    char *end = text + strlen(text);
+    while (end > text && isspace((unsigned char)end[-1])) *--end = '\0';
+    return text;
+}
+
+static bool CopyValue(char *target, size_t size, const char *value)
+{
+    if (strlen(value) >= size) return false;
+    strcpy(target, value);
+    return true;
+}
+
+static bool ParseNumber(const char *value, long min, long max, long &number)
+{
+    char *end;
+    number = strtol(value, &end, 10);
+    return *value != '\0' && *end == '\0' && number >= min && number <= max;
+}
+
+// Returns NULL on success, otherwise the reason.
+static const char *SetGlobal(GatewayConfig &config, const char *key, const char *value)
+{
+    long number;
+    if (strcmp(key, "mqtt_host") == 0)
+    {
+        return CopyValue(config.MqttHost, sizeof(config.MqttHost), value) ? NULL : "host name too long";
+    }
+    if (strcmp(key, "mqtt_port") == 0)
+    {
+        if (!ParseNumber(value, 1, 65535, number)) return "port must be 1-65535";
+        config.MqttPort = (int)number;
+        return NULL;
+    }
+    if (strcmp(key, "http_port") == 0)
+    {
+        if (!ParseNumber(value, 0, 65535, number)) return "port must be 0-65535";
+        config.HttpPort = (int)number;
+        return NULL;
+    }
+    if (strcmp(key, "state_dir") == 0)
+    {
+        return CopyValue(config.StateDir, sizeof(config.StateDir), value) ? NULL : "path too long";
+    }
+    if (strcmp(key, "language") == 0)
+    {
+        return SEParseAreaLanguage(value, config.Language) ? NULL : "language must be de or en";
+    }
+    if (strcmp(key, "baud") == 0)
+    {
+        if (!ParseNumber(value, 1200, 4000000, number)) return "baud rate out of range";
+        config.Baud = (unsigned long)number;
+        return NULL;
+    }
+    if (strcmp(key, "report_seconds") == 0)
+    {
+        if (!ParseNumber(value, 0, 86400, number)) return "report_seconds must be 0-86400";
+        config.ReportSeconds = (unsigned long)number;
+        return NULL;
+    }
+    return "unknown key";
+}
+
+static const char *SetUnit(GatewayUnitConfig &unit, const char *key, const char *value)
+{
+    if (strcmp(key, "serial") == 0)
+    {
+        return CopyValue(unit.Serial, sizeof(unit.Serial), value) ? NULL : "path too long";
+    }
+    if (strcmp(key, "client_id") == 0)
+    {
+        return CopyValue(unit.ClientId, sizeof(unit.ClientId), value) ? NULL : "client id too long";
+    }
+    return "unknown key";
+}
+
+bool LoadGatewayConfig(const char *path, GatewayConfig &config, char *error, size_t errorSize)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        snprintf(error, errorSize, "%s: %s", path, strerror(errno));
+        return false;
+    }
+
+    char line[256];
+    int number = 0;
+    const char *reason = NULL;
+    GatewayUnitConfig *unit = NULL;
+    while (reason == NULL && fgets(line, sizeof(line), file) != NULL)
+    {
+        number++;
+        char *comment = strchr(line, '#');
+        if (comment != NULL) *comment = '\0';
+        char *text = Trim(line);
+        if (*text == '\0') continue;
+
+        if (*text == '[')
+        {
+            // [unit <name>]
+            char *end = strchr(text, ']');
+            if (end == NULL || strncmp(text, "[unit ", 6) != 0)
+            {
+                reason = "expected [unit <name>]";
+                break;
+            }
+            *end = '\0';
+            const char *name = Trim(text + 6);
+            if (config.UnitCount >= SEUNITSCHEDULER_MAX_UNITS) reason = "too many units";
+            else if (*name == '\0') reason = "unit name missing";
+            else
+            {
+                unit = &config.Units[config.UnitCount++];
+                if (!CopyValue(unit->Name, sizeof(unit->Name), name)) reason = "unit name too long";
+            }
+            continue;
+        }
+
+        char *equals = strchr(text, '=');
+        if (equals == NULL)
+        {
+            reason = "expected <key> = <value>";
+            break;
+        }
+        *equals = '\0';
+        const char *key = Trim(text);
+        const char *value = Trim(equals + 1);
+        reason = unit != NULL ? SetUnit(*unit, key, value) : SetGlobal(config, key, value);
+    }
+    fclose(file);
+
+    if (reason != NULL)
+    {
+        snprintf(error, errorSize, "%s:%d: %s", path, number, reason);
+        return false;
+    }
+    if (config.UnitCount == 0)
+    {
+        snprintf(error, errorSize, "%s: no [unit <name>] section", path);
+        return false;
+    }
+    for (size_t i = 0; i < config.UnitCount; i++)
+    {
+        if (config.Units[i].Serial[0] == '\0')
+        {
+            snprintf(error, errorSize, "%s: unit %s has no serial device", path, config.Units[i].Name);
+            return false;
+        }
+    }
+    return true;
+}
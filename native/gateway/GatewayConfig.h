@@ -0,0 +1,52 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef GATEWAYCONFIG_H
+#define GATEWAYCONFIG_H
+
+#include <stddef.h>
+#include "SEAreaNames.h"
+#include "SETopicRouter.h"
+#include "SEUnitScheduler.h"
+
+#define GATEWAY_PATH_LENGTH 128
+#define GATEWAY_HOST_LENGTH 64
+#define GATEWAY_CLIENT_ID_LENGTH 32
+#define GATEWAY_ERROR_LENGTH 160
+
+struct GatewayUnitConfig
+{
+    char Name[SETOPICROUTER_PREFIX_LENGTH]; // topic prefix and unit label
+    char Serial[GATEWAY_PATH_LENGTH];
+    char ClientId[GATEWAY_CLIENT_ID_LENGTH]; // empty: <host name>-<unit name>
+};
+
+struct GatewayConfig
+{
+    char MqttHost[GATEWAY_HOST_LENGTH] = "localhost";
+    int MqttPort = 1883;
+    int HttpPort = 8080; // 0: no web interface
+    char StateDir[GATEWAY_PATH_LENGTH] = ""; // empty: the register cache is not kept
+    SEAreaLanguage Language = SEAREA_LANGUAGE_DE;
+    unsigned long Baud = 28800;
+    unsigned long ReportSeconds = 0; // 0: no periodic report
+    GatewayUnitConfig Units[SEUNITSCHEDULER_MAX_UNITS] = {};
+    size_t UnitCount = 0;
+};
+
+// Reads a configuration like this:
+//
+//   mqtt_host = localhost
+//   http_port = 8080
+//   state_dir = /var/lib/seventilation
+//
+//   [unit airsystem]
+//   serial = /dev/ttyUSB0
+//
+// Global keys come first, then one section per SEC-Touch. On failure error
+// holds the file name, line and reason.
+bool LoadGatewayConfig(const char *path, GatewayConfig &config, char *error, size_t errorSize);
+
+#endif
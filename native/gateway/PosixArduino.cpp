@@ -0,0 +1,298 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include <Arduino.h>
+#include <ESP8266WiFi.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <malloc.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/sockios.h>
+#include "ArduinoPlatform.h"
+
+EspClass ESP;
+WiFiClass WiFi;
+
+static char **RestartArguments = NULL;
+static int Sockets[POSIX_SOCKETS_MAX];
+static size_t SocketCount = 0;
+
+static uint64_t MonotonicMicros()
+{
+    static struct timespec start = {0, 0};
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (start.tv_sec == 0 && start.tv_nsec == 0) start = now;
+    return (uint64_t)(now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000;
+}
+
+unsigned long millis()
+{
+    return (unsigned long)(MonotonicMicros() / 1000);
+}
+
+unsigned long micros()
+{
+    return (unsigned long)MonotonicMicros();
+}
+
+void delay(unsigned long ms)
+{
+    usleep(ms * 1000);
+}
+
+unsigned long ArduinoClock::Millis()
+{
+    return millis();
+}
+
+unsigned long ArduinoClock::Micros()
+{
+    return micros();
+}
+
+uint32_t EspClass::getChipId()
+{
+    return (uint32_t)gethostid() ^ (uint32_t)getpid();
+}
+
+uint32_t EspClass::getFreeHeap()
+{
+    struct mallinfo2 info = mallinfo2();
+    return (uint32_t)info.fordblks;
+}
+
+uint32_t EspClass::getMaxFreeBlockSize()
+{
+    return getFreeHeap();
+}
+
+void PosixSetRestartArguments(char **argv)
+{
+    RestartArguments = argv;
+}
+
+void EspClass::restart()
+{
+    // Sockets are not inherited by the new image; its listen socket binds again right away.
+    for (int fd = 3; fd < 1024; fd++) fcntl(fd, F_SETFD, FD_CLOEXEC);
+    if (RestartArguments != NULL) execv("/proc/self/exe", RestartArguments);
+    _exit(EXIT_FAILURE);
+}
+
+void PosixRegisterSocket(int fd)
+{
+    if (SocketCount < POSIX_SOCKETS_MAX) Sockets[SocketCount++] = fd;
+}
+
+void PosixUnregisterSocket(int fd)
+{
+    for (size_t i = 0; i < SocketCount; i++)
+    {
+        if (Sockets[i] == fd)
+        {
+            Sockets[i] = Sockets[--SocketCount];
+            return;
+        }
+    }
+}
+
+size_t PosixCollectSockets(struct pollfd *fds, size_t size)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < SocketCount && count < size; i++, count++)
+    {
+        fds[count].fd = Sockets[i];
+        fds[count].events = POLLIN;
+        fds[count].revents = 0;
+    }
+    return count;
+}
+
+int WiFiClass::hostByName(const char *host, IPAddress &address, uint32_t timeoutMillis)
+{
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *result = NULL;
+    if (getaddrinfo(host, NULL, &hints, &result) != 0 || result == NULL) return 0;
+    memcpy(address.Bytes, &((struct sockaddr_in *)result->ai_addr)->sin_addr, 4);
+    freeaddrinfo(result);
+    return 1;
+}
+
+WiFiClient::Socket::Socket(int fd) : Fd(fd)
+{
+    PosixRegisterSocket(fd);
+}
+
+WiFiClient::Socket::~Socket()
+{
+    PosixUnregisterSocket(Fd);
+    close(Fd);
+}
+
+WiFiClient::WiFiClient(int fd)
+{
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    Connection = std::make_shared<Socket>(fd);
+}
+
+int WiFiClient::connect(const IPAddress &address, uint16_t port)
+{
+    stop();
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return 0;
+
+    struct sockaddr_in peer;
+    memset(&peer, 0, sizeof(peer));
+    peer.sin_family = AF_INET;
+    peer.sin_port = htons(port);
+    memcpy(&peer.sin_addr, address.Bytes, 4);
+    if (::connect(fd, (struct sockaddr *)&peer, sizeof(peer)) != 0)
+    {
+        struct pollfd pending = {fd, POLLOUT, 0};
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (errno != EINPROGRESS || poll(&pending, 1, TimeoutMillis) != 1 ||
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) != 0 || error != 0)
+        {
+            close(fd);
+            return 0;
+        }
+    }
+    Connection = std::make_shared<Socket>(fd);
+    return 1;
+}
+
+int WiFiClient::connect(const char *host, uint16_t port)
+{
+    IPAddress address;
+    return WiFi.hostByName(host, address, TimeoutMillis) ? connect(address, port) : 0;
+}
+
+void WiFiClient::stop()
+{
+    if (Connection) shutdown(Connection->Fd, SHUT_RDWR);
+    Connection.reset();
+}
+
+uint8_t WiFiClient::connected()
+{
+    if (Fd() < 0) return 0;
+    uint8_t peek;
+    ssize_t count = recv(Fd(), &peek, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (count > 0) return 1;
+    return count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) ? 1 : 0;
+}
+
+void WiFiClient::setNoDelay(bool noDelay)
+{
+    int value = noDelay ? 1 : 0;
+    if (Fd() >= 0) setsockopt(Fd(), IPPROTO_TCP, TCP_NODELAY, &value, sizeof(value));
+}
+
+int WiFiClient::available()
+{
+    int count = 0;
+    if (Fd() < 0 || ioctl(Fd(), FIONREAD, &count) != 0) return 0;
+    return count;
+}
+
+int WiFiClient::read()
+{
+    uint8_t value;
+    return read(&value, 1) == 1 ? value : -1;
+}
+
+int WiFiClient::read(uint8_t *buffer, size_t size)
+{
+    if (Fd() < 0) return -1;
+    ssize_t count = recv(Fd(), buffer, size, MSG_DONTWAIT);
+    return count > 0 ? (int)count : -1;
+}
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t length)
+{
+    size_t written = 0;
+    unsigned long start = millis();
+    while (Fd() >= 0 && written < length)
+    {
+        ssize_t count = send(Fd(), buffer + written, length - written, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (count > 0)
+        {
+            written += count;
+            continue;
+        }
+        if (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK) break;
+        unsigned long waited = millis() - start;
+        if (waited >= TimeoutMillis) break;
+        struct pollfd pending = {Fd(), POLLOUT, 0};
+        poll(&pending, 1, TimeoutMillis - waited);
+    }
+    return written;
+}
+
+int WiFiClient::availableForWrite()
+{
+    int size = 0;
+    int queued = 0;
+    socklen_t length = sizeof(size);
+    if (Fd() < 0 || getsockopt(Fd(), SOL_SOCKET, SO_SNDBUF, &size, &length) != 0 || ioctl(Fd(), SIOCOUTQ, &queued) != 0) return 0;
+    // The kernel reports twice the configured size, half of it for its own bookkeeping.
+    size /= 2;
+    return size > queued ? size - queued : 0;
+}
+
+WiFiServer::~WiFiServer()
+{
+    if (Fd < 0) return;
+    PosixUnregisterSocket(Fd);
+    close(Fd);
+}
+
+void WiFiServer::begin()
+{
+    Fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (Fd < 0) return;
+    int reuse = 1;
+    setsockopt(Fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(Port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(Fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(Fd, 16) != 0)
+    {
+        fprintf(stderr, "TCP port %u: %s\n", Port, strerror(errno));
+        close(Fd);
+        Fd = -1;
+        return;
+    }
+    PosixRegisterSocket(Fd);
+}
+
+bool WiFiServer::hasClient()
+{
+    struct pollfd pending = {Fd, POLLIN, 0};
+    return Fd >= 0 && poll(&pending, 1, 0) == 1 && (pending.revents & POLLIN);
+}
+
+WiFiClient WiFiServer::accept()
+{
+    int fd = Fd >= 0 ? accept4(Fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC) : -1;
+    if (fd < 0) return WiFiClient();
+    WiFiClient client(fd);
+    client.setNoDelay(NoDelay);
+    return client;
+}
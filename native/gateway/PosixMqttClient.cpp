@@ -0,0 +1,367 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include <MQTT.h>
+
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_SUBSCRIBE 0x82
+#define MQTT_SUBACK 0x90
+#define MQTT_SUBACK_FAILURE 0x80
+#define MQTT_PINGREQ 0xC0
+#define MQTT_DISCONNECT 0xE0
+
+// Fixed header: type byte and up to four bytes of remaining length.
+#define MQTT_HEADER_MAX 5
+
+// Results of ParsePublish() besides a payload length.
+#define MQTT_PUBLISH_SKIPPED -1
+#define MQTT_PUBLISH_MALFORMED -2
+
+MQTTClient::MQTTClient(int bufferSize) : BufferSize(bufferSize)
+{
+    ReadBuffer = new uint8_t[bufferSize];
+    WriteBuffer = new uint8_t[bufferSize];
+}
+
+MQTTClient::~MQTTClient()
+{
+    delete[] ReadBuffer;
+    delete[] WriteBuffer;
+}
+
+void MQTTClient::begin(const char hostname[], int port, WiFiClient &client)
+{
+    Net = &client;
+    setHost(hostname, port);
+}
+
+void MQTTClient::setHost(IPAddress address, int port)
+{
+    Address = address;
+    HasAddress = true;
+    Port = port;
+}
+
+void MQTTClient::setHost(const char hostname[], int port)
+{
+    strncpy(Host, hostname, sizeof(Host) - 1);
+    HasAddress = false;
+    Port = port;
+}
+
+void MQTTClient::setWill(const char topic[], const char payload[], bool retained, int qos)
+{
+    strncpy(WillTopic, topic, sizeof(WillTopic) - 1);
+    strncpy(WillPayload, payload, sizeof(WillPayload) - 1);
+    WillRetained = retained;
+    WillQos = qos;
+}
+
+size_t MQTTClient::PutString(uint8_t *buffer, const char *text, size_t length)
+{
+    buffer[0] = length >> 8;
+    buffer[1] = length & 0xFF;
+    memcpy(buffer + 2, text, length);
+    return length + 2;
+}
+
+// Writes the fixed header and returns its length.
+size_t MQTTClient::BeginPacket(uint8_t type, size_t remaining)
+{
+    size_t length = 0;
+    WriteBuffer[length++] = type;
+    do
+    {
+        uint8_t digit = remaining % 128;
+        remaining /= 128;
+        WriteBuffer[length++] = remaining > 0 ? digit | 0x80 : digit;
+    } while (remaining > 0);
+    return length;
+}
+
+bool MQTTClient::Send(size_t length)
+{
+    if (Net == NULL || Net->write(WriteBuffer, length) != length)
+    {
+        Close();
+        return false;
+    }
+    LastSendMillis = millis();
+    return true;
+}
+
+void MQTTClient::Close()
+{
+    if (Net != NULL) Net->stop();
+    Connected = false;
+    ReadLength = 0;
+}
+
+bool MQTTClient::connect(const char clientId[], bool skip)
+{
+    if (Net == NULL) return false;
+    // skip: the caller has opened the socket, as in the library.
+    if (!skip)
+    {
+        Close();
+        Net->setTimeout(TimeoutMillis);
+        bool opened = HasAddress ? Net->connect(Address, Port) : Net->connect(Host, Port);
+        if (!opened) return false;
+    }
+    else if (!Net->connected())
+    {
+        return false;
+    }
+    ReadLength = 0;
+
+    size_t idLength = strlen(clientId);
+    size_t willTopicLength = strlen(WillTopic);
+    size_t willPayloadLength = strlen(WillPayload);
+    size_t remaining = 10 + 2 + idLength + (willTopicLength > 0 ? 4 + willTopicLength + willPayloadLength : 0);
+    if (remaining + MQTT_HEADER_MAX > BufferSize)
+    {
+        Close();
+        return false;
+    }
+
+    uint8_t flags = CleanSession ? 0x02 : 0;
+    if (willTopicLength > 0) flags |= 0x04 | (WillQos << 3) | (WillRetained ? 0x20 : 0);
+    size_t length = BeginPacket(MQTT_CONNECT, remaining);
+    length += PutString(WriteBuffer + length, "MQTT", 4);
+    WriteBuffer[length++] = 4; // protocol level 3.1.1
+    WriteBuffer[length++] = flags;
+    WriteBuffer[length++] = KeepAliveSeconds >> 8;
+    WriteBuffer[length++] = KeepAliveSeconds & 0xFF;
+    length += PutString(WriteBuffer + length, clientId, idLength);
+    if (willTopicLength > 0)
+    {
+        length += PutString(WriteBuffer + length, WillTopic, willTopicLength);
+        length += PutString(WriteBuffer + length, WillPayload, willPayloadLength);
+    }
+    if (!Send(length)) return false;
+
+    // CONNACK: 0x20 0x02 <session present> <return code>
+    uint8_t ack[4];
+    size_t received = 0;
+    unsigned long start = millis();
+    while (received < sizeof(ack) && millis() - start < TimeoutMillis)
+    {
+        int count = Net->read(ack + received, sizeof(ack) - received);
+        if (count > 0) received += count;
+        else if (!Net->connected()) break;
+        else delay(1);
+    }
+    if (received < sizeof(ack) || ack[0] != MQTT_CONNACK || ack[3] != 0)
+    {
+        Close();
+        return false;
+    }
+    Connected = true;
+    LastReceiveMillis = millis();
+    return true;
+}
+
+bool MQTTClient::publish(const char topic[], const char payload[], int length, bool retained, int qos)
+{
+    if (!Connected) return false;
+    size_t topicLength = strlen(topic);
+    size_t remaining = 2 + topicLength + (qos > 0 ? 2 : 0) + length;
+    if (remaining + MQTT_HEADER_MAX > BufferSize) return false;
+
+    size_t position = BeginPacket(MQTT_PUBLISH | (qos > 0 ? 0x02 : 0) | (retained ? 0x01 : 0), remaining);
+    position += PutString(WriteBuffer + position, topic, topicLength);
+    uint16_t packetId = 0;
+    if (qos > 0)
+    {
+        packetId = NextPacketId++;
+        if (NextPacketId == 0) NextPacketId = 1;
+        WriteBuffer[position++] = packetId >> 8;
+        WriteBuffer[position++] = packetId & 0xFF;
+    }
+    memcpy(WriteBuffer + position, payload, length);
+    if (!Send(position + length)) return false;
+    return qos == 0 || WaitForAck(MQTT_PUBACK, packetId);
+}
+
+bool MQTTClient::subscribe(const char topic[], int qos)
+{
+    if (!Connected) return false;
+    size_t topicLength = strlen(topic);
+    size_t remaining = 2 + 2 + topicLength + 1;
+    if (remaining + MQTT_HEADER_MAX > BufferSize) return false;
+
+    uint16_t packetId = NextPacketId++;
+    if (NextPacketId == 0) NextPacketId = 1;
+    size_t position = BeginPacket(MQTT_SUBSCRIBE, remaining);
+    WriteBuffer[position++] = packetId >> 8;
+    WriteBuffer[position++] = packetId & 0xFF;
+    position += PutString(WriteBuffer + position, topic, topicLength);
+    WriteBuffer[position++] = qos;
+    if (!Send(position)) return false;
+    return WaitForAck(MQTT_SUBACK, packetId);
+}
+
+// Waits like the library: packets arriving meanwhile are handled as in loop(),
+// and without the acknowledgement in time the connection is closed. Nothing is
+// sent again.
+bool MQTTClient::WaitForAck(uint8_t type, uint16_t packetId)
+{
+    bool acknowledged = false;
+    unsigned long start = millis();
+    while (millis() - start < TimeoutMillis)
+    {
+        if (!Receive() || !ProcessPackets(type, packetId, acknowledged)) break;
+        if (acknowledged) return true;
+        delay(1);
+    }
+    Close();
+    return false;
+}
+
+bool MQTTClient::Receive()
+{
+    if (!connected()) return false;
+    int count = Net->read(ReadBuffer + ReadLength, BufferSize - ReadLength);
+    if (count > 0)
+    {
+        ReadLength += count;
+        LastReceiveMillis = millis();
+    }
+    return true;
+}
+
+// Handles every complete packet in the buffer; a partial one waits for the
+// next call. PUBLISH is acknowledged and handed to the callback, the awaited
+// acknowledgement (ackType and packetId) sets acknowledged, anything else is
+// dropped. Each packet leaves the buffer before the callback runs, which may
+// publish and wait in turn.
+bool MQTTClient::ProcessPackets(uint8_t ackType, uint16_t packetId, bool &acknowledged)
+{
+    while (ReadLength >= 2)
+    {
+        size_t remaining = 0;
+        size_t multiplier = 1;
+        size_t header = 1;
+        bool complete = false;
+        while (header < ReadLength && header <= 4)
+        {
+            uint8_t digit = ReadBuffer[header++];
+            remaining += (digit & 0x7F) * multiplier;
+            multiplier *= 128;
+            if ((digit & 0x80) == 0)
+            {
+                complete = true;
+                break;
+            }
+        }
+        if (!complete) break;
+        // Larger than the buffer: the library fails the connection as well.
+        if (header + remaining > BufferSize) return false;
+        if (header + remaining > ReadLength) break;
+
+        uint8_t type = ReadBuffer[0];
+        const uint8_t *body = ReadBuffer + header;
+        if (ackType != 0 && (type & 0xF0) == ackType && remaining >= 2 && ((body[0] << 8) | body[1]) == packetId)
+        {
+            // A refused subscription is an error in the library.
+            if (ackType == MQTT_SUBACK && (remaining < 3 || body[2] == MQTT_SUBACK_FAILURE)) return false;
+            acknowledged = true;
+        }
+
+        // Topic and payload are handed over NUL-terminated in a copy, as the library does.
+        char topic[256];
+        char payload[512];
+        int payloadLength = -1;
+        if ((type & 0xF0) == MQTT_PUBLISH)
+        {
+            payloadLength = ParsePublish(type, body, remaining, topic, sizeof(topic), payload, sizeof(payload));
+            if (payloadLength == MQTT_PUBLISH_MALFORMED) return false;
+        }
+        memmove(ReadBuffer, ReadBuffer + header + remaining, ReadLength - header - remaining);
+        ReadLength -= header + remaining;
+
+        // The callback publishes as well; a failed send closes the connection under us.
+        if (payloadLength >= 0 && Callback) Callback(this, topic, payload, payloadLength);
+        if (!Connected) return false;
+    }
+    return true;
+}
+
+// Copies topic and payload and sends the PUBACK of a QoS 1 message. Returns
+// the payload length, MQTT_PUBLISH_SKIPPED for a message too large for the
+// copies, or MQTT_PUBLISH_MALFORMED.
+int MQTTClient::ParsePublish(uint8_t type, const uint8_t *body, size_t length, char *topic, size_t topicSize,
+                             char *payload, size_t payloadSize)
+{
+    int qos = (type >> 1) & 0x03;
+    if (length < 2) return MQTT_PUBLISH_MALFORMED;
+    size_t topicLength = (body[0] << 8) | body[1];
+    size_t position = 2 + topicLength;
+    if (position + (qos > 0 ? 2 : 0) > length) return MQTT_PUBLISH_MALFORMED;
+
+    uint16_t packetId = 0;
+    if (qos > 0)
+    {
+        packetId = (body[position] << 8) | body[position + 1];
+        position += 2;
+    }
+    if (qos == 1)
+    {
+        size_t header = BeginPacket(MQTT_PUBACK, 2);
+        WriteBuffer[header] = packetId >> 8;
+        WriteBuffer[header + 1] = packetId & 0xFF;
+        if (!Send(header + 2)) return MQTT_PUBLISH_MALFORMED;
+    }
+
+    size_t payloadLength = length - position;
+    if (topicLength >= topicSize || payloadLength >= payloadSize) return MQTT_PUBLISH_SKIPPED;
+    memcpy(topic, body + 2, topicLength);
+    topic[topicLength] = '\0';
+    memcpy(payload, body + position, payloadLength);
+    payload[payloadLength] = '\0';
+    return (int)payloadLength;
+}
+
+bool MQTTClient::loop()
+{
+    bool unused = false;
+    if (!Receive()) return false;
+    if (!ProcessPackets(0, 0, unused))
+    {
+        Close();
+        return false;
+    }
+
+    unsigned long now = millis();
+    if (now - LastReceiveMillis > KeepAliveSeconds * 1500)
+    {
+        Close();
+        return false;
+    }
+    if (now - LastSendMillis >= KeepAliveSeconds * 1000)
+    {
+        size_t length = BeginPacket(MQTT_PINGREQ, 0);
+        if (!Send(length)) return false;
+    }
+    return true;
+}
+
+bool MQTTClient::connected()
+{
+    if (Connected && (Net == NULL || !Net->connected())) Close();
+    return Connected;
+}
+
+bool MQTTClient::disconnect()
+{
+    if (!Connected) return false;
+    size_t length = BeginPacket(MQTT_DISCONNECT, 0);
+    Send(length);
+    Close();
+    return true;
+}
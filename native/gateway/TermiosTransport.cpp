@@ -0,0 +1,110 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "TermiosTransport.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+// termios2 comes from the kernel headers, which clash with <termios.h>.
+#include <asm/termbits.h>
+#include <linux/serial.h>
+
+TermiosTransport::~TermiosTransport()
+{
+    if (Fd >= 0) close(Fd);
+}
+
+bool TermiosTransport::Open(const char *path, unsigned long baud)
+{
+    Fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (Fd < 0) return false;
+
+    struct termios2 settings;
+    if (ioctl(Fd, TCGETS2, &settings) != 0)
+    {
+        int error = errno;
+        close(Fd);
+        Fd = -1;
+        errno = error;
+        return false;
+    }
+    // Raw 8N1 at any baud rate; reads return what is there (VMIN = VTIME = 0).
+    settings.c_iflag = 0;
+    settings.c_oflag = 0;
+    settings.c_lflag = 0;
+    settings.c_cflag = CS8 | CREAD | CLOCAL | BOTHER;
+    settings.c_ispeed = baud;
+    settings.c_ospeed = baud;
+    memset(settings.c_cc, 0, sizeof(settings.c_cc));
+    if (ioctl(Fd, TCSETS2, &settings) != 0)
+    {
+        int error = errno;
+        close(Fd);
+        Fd = -1;
+        errno = error;
+        return false;
+    }
+
+    // FTDI adapters otherwise hold received bytes for up to 16 ms, which is
+    // most of the ACK turnaround. Not supported by every driver or by a pty.
+    struct serial_struct serial;
+    if (ioctl(Fd, TIOCGSERIAL, &serial) == 0)
+    {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        ioctl(Fd, TIOCSSERIAL, &serial);
+    }
+    ioctl(Fd, TCFLSH, TCIOFLUSH);
+    return true;
+}
+
+void TermiosTransport::Fill()
+{
+    if (BufferStart < BufferEnd || Fd < 0) return;
+    ssize_t count = read(Fd, Buffer, sizeof(Buffer));
+    BufferStart = 0;
+    BufferEnd = count > 0 ? (size_t)count : 0;
+}
+
+int TermiosTransport::Available()
+{
+    Fill();
+    return (int)(BufferEnd - BufferStart);
+}
+
+int TermiosTransport::Read()
+{
+    Fill();
+    return BufferStart < BufferEnd ? Buffer[BufferStart++] : -1;
+}
+
+size_t TermiosTransport::ReadBytes(uint8_t *buffer, size_t length)
+{
+    Fill();
+    size_t count = BufferEnd - BufferStart < length ? BufferEnd - BufferStart : length;
+    memcpy(buffer, Buffer + BufferStart, count);
+    BufferStart += count;
+    return count;
+}
+
+size_t TermiosTransport::Write(const uint8_t *buffer, size_t length)
+{
+    size_t written = 0;
+    while (Fd >= 0 && written < length)
+    {
+        ssize_t count = write(Fd, buffer + written, length - written);
+        if (count > 0)
+        {
+            written += count;
+            continue;
+        }
+        if (count < 0 && errno != EAGAIN) break;
+        struct pollfd pending = {Fd, POLLOUT, 0};
+        if (poll(&pending, 1, TERMIOS_WRITE_TIMEOUT_MILLIS) != 1) break;
+    }
+    return written;
+}
@@ -0,0 +1,44 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef TERMIOSTRANSPORT_H
+#define TERMIOSTRANSPORT_H
+
+#include "SETransport.h"
+
+#define TERMIOS_RX_BUFFER_SIZE 512
+// A write that the driver does not take within this time is cut short.
+#define TERMIOS_WRITE_TIMEOUT_MILLIS 50
+
+// A serial device on Linux, e.g. a USB-serial adapter or the slave side of
+// a pseudo-terminal, in raw 8N1 mode. The baud rate is set with termios2,
+// so 28800 works on adapters that support arbitrary rates. Reads never
+// block; one read() call fetches everything the driver holds.
+class TermiosTransport : public SETransport
+{
+private:
+    int Fd = -1;
+    uint8_t Buffer[TERMIOS_RX_BUFFER_SIZE];
+    size_t BufferStart = 0;
+    size_t BufferEnd = 0;
+
+    void Fill();
+
+public:
+    TermiosTransport() {}
+    ~TermiosTransport();
+
+    // Returns false with errno set if the device cannot be opened or configured.
+    bool Open(const char *path, unsigned long baud);
+    // For the event loop: readable when the controller sent something.
+    int GetFd() const { return Fd; }
+
+    int Available() override;
+    int Read() override;
+    size_t ReadBytes(uint8_t *buffer, size_t length) override;
+    size_t Write(const uint8_t *buffer, size_t length) override;
+};
+
+#endif
@@ -0,0 +1,63 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+// The part of the Arduino core the bridge frontends use, implemented on
+// POSIX for the Linux gateway (native/gateway). Only what the firmware
+// sources call is provided.
+
+#ifndef GATEWAY_ARDUINO_H
+#define GATEWAY_ARDUINO_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include "pgmspace.h"
+
+using std::max;
+using std::min;
+
+#define F(text) (text)
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+
+class String
+{
+private:
+    std::string Text;
+
+public:
+    String(const char *text = "") : Text(text != NULL ? text : "") {}
+    String(const std::string &text) : Text(text) {}
+
+    const char *c_str() const { return Text.c_str(); }
+    size_t length() const { return Text.size(); }
+    long toInt() const { return atol(Text.c_str()); }
+    bool operator==(const char *other) const { return Text == other; }
+    bool operator!=(const char *other) const { return Text != other; }
+};
+
+class EspClass
+{
+public:
+    uint32_t getChipId();
+    // Free bytes in the malloc arena; the process can grow beyond them.
+    uint32_t getFreeHeap();
+    uint32_t getMaxFreeBlockSize();
+    // Replaces the process with a fresh instance started with the same arguments.
+    void restart();
+};
+
+extern EspClass ESP;
+
+// Arguments ESP.restart() starts the process with; set from main().
+void PosixSetRestartArguments(char **argv);
+
+#endif
@@ -0,0 +1,129 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef GATEWAY_ESP8266WIFI_H
+#define GATEWAY_ESP8266WIFI_H
+
+#include <memory>
+#include <poll.h>
+#include "Arduino.h"
+
+// Sockets that are open anywhere in the process: the gateway's event loop
+// waits on them next to the serial ports.
+#define POSIX_SOCKETS_MAX 32
+
+// Fills fds with every open socket, waiting for input; returns the count.
+size_t PosixCollectSockets(struct pollfd *fds, size_t size);
+void PosixRegisterSocket(int fd);
+void PosixUnregisterSocket(int fd);
+
+struct IPAddress
+{
+    uint8_t Bytes[4] = {};
+};
+
+// A TCP connection. Copies share the connection, which is closed when
+// stop() is called or the last copy goes, like on the ESP8266.
+class WiFiClient
+{
+private:
+    struct Socket
+    {
+        int Fd;
+        explicit Socket(int fd);
+        ~Socket();
+    };
+
+    std::shared_ptr<Socket> Connection;
+    unsigned long TimeoutMillis = 1000;
+
+    int Fd() const { return Connection ? Connection->Fd : -1; }
+
+public:
+    WiFiClient() {}
+    // Takes over an accepted socket.
+    explicit WiFiClient(int fd);
+
+    // Blocks for at most the timeout. Returns 1 on success like the Arduino API.
+    int connect(const IPAddress &address, uint16_t port);
+    int connect(const char *host, uint16_t port);
+    void stop();
+    // Nothing to wait for: the kernel sends what is left after close().
+    bool stop(unsigned int maxWaitMillis)
+    {
+        stop();
+        return true;
+    }
+    uint8_t connected();
+    explicit operator bool() const { return Fd() >= 0; }
+
+    void setTimeout(unsigned long timeoutMillis) { TimeoutMillis = timeoutMillis; }
+    void setNoDelay(bool noDelay);
+
+    int available();
+    int read();
+    int read(uint8_t *buffer, size_t size);
+    // Waits up to the timeout while the send buffer is full.
+    size_t write(const uint8_t *buffer, size_t length);
+    size_t write(const char *buffer, size_t length) { return write((const uint8_t *)buffer, length); }
+    size_t print(const char *text) { return write(text, strlen(text)); }
+    // Bytes the socket takes without blocking.
+    int availableForWrite();
+};
+
+// A listening TCP socket on all interfaces; accept() never waits.
+class WiFiServer
+{
+private:
+    uint16_t Port;
+    int Fd = -1;
+    bool NoDelay = false;
+
+public:
+    explicit WiFiServer(uint16_t port) : Port(port) {}
+    ~WiFiServer();
+
+    void begin();
+    void setNoDelay(bool noDelay) { NoDelay = noDelay; }
+    bool hasClient();
+    // An invalid client if no connection is pending.
+    WiFiClient accept();
+};
+
+enum wl_status_t
+{
+    WL_IDLE_STATUS,
+    WL_NO_SSID_AVAIL,
+    WL_CONNECTED,
+    WL_CONNECT_FAILED,
+    WL_CONNECTION_LOST,
+    WL_WRONG_PASSWORD,
+    WL_DISCONNECTED
+};
+
+enum WiFiMode_t
+{
+    WIFI_OFF,
+    WIFI_STA
+};
+
+// The host's network is managed by the operating system and always counts
+// as connected; only the name resolution is real.
+class WiFiClass
+{
+public:
+    void mode(WiFiMode_t mode) {}
+    void setAutoReconnect(bool autoReconnect) {}
+    void hostname(const char *name) {}
+    void begin(const char *ssid, const char *password) {}
+    void reconnect() {}
+    wl_status_t status() { return WL_CONNECTED; }
+    // IPv4 only, like the ESP8266. Blocks for the resolver, independent of the timeout.
+    int hostByName(const char *host, IPAddress &address, uint32_t timeoutMillis);
+};
+
+extern WiFiClass WiFi;
+
+#endif
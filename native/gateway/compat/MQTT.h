@@ -0,0 +1,81 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef GATEWAY_MQTT_H
+#define GATEWAY_MQTT_H
+
+#include <functional>
+#include "ESP8266WiFi.h"
+
+class MQTTClient;
+
+typedef std::function<void(MQTTClient *client, char topic[], char bytes[], int length)> MQTTClientCallbackAdvanced;
+
+// MQTT 3.1.1 client with the interface of the 256dpi MQTT library the
+// firmware uses, and its blocking behaviour: connect() waits for CONNACK,
+// subscribe() for SUBACK and a QoS 1 publish() for PUBACK, each for the
+// timeout at most, and a missing acknowledgement closes the connection.
+// Like the library, it never sends a message again.
+class MQTTClient
+{
+private:
+    WiFiClient *Net = NULL;
+    IPAddress Address;
+    char Host[64] = {};
+    bool HasAddress = false;
+    int Port = 1883;
+    uint8_t *ReadBuffer;
+    uint8_t *WriteBuffer;
+    size_t BufferSize;
+    size_t ReadLength = 0;
+    MQTTClientCallbackAdvanced Callback;
+    char WillTopic[128] = {};
+    char WillPayload[32] = {};
+    bool WillRetained = false;
+    int WillQos = 0;
+    bool CleanSession = true;
+    unsigned long TimeoutMillis = 1000;
+    unsigned long KeepAliveSeconds = 10;
+    bool Connected = false;
+    uint16_t NextPacketId = 1;
+    unsigned long LastSendMillis = 0;
+    unsigned long LastReceiveMillis = 0;
+
+    bool Send(size_t length);
+    size_t BeginPacket(uint8_t type, size_t remaining);
+    static size_t PutString(uint8_t *buffer, const char *text, size_t length);
+    bool Receive();
+    bool ProcessPackets(uint8_t ackType, uint16_t packetId, bool &acknowledged);
+    int ParsePublish(uint8_t type, const uint8_t *body, size_t length, char *topic, size_t topicSize, char *payload,
+                     size_t payloadSize);
+    bool WaitForAck(uint8_t type, uint16_t packetId);
+    void Close();
+
+public:
+    explicit MQTTClient(int bufferSize = 128);
+    ~MQTTClient();
+
+    void begin(const char hostname[], int port, WiFiClient &client);
+    void setHost(IPAddress address, int port);
+    void setHost(const char hostname[], int port);
+    void onMessageAdvanced(MQTTClientCallbackAdvanced callback) { Callback = callback; }
+    void setWill(const char topic[], const char payload[], bool retained, int qos);
+    void setCleanSession(bool cleanSession) { CleanSession = cleanSession; }
+    void setTimeout(int timeoutMillis) { TimeoutMillis = timeoutMillis; }
+    void setKeepAlive(int keepAliveSeconds) { KeepAliveSeconds = keepAliveSeconds; }
+
+    bool connect(const char clientId[], bool skip = false);
+    bool publish(const char topic[], const char payload[]) { return publish(topic, payload, (int)strlen(payload), false, 0); }
+    bool publish(const char topic[], const char payload[], bool retained, int qos) { return publish(topic, payload, (int)strlen(payload), retained, qos); }
+    bool publish(const char topic[], const char payload[], int length) { return publish(topic, payload, length, false, 0); }
+    bool publish(const char topic[], const char payload[], int length, bool retained, int qos);
+    bool subscribe(const char topic[]) { return subscribe(topic, 0); }
+    bool subscribe(const char topic[], int qos);
+    bool loop();
+    bool connected();
+    bool disconnect();
+};
+
+#endif
@@ -0,0 +1,19 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef GATEWAY_SOFTWARESERIAL_H
+#define GATEWAY_SOFTWARESERIAL_H
+
+#include <stdint.h>
+
+// Declared so ArduinoPlatform.h compiles. The gateway talks to the
+// controllers through TermiosTransport; nothing here is implemented.
+class SoftwareSerial
+{
+public:
+    SoftwareSerial(uint8_t rxPin, uint8_t txPin);
+};
+
+#endif
@@ -0,0 +1,14 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef GATEWAY_PGMSPACE_H
+#define GATEWAY_PGMSPACE_H
+
+// There is no separate flash address space on the host.
+#include "SEProgmem.h"
+
+typedef const char *PGM_P;
+
+#endif
@@ -0,0 +1,240 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+// Linux gateway: the bridge as a daemon on a Linux host, talking to the
+// SEC-Touch through a USB-serial adapter. SEController, MqttBridge,
+// WebInterface and ConnectionManager are the firmware sources, built against
+// the Arduino API layer in native/gateway/compat.
+//
+//   pio run -e linux-gateway
+//   .pio/build/linux-gateway/program -c /etc/seventilation/gateway.conf
+//   .pio/build/linux-gateway/program -c gateway.conf --report 10   (CPU and latency every 10 s)
+//
+// Instead of loop() being called back to back, the main loop sleeps in
+// poll() on the serial ports and all sockets, at most GATEWAY_WAIT_MILLIS,
+// so the protocol timers keep their resolution while the process is idle
+// most of the time.
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include "ArduinoPlatform.h"
+#include "ConnectionManager.h"
+#include "GatewayConfig.h"
+#include "HostPlatform.h"
+#include "MqttBridge.h"
+#include "SECacheStore.h"
+#include "SECommandArbiter.h"
+#include "SEController.h"
+#include "SEMetrics.h"
+#include "SEUnitScheduler.h"
+#include "TermiosTransport.h"
+#include "WebInterface.h"
+
+// The shortest protocol timer is SEND_ACK_DELAY_MILLIS.
+#define GATEWAY_WAIT_MILLIS 1
+
+static volatile sig_atomic_t Stop = 0;
+
+static GatewayConfig Config;
+static TermiosTransport *Transport[SEUNITSCHEDULER_MAX_UNITS];
+static SEController *SEC[SEUNITSCHEDULER_MAX_UNITS];
+static MqttBridge *MQTT[SEUNITSCHEDULER_MAX_UNITS];
+static SECacheStore *Store[SEUNITSCHEDULER_MAX_UNITS];
+static SEUnitScheduler *Scheduler;
+static WebInterface *WebUI;
+static ConnectionManager *Connection;
+static SEMetrics Metrics;
+
+static void OnSignal(int)
+{
+    Stop = 1;
+}
+
+static void PrintUsage()
+{
+    fprintf(stderr, "usage: program -c FILE [--report SECONDS]\n");
+}
+
+static double CpuSeconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// CPU share since the previous report; latencies since start.
+static void Report()
+{
+    static unsigned long lastMillis = 0;
+    static double lastCpu = 0;
+    unsigned long now = millis();
+    double cpu = CpuSeconds();
+    double share = now > lastMillis ? 100.0 * (cpu - lastCpu) * 1000 / (now - lastMillis) : 0;
+    lastMillis = now;
+    lastCpu = cpu;
+
+    const SEHistogram &loop = Metrics.GetLoopMicros();
+    printf("cpu %.2f%%, loop mean %u us max %u us\n", share, loop.GetMean(), loop.GetMax());
+    for (size_t unit = 0; unit < Config.UnitCount; unit++)
+    {
+        const SEHistogram &ack = SEC[unit]->GetAckLatency();
+        const SEHistogram &gap = Scheduler->GetGapMicros(unit);
+        printf("  %-16s %lu requests, ack mean %.1f ms max %.1f ms, poll gap mean %u us max %u us, mqtt %s\n",
+               Config.Units[unit].Name, SEC[unit]->GetStats().RequestsSent, ack.GetMean() / 1000.0, ack.GetMax() / 1000.0,
+               gap.GetMean(), gap.GetMax(), Connection->IsMqttConnected(unit) ? "up" : "down");
+    }
+    fflush(stdout);
+}
+
+// Sleeps until a serial port or socket has input, at most GATEWAY_WAIT_MILLIS.
+static void Wait()
+{
+    struct pollfd fds[SEUNITSCHEDULER_MAX_UNITS + POSIX_SOCKETS_MAX];
+    size_t count = 0;
+    for (size_t unit = 0; unit < Config.UnitCount; unit++)
+    {
+        fds[count].fd = Transport[unit]->GetFd();
+        fds[count].events = POLLIN;
+        fds[count].revents = 0;
+        count++;
+    }
+    count += PosixCollectSockets(fds + count, POSIX_SOCKETS_MAX);
+    poll(fds, count, GATEWAY_WAIT_MILLIS);
+}
+
+static bool Setup()
+{
+    char hostname[64] = "gateway";
+    gethostname(hostname, sizeof(hostname) - 1);
+    SESetAreaLanguage(Config.Language);
+
+    SEClock *clock = new ArduinoClock();
+    Scheduler = new SEUnitScheduler(clock);
+    // The host's network is up; the manager only paces the broker connections.
+    Connection = new ConnectionManager(hostname, "", "");
+
+    for (size_t unit = 0; unit < Config.UnitCount; unit++)
+    {
+        const GatewayUnitConfig &config = Config.Units[unit];
+        Transport[unit] = new TermiosTransport();
+        if (!Transport[unit]->Open(config.Serial, Config.Baud))
+        {
+            fprintf(stderr, "%s: %s\n", config.Serial, strerror(errno));
+            return false;
+        }
+        SEC[unit] = new SEController(Transport[unit], clock);
+
+        // Same layout as on LittleFS: the file follows the position in the configuration.
+        if (Config.StateDir[0] != '\0')
+        {
+            char *path = new char[GATEWAY_PATH_LENGTH + 16];
+            snprintf(path, GATEWAY_PATH_LENGTH + 16, "%s/cache-%u.bin", Config.StateDir, (unsigned)unit);
+            Store[unit] = new SECacheStore(SEC[unit], new FileStorage(path), clock);
+            Store[unit]->Restore();
+        }
+        Scheduler->Add(config.Name, SEC[unit]);
+        SECommandArbiter *arbiter = new SECommandArbiter(SEC[unit], clock);
+
+        char clientId[MQTT_CLIENT_ID_LENGTH];
+        if (config.ClientId[0] != '\0') snprintf(clientId, sizeof(clientId), "%s", config.ClientId);
+        else snprintf(clientId, sizeof(clientId), "%s-%s", hostname, config.Name);
+        MQTT[unit] = new MqttBridge(Config.MqttHost, Config.MqttPort, SEC[unit], arbiter);
+        MQTT[unit]->SetClientId(clientId);
+        MQTT[unit]->SetTopicPrefix(config.Name);
+        MQTT[unit]->SetMetrics(&Metrics);
+        Connection->AddMqttBridge(MQTT[unit]);
+
+        // The web interface controls the first unit, as on the ESP8266.
+        if (unit == 0 && Config.HttpPort != 0)
+        {
+            WebUI = new WebInterface(SEC[unit], arbiter, Config.HttpPort);
+            WebUI->begin();
+            WebUI->setMetrics(&Metrics, Scheduler);
+        }
+        printf("unit %s on %s, topics below %s/\n", config.Name, config.Serial, config.Name);
+    }
+    fflush(stdout);
+    return true;
+}
+
+static void Loop()
+{
+    unsigned long start = micros();
+
+    Connection->Poll();
+    Scheduler->Poll();
+    for (size_t unit = 0; unit < Config.UnitCount; unit++)
+    {
+        MQTT[unit]->Poll();
+        Scheduler->Poll();
+    }
+    if (WebUI != NULL) WebUI->loop();
+    for (size_t unit = 0; unit < Config.UnitCount; unit++)
+    {
+        if (Store[unit] != NULL) Store[unit]->Poll();
+    }
+
+    Metrics.OnLoop(micros() - start, millis());
+}
+
+int main(int argc, char **argv)
+{
+    const char *configPath = NULL;
+    long report = -1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) configPath = argv[++i];
+        else if (strcmp(argv[i], "--report") == 0 && i + 1 < argc) report = atol(argv[++i]);
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (configPath == NULL)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    char error[GATEWAY_ERROR_LENGTH];
+    if (!LoadGatewayConfig(configPath, Config, error, sizeof(error)))
+    {
+        fprintf(stderr, "%s\n", error);
+        return 1;
+    }
+    if (report >= 0) Config.ReportSeconds = report;
+
+    PosixSetRestartArguments(argv);
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+    signal(SIGPIPE, SIG_IGN);
+    if (!Setup()) return 1;
+
+    unsigned long lastReport = millis();
+    while (!Stop)
+    {
+        Loop();
+        if (Config.ReportSeconds > 0 && millis() - lastReport >= Config.ReportSeconds * 1000)
+        {
+            lastReport = millis();
+            Report();
+        }
+        Wait();
+    }
+
+    // Pending cache changes are written now instead of after the save delay.
+    for (size_t unit = 0; unit < Config.UnitCount; unit++)
+    {
+        if (Store[unit] != NULL) Store[unit]->Flush();
+        delete MQTT[unit];
+    }
+    return 0;
+}
@@ -0,0 +1,73 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef PTYTRANSPORT_H
+#define PTYTRANSPORT_H
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include "SETransport.h"
+
+// Master side of a pseudo-terminal in raw mode. A bridge process opens
+// SlaveName() like a USB-serial adapter and talks to whatever drives the master.
+class PtyTransport : public SETransport
+{
+private:
+    int Fd = -1;
+    uint8_t Buffer[256];
+    size_t BufferStart = 0;
+    size_t BufferEnd = 0;
+
+    void Fill()
+    {
+        if (BufferStart < BufferEnd) return;
+        ssize_t count = read(Fd, Buffer, sizeof(Buffer));
+        BufferStart = 0;
+        BufferEnd = count > 0 ? (size_t)count : 0;
+    }
+
+public:
+    bool Open()
+    {
+        Fd = posix_openpt(O_RDWR | O_NOCTTY);
+        if (Fd < 0 || grantpt(Fd) != 0 || unlockpt(Fd) != 0) return false;
+
+        struct termios settings;
+        tcgetattr(Fd, &settings);
+        cfmakeraw(&settings);
+        tcsetattr(Fd, TCSANOW, &settings);
+        fcntl(Fd, F_SETFL, fcntl(Fd, F_GETFL) | O_NONBLOCK);
+        return true;
+    }
+
+    ~PtyTransport()
+    {
+        if (Fd >= 0) close(Fd);
+    }
+
+    const char *SlaveName() { return ptsname(Fd); }
+
+    int Available() override
+    {
+        Fill();
+        return (int)(BufferEnd - BufferStart);
+    }
+
+    int Read() override
+    {
+        Fill();
+        return BufferStart < BufferEnd ? Buffer[BufferStart++] : -1;
+    }
+
+    size_t Write(const uint8_t *buffer, size_t length) override
+    {
+        ssize_t written = write(Fd, buffer, length);
+        return written > 0 ? (size_t)written : 0;
+    }
+};
+
+#endif
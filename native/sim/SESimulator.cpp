@@ -0,0 +1,209 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "SESimulator.h"
+#include "SEController.h"
+#include "XModemCRC.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+SESimulator::SESimulator(SETransport *transport, SEClock *clock, const SESimulatorConfig &config)
+    : Transport(transport), Clock(clock), Config(config), Random(config.Seed)
+{
+    // Fan levels of the six areas and their room-name labels (index into the name table).
+    for (int registerId = 173; registerId <= 178; registerId++) Registers[registerId] = "2";
+    for (int registerId = 78; registerId <= 83; registerId++) Registers[registerId] = std::to_string(registerId - 71);
+
+    // Registers documented in SEController.h.
+    Registers[48] = "0800";
+    Registers[56] = "30";
+    Registers[58] = "5";
+    Registers[59] = "50";
+
+    LastPanelChange = clock->Millis();
+}
+
+void SESimulator::SetRegister(int registerId, const std::string &value)
+{
+    Registers[registerId] = value;
+}
+
+const std::string *SESimulator::GetRegister(int registerId) const
+{
+    std::map<int, std::string>::const_iterator it = Registers.find(registerId);
+    return it == Registers.end() ? NULL : &it->second;
+}
+
+bool SESimulator::Chance(double probability)
+{
+    return probability > 0 && std::uniform_real_distribution<double>(0.0, 1.0)(Random) < probability;
+}
+
+unsigned long SESimulator::Delay()
+{
+    unsigned long jitter = Config.ResponseJitterMicros > 0 ? Random() % (Config.ResponseJitterMicros + 1) : 0;
+    return Config.ResponseDelayMicros + jitter;
+}
+
+void SESimulator::Queue(unsigned long sendAt, const std::string &data)
+{
+    // Frames leave in order; a later frame never overtakes an earlier one.
+    if (!Outgoing.empty() && (long)(sendAt - Outgoing.back().SendAt) < 0) sendAt = Outgoing.back().SendAt;
+    Outgoing.push_back(PendingFrame{sendAt, data});
+}
+
+void SESimulator::QueueAck(unsigned long sendAt)
+{
+    if (Chance(Config.DropAckProbability))
+    {
+        Stats.AcksDropped++;
+        return;
+    }
+    const char ack[] = {STX, ACK, ETX};
+    Queue(sendAt, std::string(ack, sizeof(ack)));
+    Stats.AcksSent++;
+}
+
+void SESimulator::QueueValue(unsigned long sendAt, int registerId, const std::string &value)
+{
+    char frame[64];
+    int len = snprintf(frame, sizeof(frame), "%c%d%c%d%c%s%c", STX, COMMANDID_SET, TAB, registerId, TAB, value.c_str(), TAB);
+    unsigned short crc = GetXModemCRC(frame, len);
+    if (Chance(Config.CorruptCrcProbability))
+    {
+        crc ^= 0x5A5A;
+        Stats.CrcsCorrupted++;
+    }
+    len += snprintf(frame + len, sizeof(frame) - len, "%u%c", crc, ETX);
+    Queue(sendAt, std::string(frame, len));
+    Stats.ResponsesSent++;
+}
+
+// message is the NUL-terminated frame content between STX and ETX.
+void SESimulator::ProcessFrame(const char *message, size_t length)
+{
+    Stats.FramesReceived++;
+
+    if (length == 1 && message[0] == ACK)
+    {
+        Stats.AcksReceived++;
+        return;
+    }
+
+    // The CRC covers STX up to and including the last TAB.
+    const char *lastTab = (const char *)memrchr(message, TAB, length);
+    if (lastTab == NULL)
+    {
+        Stats.MalformedFrames++;
+        return;
+    }
+
+    char covered[64];
+    size_t coveredLength = lastTab - message + 2;
+    covered[0] = STX;
+    memcpy(covered + 1, message, coveredLength - 1);
+    unsigned long receivedCrc = strtoul(lastTab + 1, NULL, 10);
+    if (GetXModemCRC(covered, coveredLength) != receivedCrc)
+    {
+        Stats.CrcErrors++;
+        return;
+    }
+
+    char *cursor;
+    long commandId = strtol(message, &cursor, 10);
+    if (*cursor != TAB)
+    {
+        Stats.MalformedFrames++;
+        return;
+    }
+    long registerId = strtol(cursor + 1, &cursor, 10);
+    if (*cursor != TAB)
+    {
+        Stats.MalformedFrames++;
+        return;
+    }
+
+    unsigned long now = Clock->Micros();
+    if (commandId == COMMANDID_GET)
+    {
+        Stats.GetRequests++;
+        QueueAck(now + Delay());
+        const std::string *value = GetRegister(registerId);
+        if (value == NULL)
+        {
+            Stats.UnknownRegisters++;
+            return;
+        }
+        QueueValue(now + Delay(), registerId, *value);
+    }
+    else if (commandId == COMMANDID_SET)
+    {
+        Stats.SetRequests++;
+        const char *value = cursor + 1;
+        if (value < lastTab)
+        {
+            Registers[registerId] = std::string(value, lastTab - value);
+        }
+        QueueAck(now + Delay());
+    }
+    else
+    {
+        Stats.MalformedFrames++;
+    }
+}
+
+void SESimulator::ProcessPanel()
+{
+    if (Config.PanelChangeIntervalMillis == 0) return;
+
+    unsigned long now = Clock->Millis();
+    if (now - LastPanelChange >= Config.PanelChangeIntervalMillis)
+    {
+        LastPanelChange = now;
+        int registerId = 173 + Random() % 6;
+        std::string value = std::to_string(Random() % 7);
+        if (Registers[registerId] == value) return;
+        Registers[registerId] = value;
+        LastPanelRegister = registerId;
+        LastPanelChangeMicros = Clock->Micros();
+        Stats.PanelChanges++;
+    }
+}
+
+void SESimulator::Poll()
+{
+    while (Transport->Available() > 0)
+    {
+        int incoming = Transport->Read();
+        if (incoming < 0) break;
+
+        if (incoming == STX)
+        {
+            InsideMessage = true;
+            ReceiveLength = 0;
+        }
+        else if (incoming == ETX && InsideMessage)
+        {
+            InsideMessage = false;
+            ReceiveBuffer[ReceiveLength] = '\0';
+            ProcessFrame(ReceiveBuffer, ReceiveLength);
+        }
+        else if (InsideMessage && ReceiveLength < sizeof(ReceiveBuffer) - 1)
+        {
+            ReceiveBuffer[ReceiveLength++] = (char)incoming;
+        }
+    }
+
+    unsigned long now = Clock->Micros();
+    while (!Outgoing.empty() && (long)(now - Outgoing.front().SendAt) >= 0)
+    {
+        const std::string &data = Outgoing.front().Data;
+        Transport->Write((const uint8_t *)data.data(), data.size());
+        Outgoing.pop_front();
+    }
+
+    ProcessPanel();
+}
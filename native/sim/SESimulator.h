@@ -0,0 +1,86 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#ifndef SESIMULATOR_H
+#define SESIMULATOR_H
+
+#include <deque>
+#include <map>
+#include <random>
+#include <string>
+#include "SETransport.h"
+
+struct SESimulatorConfig
+{
+    unsigned long ResponseDelayMicros = 3000;  // request received -> ACK on the wire
+    unsigned long ResponseJitterMicros = 1000; // uniform 0..jitter added to every delay
+    double DropAckProbability = 0.0;           // request is silently not acknowledged
+    double CorruptCrcProbability = 0.0;        // response frame carries a wrong CRC
+    unsigned long PanelChangeIntervalMillis = 0; // 0 = nobody touches the panel
+    unsigned int Seed = 1;
+};
+
+struct SESimulatorStats
+{
+    unsigned long FramesReceived = 0;
+    unsigned long GetRequests = 0;
+    unsigned long SetRequests = 0;
+    unsigned long AcksReceived = 0;
+    unsigned long CrcErrors = 0;
+    unsigned long MalformedFrames = 0;
+    unsigned long AcksSent = 0;
+    unsigned long AcksDropped = 0;
+    unsigned long ResponsesSent = 0;
+    unsigned long CrcsCorrupted = 0;
+    unsigned long UnknownRegisters = 0;
+    unsigned long PanelChanges = 0;
+};
+
+// Software stand-in for the SEC-Touch "Zentralregler". Speaks the
+// reverse-engineered STX/TAB/CRC/ETX protocol documented in SEController.cpp:
+// every valid request is acknowledged with STX ACK ETX, a GET (32800) is
+// answered with a SET (32) frame carrying the register value, and a SET
+// updates the register. Unknown registers are acknowledged but not answered.
+class SESimulator
+{
+private:
+    struct PendingFrame
+    {
+        unsigned long SendAt;
+        std::string Data;
+    };
+
+    SETransport *Transport;
+    SEClock *Clock;
+    SESimulatorConfig Config;
+    std::mt19937 Random;
+
+    std::map<int, std::string> Registers;
+    std::deque<PendingFrame> Outgoing;
+    char ReceiveBuffer[64];
+    size_t ReceiveLength = 0;
+    bool InsideMessage = false;
+    unsigned long LastPanelChange = 0;
+
+    bool Chance(double probability);
+    unsigned long Delay();
+    void Queue(unsigned long sendAt, const std::string &data);
+    void QueueAck(unsigned long sendAt);
+    void QueueValue(unsigned long sendAt, int registerId, const std::string &value);
+    void ProcessFrame(const char *message, size_t length);
+    void ProcessPanel();
+
+public:
+    SESimulatorStats Stats;
+    int LastPanelRegister = -1;
+    unsigned long LastPanelChangeMicros = 0;
+
+    SESimulator(SETransport *transport, SEClock *clock, const SESimulatorConfig &config);
+    void SetRegister(int registerId, const std::string &value);
+    const std::string *GetRegister(int registerId) const;
+    void Poll();
+};
+
+#endif
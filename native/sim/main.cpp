@@ -0,0 +1,706 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+// SEC-Touch simulator harness.
+//
+// In-process mode (default) wires an SEController to the simulator through a
+// SimulatedLink at 28800 baud on a virtual clock, so hours of bus traffic run
+// in seconds, and reports round-trip latency percentiles and lost frames:
+//
+//   pio run -e native-sim -t exec
+//   .pio/build/native-sim/program --hours 4 --delay 3000 --jitter 2000 --drop-ack 0.01 --corrupt-crc 0.01
+//   .pio/build/native-sim/program --drop-ack 0.3 --trace-arm --trace 64   (trace around the first failed request)
+//   .pio/build/native-sim/program --units 4 --metrics                      (four units on one scheduler)
+//   .pio/build/native-sim/program --state cache.bin                        (warm start from the saved cache)
+//
+// PTY mode runs the simulator in real time on a pseudo-terminal that an
+// external bridge can open like a USB-serial adapter:
+//
+//   .pio/build/native-sim/program --pty --seconds 3600
+//
+// --check-redelivery plays fixed command sequences against SEWriteTracker and
+// exits with 1 if a redelivery is not recognised or a new command is dropped.
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <unistd.h>
+#include <vector>
+#include "HostPlatform.h"
+#include "PtyTransport.h"
+#include "SECommandArbiter.h"
+#include "SEController.h"
+#include "SEAreaNames.h"
+#include "SECacheStore.h"
+#include "SEMetrics.h"
+#include "SESimulator.h"
+#include "SEUnitScheduler.h"
+#include "SEWriteTracker.h"
+#include "SimulatedLink.h"
+
+// Latencies in 100 us buckets up to 10 s; everything above lands in the last bucket.
+class LatencyHistogram
+{
+private:
+    static const unsigned long BUCKET_MICROS = 100;
+    std::vector<unsigned long> Buckets = std::vector<unsigned long>(100000, 0);
+    unsigned long Max = 0;
+
+public:
+    unsigned long Count = 0;
+
+    void Add(unsigned long micros)
+    {
+        size_t bucket = micros / BUCKET_MICROS;
+        if (bucket >= Buckets.size()) bucket = Buckets.size() - 1;
+        Buckets[bucket]++;
+        Count++;
+        if (micros > Max) Max = micros;
+    }
+
+    double Percentile(double percentile) const
+    {
+        if (Count == 0) return 0;
+        unsigned long target = (unsigned long)(Count * percentile / 100.0);
+        unsigned long seen = 0;
+        for (size_t bucket = 0; bucket < Buckets.size(); bucket++)
+        {
+            seen += Buckets[bucket];
+            // The bucket's upper bound, but never above the largest sample.
+            if (seen > target) return std::min<unsigned long>((bucket + 1) * BUCKET_MICROS, Max) / 1000.0;
+        }
+        return Max / 1000.0;
+    }
+
+    void Print(const char *name) const
+    {
+        printf("%-16s %10lu %9.1f %9.1f %9.1f %9.1f %9.1f\n", name, Count,
+               Percentile(50), Percentile(90), Percentile(99), Percentile(99.9), Max / 1000.0);
+    }
+};
+
+// Sits between the SEController and its end of the link and timestamps
+// traffic: a GET is answered when the value frame for its register arrives,
+// any request is acknowledged by the next ACK frame.
+class LatencyProbe : public SETransport
+{
+private:
+    SETransport *Inner;
+    SEClock *Clock;
+    std::vector<long> PendingGet = std::vector<long>(1024, -1);
+    long PendingAck = -1;
+    char Frame[64];
+    size_t FrameLength = 0;
+    bool InsideFrame = false;
+
+    void OnFrameWritten(const char *message)
+    {
+        if (message[0] == ACK) return;
+        int commandId = atoi(message);
+        const char *tab = strchr(message, TAB);
+        int registerId = tab != NULL ? atoi(tab + 1) : -1;
+        long now = (long)Clock->Micros();
+
+        if (PendingAck >= 0) AcksLost++;
+        PendingAck = now;
+        if (commandId == COMMANDID_GET && registerId >= 0 && registerId < (int)PendingGet.size())
+        {
+            if (PendingGet[registerId] >= 0) ResponsesLost++;
+            PendingGet[registerId] = now;
+            GetsSent++;
+        }
+        else
+        {
+            SetsSent++;
+        }
+    }
+
+    void OnFrameRead(const char *message)
+    {
+        long now = (long)Clock->Micros();
+        if (message[0] == ACK && message[1] == '\0')
+        {
+            if (PendingAck >= 0) AckLatency.Add(now - PendingAck);
+            PendingAck = -1;
+            return;
+        }
+        const char *tab = strchr(message, TAB);
+        int registerId = tab != NULL ? atoi(tab + 1) : -1;
+        if (registerId >= 0 && registerId < (int)PendingGet.size() && PendingGet[registerId] >= 0)
+        {
+            GetLatency.Add(now - PendingGet[registerId]);
+            PendingGet[registerId] = -1;
+        }
+    }
+
+    void Observe(uint8_t value)
+    {
+        if (value == STX)
+        {
+            InsideFrame = true;
+            FrameLength = 0;
+        }
+        else if (value == ETX && InsideFrame)
+        {
+            InsideFrame = false;
+            Frame[FrameLength] = '\0';
+            OnFrameRead(Frame);
+        }
+        else if (InsideFrame && FrameLength < sizeof(Frame) - 1)
+        {
+            Frame[FrameLength++] = (char)value;
+        }
+    }
+
+public:
+    LatencyHistogram AckLatency;
+    LatencyHistogram GetLatency;
+    unsigned long GetsSent = 0;
+    unsigned long SetsSent = 0;
+    unsigned long AcksLost = 0;
+    unsigned long ResponsesLost = 0;
+
+    LatencyProbe(SETransport *inner, SEClock *clock) : Inner(inner), Clock(clock) {}
+
+    int Available() override { return Inner->Available(); }
+
+    int Read() override
+    {
+        int value = Inner->Read();
+        if (value >= 0) Observe((uint8_t)value);
+        return value;
+    }
+
+    size_t ReadBytes(uint8_t *buffer, size_t length) override
+    {
+        size_t count = Inner->ReadBytes(buffer, length);
+        for (size_t i = 0; i < count; i++) Observe(buffer[i]);
+        return count;
+    }
+
+    size_t Write(const uint8_t *buffer, size_t length) override
+    {
+        // The controller always writes whole frames.
+        if (length > 2 && length < sizeof(Frame) && buffer[0] == STX)
+        {
+            memcpy(Frame, buffer + 1, length - 2);
+            Frame[length - 2] = '\0';
+            OnFrameWritten(Frame);
+        }
+        return Inner->Write(buffer, length);
+    }
+};
+
+// Time from a change on the panel until the bridge reports it.
+struct DetectionListener : public SERegisterListener
+{
+    SESimulator &Simulator;
+    SEClock &Clock;
+    LatencyHistogram Histogram;
+
+    DetectionListener(SESimulator &simulator, SEClock &clock) : Simulator(simulator), Clock(clock) {}
+
+    void OnRegisterChanged(SEController *, int registerId, const char *) override
+    {
+        if (registerId == Simulator.LastPanelRegister)
+        {
+            Histogram.Add(Clock.Micros() - Simulator.LastPanelChangeMicros);
+            Simulator.LastPanelRegister = -1;
+        }
+    }
+};
+
+struct Options
+{
+    SESimulatorConfig Simulator;
+    double Seconds = 600;
+    unsigned long StepMicros = 50;
+    unsigned long SetIntervalMillis = 0;
+    unsigned long SetBurst = 1;
+    int ScanFirst = -1;
+    int ScanLast = -1;
+    unsigned long ScanIntervalMillis = 0;
+    unsigned long TraceLines = 0;
+    bool TraceArm = false;
+    bool Metrics = false;
+    bool Pty = false;
+    bool CheckRedelivery = false;
+    unsigned long Units = 1;
+    const char *StatePath = NULL;
+};
+
+static void PrintUsage()
+{
+    printf("usage: program [--hours H | --seconds S] [--delay US] [--jitter US] [--drop-ack P]\n"
+           "               [--corrupt-crc P] [--panel-change MS] [--set-interval MS] [--set-burst N]\n"
+           "               [--scan FIRST-LAST] [--scan-interval MS] [--trace N] [--trace-arm]\n"
+           "               [--metrics] [--units N] [--state FILE] [--step US] [--seed N] [--pty]\n"
+           "               [--check-redelivery]\n");
+}
+
+static bool ParseOptions(int argc, char **argv, Options &options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--pty") == 0) { options.Pty = true; continue; }
+        if (strcmp(arg, "--trace-arm") == 0) { options.TraceArm = true; continue; }
+        if (strcmp(arg, "--metrics") == 0) { options.Metrics = true; continue; }
+        if (strcmp(arg, "--check-redelivery") == 0) { options.CheckRedelivery = true; continue; }
+        if (value == NULL) return false;
+        i++;
+        if (strcmp(arg, "--hours") == 0) options.Seconds = atof(value) * 3600;
+        else if (strcmp(arg, "--seconds") == 0) options.Seconds = atof(value);
+        else if (strcmp(arg, "--delay") == 0) options.Simulator.ResponseDelayMicros = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--jitter") == 0) options.Simulator.ResponseJitterMicros = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--drop-ack") == 0) options.Simulator.DropAckProbability = atof(value);
+        else if (strcmp(arg, "--corrupt-crc") == 0) options.Simulator.CorruptCrcProbability = atof(value);
+        else if (strcmp(arg, "--panel-change") == 0) options.Simulator.PanelChangeIntervalMillis = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--set-interval") == 0) options.SetIntervalMillis = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--set-burst") == 0) options.SetBurst = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--scan") == 0)
+        {
+            if (sscanf(value, "%d-%d", &options.ScanFirst, &options.ScanLast) != 2) return false;
+        }
+        else if (strcmp(arg, "--scan-interval") == 0) options.ScanIntervalMillis = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--trace") == 0) options.TraceLines = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--units") == 0)
+        {
+            options.Units = strtoul(value, NULL, 10);
+            if (options.Units < 1 || options.Units > SEUNITSCHEDULER_MAX_UNITS) return false;
+        }
+        else if (strcmp(arg, "--state") == 0) options.StatePath = value;
+        else if (strcmp(arg, "--step") == 0) options.StepMicros = strtoul(value, NULL, 10);
+        else if (strcmp(arg, "--seed") == 0) options.Simulator.Seed = strtoul(value, NULL, 10);
+        else return false;
+    }
+    return true;
+}
+
+static void PrintSimulatorStats(const SESimulatorStats &stats)
+{
+    printf("simulator: %lu frames in (%lu GET, %lu SET, %lu ACK, %lu CRC errors, %lu malformed), "
+           "%lu ACKs sent, %lu dropped, %lu responses, %lu corrupted, %lu panel changes\n",
+           stats.FramesReceived, stats.GetRequests, stats.SetRequests, stats.AcksReceived, stats.CrcErrors,
+           stats.MalformedFrames, stats.AcksSent, stats.AcksDropped, stats.ResponsesSent, stats.CrcsCorrupted,
+           stats.PanelChanges);
+}
+
+struct StdoutSink : public JsonSink
+{
+    void Write(const char *data, size_t length) override
+    {
+        fwrite(data, 1, length, stdout);
+    }
+};
+
+static void PrintTrace(const SETrace &trace, unsigned long lines)
+{
+    if (lines == 0) return;
+    printf("\ntrace%s: sequence micros event register value detail\n", trace.IsFrozen() ? " (frozen)" : "");
+    uint32_t first = trace.GetHead() > lines ? trace.GetHead() - lines : 0;
+    if (first < trace.GetOldest()) first = trace.GetOldest();
+    char line[SETRACE_LINE_LENGTH];
+    SETraceEntry entry;
+    for (uint32_t sequence = first; sequence < trace.GetHead(); sequence++)
+    {
+        if (!trace.Get(sequence, entry)) continue;
+        SETrace::Format(sequence, entry, line, sizeof(line));
+        fputs(line, stdout);
+    }
+}
+
+// A further SEC-Touch on its own line, without writes or probes, served by
+// the same scheduler as the first unit.
+struct SimulatedUnit
+{
+    char Name[24];
+    SimulatedLink Link;
+    SEController Controller;
+    SESimulator Simulator;
+
+    SimulatedUnit(SEClock *clock, const SESimulatorConfig &config)
+        : Link(clock, SECONTROLLER_BAUD), Controller(&Link.A, clock), Simulator(&Link.B, clock, config) {}
+};
+
+// Number of the six area registers from firstRegister on with a cached value; with fromBus only those read since the start.
+static int CountAreas(const SEController &controller, int firstRegister, bool fromBus)
+{
+    int known = 0;
+    for (int area = 0; area < SEAREA_COUNT; area++)
+    {
+        if (controller.GetRegisterValue(firstRegister + area) == NULL) continue;
+        if (fromBus && controller.GetRegisterUpdatedMillis(firstRegister + area) == 0) continue;
+        known++;
+    }
+    return known;
+}
+
+// Startup until every area has a level or label: the bridge's restart-to-consistent-state time.
+struct StartupTimes
+{
+    long Known = -1;
+    long FromBus = -1;
+
+    void Update(const SEController &controller, int firstRegister, unsigned long nowMillis)
+    {
+        if (Known < 0 && CountAreas(controller, firstRegister, false) == SEAREA_COUNT) Known = nowMillis;
+        if (FromBus < 0 && CountAreas(controller, firstRegister, true) == SEAREA_COUNT) FromBus = nowMillis;
+    }
+};
+
+static int RunInProcess(const Options &options)
+{
+    ManualClock clock;
+    SimulatedLink link(&clock, SECONTROLLER_BAUD);
+    LatencyProbe probe(&link.A, &clock);
+    SEController controller(&probe, &clock);
+    SESimulator simulator(&link.B, &clock, options.Simulator);
+
+    DetectionListener detection(simulator, clock);
+    controller.AddRegisterListener(&detection);
+
+    // Writes alternate between two frontends of different precedence, as MQTT and the web interface would.
+    SECommandArbiter arbiter(&controller, &clock);
+    int sources[] = {arbiter.AddSource("mqtt", 0), arbiter.AddSource("web", 1)};
+    // Follows every write to its confirmed read-back, as the MQTT bridge does for its acks.
+    SEWriteTracker tracker(&controller, &clock);
+
+    SEUnitScheduler units(&clock);
+    units.Add("airsystem", &controller);
+    std::vector<std::unique_ptr<SimulatedUnit>> others;
+    for (unsigned long unit = 1; unit < options.Units; unit++)
+    {
+        SESimulatorConfig config = options.Simulator;
+        config.Seed += unit;
+        others.emplace_back(new SimulatedUnit(&clock, config));
+        snprintf(others.back()->Name, sizeof(others.back()->Name), "airsystem-%u", (unsigned)unit + 1);
+        units.Add(others.back()->Name, &others.back()->Controller);
+    }
+
+    // With --state, the cache is restored from the file before the first poll and saved to it as on the device.
+    std::unique_ptr<FileStorage> storage;
+    std::unique_ptr<SECacheStore> store;
+    if (options.StatePath != NULL)
+    {
+        storage.reset(new FileStorage(options.StatePath));
+        store.reset(new SECacheStore(&controller, storage.get(), &clock));
+        store->Restore();
+    }
+
+    if (options.TraceArm) controller.GetTrace().Arm();
+    if (options.ScanFirst >= 0)
+    {
+        controller.GetScanner().SetInterval(options.ScanIntervalMillis);
+        controller.StartScan(options.ScanFirst, options.ScanLast, true);
+    }
+
+    unsigned long long endMicros = (unsigned long long)(options.Seconds * 1e6);
+    unsigned long long elapsed = 0;
+    unsigned long lastSet = 0;
+    unsigned long setCounter = 0;
+    unsigned long nextReport = 3600;
+    HostClock wall;
+    // With --metrics, the loop duration histogram holds the wall time of every scheduler pass.
+    SEMetrics metrics;
+    StartupTimes levels;
+    StartupTimes labels;
+    levels.Update(controller, SEAREA_LEVEL_REGISTER, 0);
+    labels.Update(controller, SEAREA_LABEL_REGISTER, 0);
+
+    while (elapsed < endMicros)
+    {
+        clock.Now += options.StepMicros;
+        elapsed += options.StepMicros;
+
+        if (options.Metrics)
+        {
+            unsigned long start = wall.Micros();
+            units.Poll();
+            metrics.OnLoop(wall.Micros() - start, clock.Millis());
+        }
+        else
+        {
+            units.Poll();
+        }
+        simulator.Poll();
+        for (std::unique_ptr<SimulatedUnit> &unit : others) unit->Simulator.Poll();
+
+        tracker.Poll();
+        while (tracker.TakeReport() != NULL)
+        {
+        }
+
+        if (store) store->Poll();
+        levels.Update(controller, SEAREA_LEVEL_REGISTER, clock.Millis());
+        labels.Update(controller, SEAREA_LABEL_REGISTER, clock.Millis());
+
+        if (options.SetIntervalMillis > 0 && clock.Millis() - lastSet >= options.SetIntervalMillis)
+        {
+            lastSet = clock.Millis();
+            for (unsigned long i = 0; i < options.SetBurst; i++)
+            {
+                char value[8];
+                snprintf(value, sizeof(value), "%lu", setCounter % 7);
+                int registerId = 173 + setCounter % 6;
+                if (tracker.Begin(registerId, value, NULL) && !arbiter.Write(sources[setCounter / 6 % 2], registerId, value))
+                {
+                    tracker.Reject(registerId);
+                }
+                setCounter++;
+            }
+        }
+
+        if (elapsed / 1000000 >= nextReport)
+        {
+            printf("... %lu h simulated, %lu GETs, %lu lost responses\n", nextReport / 3600, probe.GetsSent, probe.ResponsesLost);
+            nextReport += 3600;
+        }
+    }
+
+    double seconds = elapsed / 1e6;
+    unsigned long busBytes = link.A.BytesWritten + link.B.BytesWritten;
+    printf("simulated %.0f s at %lu baud in %.1f s wall time\n\n", seconds, (unsigned long)SECONTROLLER_BAUD, wall.Millis() / 1000.0);
+    printf("%-16s %10s %9s %9s %9s %9s %9s\n", "latency [ms]", "samples", "p50", "p90", "p99", "p99.9", "max");
+    probe.AckLatency.Print("request->ACK");
+    probe.GetLatency.Print("GET->value");
+    detection.Histogram.Print("panel->bridge");
+    printf("\nrequests: %lu GET, %lu SET (%lu submitted), %.1f GET/s\n", probe.GetsSent, probe.SetsSent, setCounter, probe.GetsSent / seconds);
+    printf("lost: %lu ACKs, %lu GET responses (%.3f %%)\n", probe.AcksLost, probe.ResponsesLost,
+           probe.GetsSent ? 100.0 * probe.ResponsesLost / probe.GetsSent : 0.0);
+    printf("all fan levels known %ld ms after start, read from the bus after %ld ms\n", levels.Known, levels.FromBus);
+    printf("all room labels known %ld ms after start, read from the bus after %ld ms\n", labels.Known, labels.FromBus);
+    if (store)
+    {
+        store->Flush();
+        printf("cache store: %lu registers restored, %lu saves, %lu skipped, %lu failures\n", store->Stats.Restored,
+               store->Stats.Saves, store->Stats.Skipped, store->Stats.Failures);
+    }
+    printf("bus utilization: %.1f %% (%lu bytes), last window %.1f %% as seen by the controller\n",
+           100.0 * busBytes * link.MicrosPerByte / elapsed, busBytes, 100.0 * controller.GetBusUtilization());
+
+    const SEPollScheduler &scheduler = controller.GetPollScheduler();
+    printf("\n%-10s %12s %10s %10s %12s\n", "register", "interval ms", "polls", "changes", "staleness ms");
+    for (size_t i = 0; i < scheduler.GetCount(); i++)
+    {
+        const SEPollEntry &entry = scheduler.GetEntry(i);
+        printf("%-10d %12lu %10lu %10lu %12lu\n", entry.RegisterId, entry.IntervalMillis, entry.Polls, entry.Changes,
+               entry.HasValue ? clock.Millis() - entry.LastValueMillis : 0);
+    }
+    printf("\n");
+    const SEControllerStats &stats = controller.GetStats();
+    const SEFrameErrors &errors = controller.GetFrameErrors();
+    printf("controller: %lu requests sent, %lu ACK timeouts, %lu retransmits, %lu failed, "
+           "%lu writes confirmed, %lu mismatched, %lu failed\n",
+           stats.RequestsSent, stats.AckTimeouts, stats.Retransmits, stats.RequestsFailed,
+           stats.WritesConfirmed, stats.WritesMismatched, stats.WritesFailed);
+    const SECommandQueueStats &queue = controller.GetQueueStats();
+    static const char *priorities[] = {"write", "confirm", "poll", "label", "scan"};
+    printf("queue: %lu enqueued, %lu coalesced, %lu dropped, %lu evicted, max depth %u\n",
+           queue.Enqueued, queue.Coalesced, queue.Dropped, queue.Evicted, queue.MaxDepth);
+    for (int priority = 0; priority < SECOMMAND_PRIORITY_COUNT; priority++)
+    {
+        printf("  %-8s %9lu sent, wait mean %6.1f ms, max %5lu ms\n", priorities[priority], queue.Dequeued[priority],
+               queue.Dequeued[priority] ? (double)queue.TotalWaitMillis[priority] / queue.Dequeued[priority] : 0.0,
+               queue.MaxWaitMillis[priority]);
+    }
+    printf("arbiter: %lu writes, %lu accepted, %lu superseded, %lu rejected, %lu failed\n",
+           arbiter.Stats.Writes, arbiter.Stats.Accepted, arbiter.Stats.Superseded, arbiter.Stats.Rejected, arbiter.Stats.Failed);
+    if (tracker.Stats.Writes > 0)
+    {
+        printf("write outcomes: %lu confirmed, %lu failed, %lu superseded, %lu rejected, %lu timeout, %lu duplicates; "
+               "command->confirmed mean %lu ms, max %lu ms\n",
+               tracker.Stats.Results[SETRACKED_CONFIRMED], tracker.Stats.Results[SETRACKED_FAILED],
+               tracker.Stats.Results[SETRACKED_SUPERSEDED], tracker.Stats.Results[SETRACKED_REJECTED],
+               tracker.Stats.Results[SETRACKED_TIMEOUT], tracker.Stats.Duplicates,
+               (unsigned long)tracker.LatencyMillis.GetMean(), (unsigned long)tracker.LatencyMillis.GetMax());
+    }
+    SERegisterScanner &scanner = controller.GetScanner();
+    if (scanner.Stats.Requests > 0)
+    {
+        printf("scan: %.1f registers/s, %lu requests, %lu answers, %lu timeouts, %lu sweeps, %u registers found\n",
+               scanner.GetRegistersPerSecond(clock.Millis()), scanner.Stats.Requests, scanner.Stats.Answers,
+               scanner.Stats.Timeouts, scanner.Stats.Sweeps, (unsigned)scanner.GetCount());
+    }
+    printf("frames: %lu received, %lu overflow, %lu CRC mismatch, %lu truncated, %lu malformed\n",
+           controller.GetFramesReceived(), errors.Overflows, errors.CrcMismatches, errors.Truncated, errors.Malformed);
+    PrintSimulatorStats(simulator.Stats);
+    if (units.GetCount() > 1)
+    {
+        printf("\n%-12s %10s %10s %10s %12s %12s\n", "unit", "requests/s", "frames", "failed", "poll gap us", "levels known");
+        for (size_t unit = 0; unit < units.GetCount(); unit++)
+        {
+            const SEController &member = *units.GetController(unit);
+            int known = 0;
+            for (int area = 0; area < SEAREA_COUNT; area++)
+            {
+                if (member.GetRegisterValue(SEAREA_LEVEL_REGISTER + area) != NULL) known++;
+            }
+            printf("%-12s %10.1f %10lu %10lu %12lu %12d\n", units.GetName(unit), member.GetStats().RequestsSent / seconds,
+                   member.GetFramesReceived(), member.GetStats().RequestsFailed, (unsigned long)units.GetGapMicros(unit).GetMax(), known);
+        }
+    }
+    PrintTrace(controller.GetTrace(), options.TraceLines);
+    if (options.Metrics)
+    {
+        char buffer[256];
+        StdoutSink sink;
+        JsonWriter text(buffer, sizeof(buffer), &sink);
+        printf("\n");
+        metrics.WritePrometheus(text, units);
+        text.Flush();
+    }
+    return 0;
+}
+
+// Tracker, controller and simulator on the virtual clock, driven like the MQTT bridge drives them.
+class RedeliveryCheck
+{
+private:
+    ManualClock Clock;
+    SimulatedLink Link;
+    SEController Controller;
+    SESimulator Simulator;
+    SECommandArbiter Arbiter;
+    SEWriteTracker Tracker;
+    int Source;
+    int Failures = 0;
+
+    void Run(unsigned long millis)
+    {
+        for (unsigned long step = 0; step < millis * 20; step++)
+        {
+            Clock.Now += 50;
+            Controller.Poll();
+            Simulator.Poll();
+            Tracker.Poll();
+        }
+    }
+
+    // Sends a command as MqttBridge::OnSetRegister() does; false if it was taken as a redelivery.
+    bool Command(const char *value, const char *id)
+    {
+        if (!Tracker.Begin(SEAREA_LEVEL_REGISTER, value, id)) return false;
+        if (!Arbiter.Write(Source, SEAREA_LEVEL_REGISTER, value)) Tracker.Reject(SEAREA_LEVEL_REGISTER);
+        return true;
+    }
+
+    // Result of the last report for area 1 within millis, or -1.
+    int Outcome(unsigned long millis)
+    {
+        int result = -1;
+        for (unsigned long waited = 0; waited < millis && result < 0; waited += 10)
+        {
+            Run(10);
+            const SEWriteReport *report;
+            while ((report = Tracker.TakeReport()) != NULL) result = report->Result;
+        }
+        return result;
+    }
+
+    void Expect(bool condition, const char *step)
+    {
+        printf("  %-58s %s\n", step, condition ? "ok" : "FAILED");
+        if (!condition) Failures++;
+    }
+
+public:
+    RedeliveryCheck(const SESimulatorConfig &config)
+        : Link(&Clock, SECONTROLLER_BAUD), Controller(&Link.A, &Clock), Simulator(&Link.B, &Clock, config),
+          Arbiter(&Controller, &Clock), Tracker(&Controller, &Clock)
+    {
+        Source = Arbiter.AddSource("mqtt", 0);
+    }
+
+    int Execute()
+    {
+        printf("redelivery check\n");
+        Run(1000);
+        Expect(Controller.GetRegisterValue(SEAREA_LEVEL_REGISTER) != NULL, "level of area 1 known");
+
+        Expect(Command("3", NULL) && Outcome(1000) == SETRACKED_CONFIRMED, "level 3 without id confirmed");
+        Expect(!Command("3", NULL) && Outcome(10) == SETRACKED_CONFIRMED, "level 3 again: redelivery, first outcome");
+
+        // Someone sets level 1 at the panel; the next poll brings it into the cache.
+        Simulator.SetRegister(SEAREA_LEVEL_REGISTER, "1");
+        for (int waited = 0; waited < SEWRITETRACKER_DEDUP_MILLIS / 2; waited += 10)
+        {
+            const char *value = Controller.GetRegisterValue(SEAREA_LEVEL_REGISTER);
+            if (value != NULL && strcmp(value, "1") == 0) break;
+            Run(10);
+        }
+        const char *level = Controller.GetRegisterValue(SEAREA_LEVEL_REGISTER);
+        Expect(level != NULL && strcmp(level, "1") == 0, "panel change to 1 read back within the window");
+        Expect(Command("3", NULL), "level 3 after the panel change: new command");
+        Expect(Outcome(1000) == SETRACKED_CONFIRMED, "  confirmed");
+        const std::string *panel = Simulator.GetRegister(SEAREA_LEVEL_REGISTER);
+        Expect(panel != NULL && *panel == "3", "  SEC-Touch runs at level 3");
+
+        Run(SEWRITETRACKER_DEDUP_MILLIS);
+        Expect(Command("4", "a1") && Outcome(1000) == SETRACKED_CONFIRMED, "level 4 with id a1 confirmed");
+        Simulator.SetRegister(SEAREA_LEVEL_REGISTER, "1");
+        Run(SEWRITETRACKER_DEDUP_MILLIS / 2);
+        Expect(!Command("4", "a1") && Outcome(10) == SETRACKED_CONFIRMED, "id a1 again after a panel change: redelivery");
+        Expect(Command("4", "a2"), "level 4 with id a2: new command");
+
+        printf("redelivery check %s\n", Failures == 0 ? "passed" : "FAILED");
+        return Failures == 0 ? 0 : 1;
+    }
+};
+
+static volatile sig_atomic_t Stop = 0;
+
+static void OnSignal(int)
+{
+    Stop = 1;
+}
+
+static int RunPty(const Options &options)
+{
+    PtyTransport pty;
+    if (!pty.Open())
+    {
+        perror("posix_openpt");
+        return 1;
+    }
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+
+    HostClock clock;
+    SESimulator simulator(&pty, &clock, options.Simulator);
+    printf("SEC-Touch simulator listening on %s\n", pty.SlaveName());
+    fflush(stdout);
+
+    unsigned long lastReport = 0;
+    while (!Stop && clock.Millis() < options.Seconds * 1000)
+    {
+        simulator.Poll();
+        usleep(options.StepMicros);
+        if (clock.Millis() - lastReport >= 10000)
+        {
+            lastReport = clock.Millis();
+            PrintSimulatorStats(simulator.Stats);
+            fflush(stdout);
+        }
+    }
+    PrintSimulatorStats(simulator.Stats);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        PrintUsage();
+        return 1;
+    }
+    if (options.CheckRedelivery) return RedeliveryCheck(options.Simulator).Execute();
+    return options.Pty ? RunPty(options) : RunInProcess(options);
+}
@@ -0,0 +1,67 @@
+# This file is part of the SEVentilation to MQTT project.
+# Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+#
+# PlatformIO pre-build script: compresses web/index.html with gzip and
+# writes it as a PROGMEM byte array to <build dir>/generated/WebPage.h,
+# together with an ETag derived from the compressed content.
+#
+# Without PlatformIO: python scripts/embed_web.py web/index.html out/WebPage.h
+
+import gzip
+import hashlib
+import os
+import sys
+
+
+def generate(source, target):
+    with open(source, "rb") as f:
+        html = f.read()
+    # mtime=0 keeps the output, and with it the ETag, identical between builds.
+    compressed = gzip.compress(html, compresslevel=9, mtime=0)
+    etag = hashlib.sha1(compressed).hexdigest()[:16]
+
+    lines = [
+        "// Generated by scripts/embed_web.py from %s - do not edit." % os.path.basename(source),
+        "",
+        "#ifndef WEBPAGE_H",
+        "#define WEBPAGE_H",
+        "",
+        "#include <pgmspace.h>",
+        "",
+        "#define WEB_PAGE_ETAG \"\\\"%s\\\"\"" % etag,
+        "#define WEB_PAGE_LENGTH %d" % len(compressed),
+        "#define WEB_PAGE_UNCOMPRESSED_LENGTH %d" % len(html),
+        "",
+        "static const uint8_t WEB_PAGE_GZ[WEB_PAGE_LENGTH] PROGMEM = {",
+    ]
+    for offset in range(0, len(compressed), 16):
+        chunk = compressed[offset:offset + 16]
+        lines.append("    " + ", ".join("0x%02x" % b for b in chunk) + ",")
+    lines += ["};", "", "#endif", ""]
+
+    content = "\n".join(lines)
+    os.makedirs(os.path.dirname(target), exist_ok=True)
+    # Only rewrite on change so an unchanged page does not trigger a rebuild.
+    if os.path.exists(target):
+        with open(target) as f:
+            if f.read() == content:
+                return len(html), len(compressed)
+    with open(target, "w") as f:
+        f.write(content)
+    return len(html), len(compressed)
+
+
+try:
+    Import("env")  # noqa: F821 - provided by PlatformIO
+except NameError:
+    env = None
+
+if env is not None:
+    generated = os.path.join(env.subst("$BUILD_DIR"), "generated")
+    source = os.path.join(env.subst("$PROJECT_DIR"), "web", "index.html")
+    size, compressed_size = generate(source, os.path.join(generated, "WebPage.h"))
+    print("Web page: %d bytes, %d bytes gzip" % (size, compressed_size))
+    env.Append(CPPPATH=[generated])
+elif __name__ == "__main__":
+    size, compressed_size = generate(sys.argv[1], sys.argv[2])
+    print("Web page: %d bytes, %d bytes gzip" % (size, compressed_size))
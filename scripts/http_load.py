@@ -0,0 +1,136 @@
+# This file is part of the SEVentilation to MQTT project.
+# Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+#
+# HTTP load test for the web interface: several clients request the
+# endpoints back to back on keep-alive connections, while others stall
+# (send half a request, or never read a response). Before and after, the
+# poll gap and ACK latency histograms are read from /metrics, so the output
+# shows how the serial side fared under the load.
+#
+#   python scripts/http_load.py --host 192.168.1.50 --port 80 --seconds 30
+#   python scripts/http_load.py --port 8080 --clients 4 --stalled 2   # Linux gateway
+
+import argparse
+import http.client
+import re
+import socket
+import threading
+import time
+
+PATHS = ["/levels", "/stats", "/metrics", "/trace", "/scan", "/"]
+SERIES = re.compile(r'^(seventilation_(?:poll_gap|ack_latency)_seconds)_(bucket|sum|count)\{unit="([^"]+)"(?:,le="([^"]+)")?\} (\S+)$')
+
+
+def read_metrics(host, port):
+    connection = http.client.HTTPConnection(host, port, timeout=10)
+    connection.request("GET", "/metrics")
+    text = connection.getresponse().read().decode()
+    connection.close()
+    series = {}
+    for line in text.splitlines():
+        match = SERIES.match(line)
+        if not match:
+            continue
+        name, kind, unit, bound, value = match.groups()
+        entry = series.setdefault((name, unit), {"buckets": {}})
+        if kind == "bucket":
+            entry["buckets"][bound] = float(value)
+        else:
+            entry[kind] = float(value)
+    return series
+
+
+def summarize(before, after):
+    for key in sorted(after):
+        name, unit = key
+        first = before.get(key, {"buckets": {}, "sum": 0, "count": 0})
+        last = after[key]
+        count = last["count"] - first["count"]
+        if count <= 0:
+            continue
+        mean = (last["sum"] - first["sum"]) / count
+        # Smallest bound that holds 99% and 100% of the observations during the run.
+        bounds = sorted(last["buckets"], key=lambda b: float("inf") if b == "+Inf" else float(b))
+        p99 = highest = "+Inf"
+        for bound in bounds:
+            within = last["buckets"][bound] - first["buckets"].get(bound, 0)
+            if p99 == "+Inf" and within >= 0.99 * count:
+                p99 = bound
+            if highest == "+Inf" and within >= count:
+                highest = bound
+        print("  %-36s %-12s %8d samples, mean %7.3f ms, p99 <= %s s, max <= %s s" %
+              (name, unit, count, mean * 1000, p99, highest))
+
+
+def hammer(host, port, deadline, stats, lock):
+    connection = None
+    index = 0
+    while time.time() < deadline:
+        path = PATHS[index % len(PATHS)]
+        index += 1
+        start = time.time()
+        try:
+            if connection is None:
+                connection = http.client.HTTPConnection(host, port, timeout=10)
+            connection.request("GET", path, headers={"Accept-Encoding": "gzip"})
+            response = connection.getresponse()
+            response.read()
+            ok = response.status in (200, 304)
+            if response.getheader("Connection", "").lower() == "close":
+                connection.close()
+                connection = None
+        except (OSError, http.client.HTTPException):
+            ok = False
+            connection = None
+        with lock:
+            stats["requests"] += 1
+            stats["errors"] += 0 if ok else 1
+            stats["slowest"] = max(stats["slowest"], time.time() - start)
+
+
+def stall(host, port, deadline, reading):
+    # Half a request that never completes, or a request whose answer is never read.
+    while time.time() < deadline:
+        try:
+            sock = socket.create_connection((host, port), timeout=10)
+            if reading:
+                sock.sendall(b"GET /levels HTTP/1.1\r\nHost: x\r\n")
+            else:
+                sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1024)
+                sock.sendall(b"GET /trace HTTP/1.1\r\nHost: x\r\n\r\n")
+            time.sleep(min(4, max(0, deadline - time.time())))
+            sock.close()
+        except OSError:
+            time.sleep(0.1)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--host", default="127.0.0.1")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--seconds", type=float, default=20)
+    parser.add_argument("--clients", type=int, default=4, help="keep-alive clients requesting back to back")
+    parser.add_argument("--stalled", type=int, default=1, help="clients with half a request and clients not reading, each")
+    args = parser.parse_args()
+
+    before = read_metrics(args.host, args.port)
+    deadline = time.time() + args.seconds
+    stats = {"requests": 0, "errors": 0, "slowest": 0.0}
+    lock = threading.Lock()
+    threads = [threading.Thread(target=hammer, args=(args.host, args.port, deadline, stats, lock)) for _ in range(args.clients)]
+    for reading in (True, False):
+        threads += [threading.Thread(target=stall, args=(args.host, args.port, deadline, reading)) for _ in range(args.stalled)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    after = read_metrics(args.host, args.port)
+
+    print("%d clients, %d stalled: %d requests in %.0f s (%.0f/s), %d errors, slowest %.0f ms" %
+          (args.clients, 2 * args.stalled, stats["requests"], args.seconds, stats["requests"] / args.seconds,
+           stats["errors"], stats["slowest"] * 1000))
+    summarize(before, after)
+
+
+if __name__ == "__main__":
+    main()
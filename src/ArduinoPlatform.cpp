@@ -0,0 +1,62 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "ArduinoPlatform.h"
+#include <LittleFS.h>
+
+unsigned long ArduinoClock::Millis()
+{
+    return millis();
+}
+
+unsigned long ArduinoClock::Micros()
+{
+    return micros();
+}
+
+SoftwareSerialTransport::SoftwareSerialTransport(uint8_t rxPin, uint8_t txPin, unsigned long baud) : Port(rxPin, txPin)
+{
+    Port.begin(baud);
+}
+
+int SoftwareSerialTransport::Available()
+{
+    return Port.available();
+}
+
+int SoftwareSerialTransport::Read()
+{
+    return Port.read();
+}
+
+size_t SoftwareSerialTransport::Write(const uint8_t *buffer, size_t length)
+{
+    return Port.write(buffer, length);
+}
+
+LittleFSStorage::LittleFSStorage(const char *path)
+{
+    strncpy(Path, path, sizeof(Path) - 1);
+    Path[sizeof(Path) - 1] = '\0';
+}
+
+size_t LittleFSStorage::Load(uint8_t *buffer, size_t size)
+{
+    File file = LittleFS.open(Path, "r");
+    if (!file) return 0;
+    size_t length = file.read(buffer, size);
+    file.close();
+    return length;
+}
+
+bool LittleFSStorage::Save(const uint8_t *buffer, size_t length)
+{
+    // LittleFS commits the new content on close; a power loss before keeps the old file.
+    File file = LittleFS.open(Path, "w");
+    if (!file) return false;
+    size_t written = file.write(buffer, length);
+    file.close();
+    return written == length;
+}
@@ -0,0 +1,173 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "ConnectionManager.h"
+#include <ESP8266WiFi.h>
+#include "Logging.h"
+
+ConnectionManager::ConnectionManager(const char *hostname, const char *ssid, const char *password)
+    : Hostname(hostname), Ssid(ssid), Password(password),
+      WiFiBackoff(WIFI_BACKOFF_MIN_MILLIS, WIFI_BACKOFF_MAX_MILLIS, ESP.getChipId() ^ micros())
+{
+    memset(&WiFiStats, 0, sizeof(WiFiStats));
+    WiFiStats.DownSinceMillis = millis();
+}
+
+ConnectionManager::MqttLink::MqttLink(MqttBridge *bridge, uint32_t seed)
+    : Bridge(bridge), State(CONNECTION_DOWN), Backoff(MQTT_BACKOFF_MIN_MILLIS, MQTT_BACKOFF_MAX_MILLIS, seed)
+{
+    memset(&Stats, 0, sizeof(Stats));
+    Stats.DownSinceMillis = millis();
+}
+
+bool ConnectionManager::AddMqttBridge(MqttBridge *mqtt)
+{
+    if (MqttCount >= CONNECTION_MAX_MQTT_BRIDGES) return false;
+    Mqtt[MqttCount] = new MqttLink(mqtt, ESP.getChipId() ^ (micros() << 7) ^ MqttCount);
+    MqttCount++;
+    return true;
+}
+
+unsigned long ConnectionManager::GetDownMillis(const ConnectionStats &stats, bool isUp) const
+{
+    return stats.DownMillis + (isUp ? 0 : millis() - stats.DownSinceMillis);
+}
+
+void ConnectionManager::SetWiFiState(ConnectionState state, unsigned long nowMillis)
+{
+    if (state == CONNECTION_UP)
+    {
+        WiFiStats.Connects++;
+        WiFiStats.DownMillis += nowMillis - WiFiStats.DownSinceMillis;
+        WiFiBackoff.Reset(nowMillis);
+        LOG_INFO("WiFi connected after %lu attempts", WiFiStats.Attempts);
+    }
+    else if (state == CONNECTION_DOWN && WiFiState == CONNECTION_UP)
+    {
+        WiFiStats.Disconnects++;
+        WiFiStats.DownSinceMillis = nowMillis;
+        LOG_WARN("WiFi disconnected");
+    }
+    WiFiState = state;
+}
+
+void ConnectionManager::SetMqttState(uint8_t bridge, ConnectionState state, unsigned long nowMillis)
+{
+    MqttLink &link = *Mqtt[bridge];
+    if (state == CONNECTION_UP)
+    {
+        link.Stats.Connects++;
+        link.Stats.DownMillis += nowMillis - link.Stats.DownSinceMillis;
+        link.Backoff.Reset(nowMillis);
+        LOG_INFO("MQTT %u connected", bridge);
+    }
+    else if (state == CONNECTION_DOWN && link.State == CONNECTION_UP)
+    {
+        link.Stats.Disconnects++;
+        link.Stats.DownSinceMillis = nowMillis;
+        LOG_WARN("MQTT %u connection lost", bridge);
+    }
+    link.State = state;
+}
+
+void ConnectionManager::PollWiFi(unsigned long nowMillis)
+{
+    wl_status_t status = WiFi.status();
+
+    switch (WiFiState)
+    {
+    case CONNECTION_DOWN:
+        if (!WiFiBackoff.IsDue(nowMillis)) break;
+        WiFiStats.Attempts++;
+        WiFiAttemptMillis = nowMillis;
+        // Both calls only start the association and return immediately.
+        if (!WiFiStarted)
+        {
+            WiFi.mode(WIFI_STA);
+            WiFi.setAutoReconnect(false);
+            WiFi.hostname(Hostname);
+            WiFi.begin(Ssid, Password);
+            WiFiStarted = true;
+        }
+        else
+        {
+            WiFi.reconnect();
+        }
+        SetWiFiState(CONNECTION_CONNECTING, nowMillis);
+        break;
+
+    case CONNECTION_CONNECTING:
+        if (status == WL_CONNECTED)
+        {
+            SetWiFiState(CONNECTION_UP, nowMillis);
+        }
+        else if (status == WL_CONNECT_FAILED || status == WL_NO_SSID_AVAIL || status == WL_WRONG_PASSWORD ||
+                 nowMillis - WiFiAttemptMillis > WIFI_CONNECT_TIMEOUT_MILLIS)
+        {
+            WiFiBackoff.Fail(nowMillis);
+            LOG_WARN("WiFi connect failed (status %d), next attempt in about %lu ms", status, WiFiBackoff.GetDelayMillis());
+            SetWiFiState(CONNECTION_DOWN, nowMillis);
+        }
+        break;
+
+    case CONNECTION_UP:
+        if (status != WL_CONNECTED)
+        {
+            SetWiFiState(CONNECTION_DOWN, nowMillis);
+        }
+        break;
+    }
+}
+
+void ConnectionManager::PollMqtt(unsigned long nowMillis)
+{
+    bool attempted = false;
+    for (uint8_t bridge = 0; bridge < MqttCount; bridge++)
+    {
+        MqttLink &link = *Mqtt[bridge];
+        if (WiFiState != CONNECTION_UP)
+        {
+            SetMqttState(bridge, CONNECTION_DOWN, nowMillis);
+            continue;
+        }
+
+        if (link.State == CONNECTION_UP)
+        {
+            if (!link.Bridge->IsConnected()) SetMqttState(bridge, CONNECTION_DOWN, nowMillis);
+            continue;
+        }
+
+        // Connecting is the only part that waits on the network, once per MqttConnectStep and for
+        // MQTT_CONNECT_TIMEOUT_MILLIS at most. One step per call keeps the loop short however many
+        // bridges are down.
+        if (attempted) continue;
+        if (link.State == CONNECTION_DOWN)
+        {
+            if (!link.Backoff.IsDue(nowMillis)) continue;
+            link.Stats.Attempts++;
+            link.Bridge->BeginConnect();
+            SetMqttState(bridge, CONNECTION_CONNECTING, nowMillis);
+        }
+        attempted = true;
+        MqttConnectResult result = link.Bridge->ConnectStep();
+        if (result == MQTT_CONNECT_DONE)
+        {
+            SetMqttState(bridge, CONNECTION_UP, millis());
+        }
+        else if (result == MQTT_CONNECT_FAILED)
+        {
+            link.Backoff.Fail(millis());
+            LOG_WARN("MQTT %u connect failed, next attempt in about %lu ms", bridge, link.Backoff.GetDelayMillis());
+            SetMqttState(bridge, CONNECTION_DOWN, millis());
+        }
+    }
+}
+
+void ConnectionManager::Poll()
+{
+    unsigned long nowMillis = millis();
+    PollWiFi(nowMillis);
+    PollMqtt(nowMillis);
+}
@@ -0,0 +1,94 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "HardwareUartTransport.h"
+#include <esp8266_peri.h>
+
+#define UART_NR 0
+#define UART_TX_FIFO_SIZE 128
+
+void IRAM_ATTR HardwareUartTransport::HandleInterrupt(void *arg, void *frame)
+{
+    // The interrupt vector is shared with UART1, which only ever transmits.
+    uint32_t status = USIS(UART_NR);
+    if (status == 0) return;
+
+    HardwareUartTransport *transport = (HardwareUartTransport *)arg;
+    while ((USS(UART_NR) >> USRXC) & 0xFF)
+    {
+        transport->RxBuffer.Push((uint8_t)USF(UART_NR));
+    }
+
+    if (status & (1 << UIOF))
+    {
+        transport->FifoOverflows = transport->FifoOverflows + 1;
+    }
+    USIC(UART_NR) = status;
+}
+
+HardwareUartTransport::HardwareUartTransport(unsigned long baud)
+{
+    ETS_UART_INTR_DISABLE();
+
+    USD(UART_NR) = ESP8266_CLOCK / baud;
+    USC0(UART_NR) = SERIAL_8N1;
+    USC0(UART_NR) |= (1 << UCRXRST) | (1 << UCTXRST);
+    USC0(UART_NR) &= ~((1 << UCRXRST) | (1 << UCTXRST));
+
+    pinMode(15, FUNCTION_4); // U0TXD
+    pinMode(13, FUNCTION_4); // U0RXD
+    IOSWAP |= (1 << IOSWAPU0);
+
+    // Interrupt once 16 bytes are waiting or the line went idle for two byte
+    // times, so short frames such as ACKs are delivered without delay.
+    USC1(UART_NR) = (HARDWARE_UART_RX_FIFO_THRESHOLD << UCFFT) | (HARDWARE_UART_RX_TIMEOUT_BYTES << UCTOT) | (1 << UCTOE);
+    USIC(UART_NR) = 0xFFFF;
+    USIE(UART_NR) = (1 << UIFF) | (1 << UITO) | (1 << UIOF);
+
+    ETS_UART_INTR_ATTACH(HandleInterrupt, this);
+    ETS_UART_INTR_ENABLE();
+}
+
+HardwareUartTransport::~HardwareUartTransport()
+{
+    ETS_UART_INTR_DISABLE();
+    USIE(UART_NR) = 0;
+    USIC(UART_NR) = 0xFFFF;
+    ETS_UART_INTR_ATTACH(NULL, NULL);
+}
+
+int HardwareUartTransport::Available()
+{
+    return (int)RxBuffer.Available();
+}
+
+int HardwareUartTransport::Read()
+{
+    return RxBuffer.Pop();
+}
+
+size_t HardwareUartTransport::ReadBytes(uint8_t *buffer, size_t length)
+{
+    return RxBuffer.Pop(buffer, length);
+}
+
+size_t HardwareUartTransport::Write(const uint8_t *buffer, size_t length)
+{
+    // Frames are far shorter than the TX FIFO, so this only waits when the
+    // previous frame is still on the wire.
+    for (size_t i = 0; i < length; i++)
+    {
+        while (((USS(UART_NR) >> USTXC) & 0xFF) >= UART_TX_FIFO_SIZE - 1)
+        {
+        }
+        USF(UART_NR) = buffer[i];
+    }
+    return length;
+}
+
+uint32_t HardwareUartTransport::DroppedBytes() const
+{
+    return RxBuffer.Overflows + FifoOverflows;
+}
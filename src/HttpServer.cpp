@@ -0,0 +1,689 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "HttpServer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "Logging.h"
+
+// Room for the size line in front of a chunk: up to four hex digits and CRLF.
+#define HTTP_CHUNK_HEAD_LENGTH 6
+// CRLF after the chunk and the closing "0\r\n\r\n".
+#define HTTP_CHUNK_TAIL_LENGTH 7
+
+#define HTTP_LENGTH_CHUNKED -1
+#define HTTP_LENGTH_UNTIL_CLOSE -2
+
+static const char Busy[] = "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+static const char *StatusText(int code)
+{
+    switch (code)
+    {
+    case 200: return "OK";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 408: return "Request Timeout";
+    case 413: return "Payload Too Large";
+    case 414: return "URI Too Long";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default: return "";
+    }
+}
+
+static int HexValue(char c)
+{
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Form encoding: + is a space, %XX a byte.
+static bool UrlDecode(const char *text, size_t length, char *value, size_t size)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        if (count + 1 >= size) return false;
+        if (text[i] == '+') value[count++] = ' ';
+        else if (text[i] == '%' && i + 2 < length && HexValue(text[i + 1]) >= 0 && HexValue(text[i + 2]) >= 0)
+        {
+            value[count++] = (char)(HexValue(text[i + 1]) * 16 + HexValue(text[i + 2]));
+            i += 2;
+        }
+        else value[count++] = text[i];
+    }
+    if (size > 0) value[count] = '\0';
+    return size > 0;
+}
+
+HttpConnection::HttpConnection() : Writer(Output, sizeof(Output))
+{
+}
+
+void HttpConnection::Open(WiFiClient &client, const char *const *headerNames, uint8_t headerCount)
+{
+    Client = client;
+    Client.setNoDelay(true);
+    HeaderNames = headerNames;
+    HeaderCount = headerCount;
+    Requests = 0;
+    StartRequest();
+}
+
+void HttpConnection::StartRequest()
+{
+    State = HTTP_STATE_HEAD;
+    Method = HTTP_METHOD_OTHER;
+    Http11 = false;
+    KeepAlive = false;
+    Skipping = false;
+    FormBody = false;
+    RequestLine = true;
+    RequestLength = 0;
+    LineLength = 0;
+    QueryOffset = 0;
+    BodyOffset = 0;
+    BodyLength = 0;
+    ContentLength = 0;
+    for (uint8_t i = 0; i < HTTP_HEADERS_MAX; i++) HeaderOffsets[i] = 0;
+
+    OutputStart = 0;
+    OutputEnd = 0;
+    Body = HTTP_BODY_BUFFERED;
+    Chunked = false;
+    BodyDone = true;
+    Broken = false;
+    Flash = NULL;
+    FlashRemaining = 0;
+    Items = nullptr;
+    Item = 0;
+    WriterOpen = false;
+    StartMillis = millis();
+}
+
+bool HttpConnection::IsIdle() const
+{
+    return State == HTTP_STATE_HEAD && RequestLine && RequestLength == 0 && LineLength == 0 && !Skipping;
+}
+
+// One line of the head without its line break, at Request + RequestLength.
+void HttpConnection::ReadLine(char *line, size_t length)
+{
+    line[length] = '\0';
+    if (RequestLine)
+    {
+        if (length == 0) return; // blank lines before a request are allowed
+
+        // <method> <target> HTTP/1.x
+        char *target = strchr(line, ' ');
+        char *version = target != NULL ? strchr(target + 1, ' ') : NULL;
+        if (version == NULL || strncmp(version + 1, "HTTP/1.", 7) != 0)
+        {
+            Fail(400);
+            return;
+        }
+        *target++ = '\0';
+        *version++ = '\0';
+        if (strcmp(line, "GET") == 0) Method = HTTP_METHOD_GET;
+        else if (strcmp(line, "POST") == 0) Method = HTTP_METHOD_POST;
+        Http11 = strcmp(version, "HTTP/1.0") != 0;
+        KeepAlive = Http11;
+
+        size_t targetLength = strlen(target);
+        memmove(Request, target, targetLength + 1);
+        char *query = strchr(Request, '?');
+        if (query != NULL)
+        {
+            *query = '\0';
+            QueryOffset = query + 1 - Request;
+        }
+        RequestLength = targetLength + 1;
+        RequestLine = false;
+        return;
+    }
+
+    if (length == 0)
+    {
+        // End of the head; a body has to fit behind the stored fields.
+        if (ContentLength == 0)
+        {
+            State = HTTP_STATE_RESPONSE;
+            return;
+        }
+        if (RequestLength + ContentLength + 1 > HTTP_REQUEST_LENGTH)
+        {
+            Fail(413);
+            return;
+        }
+        BodyOffset = RequestLength;
+        State = HTTP_STATE_BODY;
+        return;
+    }
+
+    char *colon = strchr(line, ':');
+    if (colon == NULL) return;
+    *colon = '\0';
+    const char *value = colon + 1;
+    while (*value == ' ' || *value == '\t') value++;
+
+    if (strcasecmp(line, "Content-Length") == 0)
+    {
+        unsigned long contentLength = strtoul(value, NULL, 10);
+        ContentLength = contentLength < HTTP_REQUEST_LENGTH ? contentLength : HTTP_REQUEST_LENGTH;
+    }
+    else if (strcasecmp(line, "Connection") == 0)
+    {
+        if (strcasecmp(value, "close") == 0) KeepAlive = false;
+        else if (strcasecmp(value, "keep-alive") == 0) KeepAlive = true;
+    }
+    else if (strcasecmp(line, "Content-Type") == 0)
+    {
+        FormBody = strncasecmp(value, "application/x-www-form-urlencoded", 33) == 0;
+    }
+
+    for (uint8_t i = 0; i < HeaderCount; i++)
+    {
+        if (strcasecmp(line, HeaderNames[i]) != 0) continue;
+        size_t valueLength = strlen(value);
+        memmove(line, value, valueLength + 1);
+        HeaderOffsets[i] = RequestLength;
+        RequestLength += valueLength + 1;
+        break;
+    }
+}
+
+bool HttpConnection::Read()
+{
+    uint8_t chunk[64];
+    size_t budget = HTTP_READ_PER_POLL;
+    while (budget > 0 && (State == HTTP_STATE_HEAD || State == HTTP_STATE_BODY))
+    {
+        int available = Client.available();
+        if (available <= 0) return false;
+        size_t wanted = (size_t)available < sizeof(chunk) ? available : sizeof(chunk);
+        if (wanted > budget) wanted = budget;
+        bool idle = IsIdle();
+        int count = Client.read(chunk, wanted);
+        if (count <= 0) return false;
+        budget -= count;
+        // The request timeout runs from its first byte.
+        if (idle) StartMillis = millis();
+
+        for (int i = 0; i < count; i++)
+        {
+            char c = (char)chunk[i];
+            if (State == HTTP_STATE_BODY)
+            {
+                Request[BodyOffset + BodyLength++] = c;
+                if (BodyLength < ContentLength) continue;
+                Request[BodyOffset + BodyLength] = '\0';
+                State = HTTP_STATE_RESPONSE;
+            }
+            else if (c == '\n')
+            {
+                if (Skipping) Skipping = false;
+                else ReadLine(Request + RequestLength, LineLength);
+                LineLength = 0;
+            }
+            else if (c == '\r' || Skipping)
+            {
+                continue;
+            }
+            else if (RequestLength + LineLength + 1 < HTTP_REQUEST_LENGTH)
+            {
+                Request[RequestLength + LineLength++] = c;
+                continue;
+            }
+            else if (RequestLine)
+            {
+                Fail(414);
+            }
+            else
+            {
+                // A header we cannot keep, e.g. a long cookie; only its name would matter.
+                Skipping = true;
+                LineLength = 0;
+                continue;
+            }
+
+            if (State == HTTP_STATE_RESPONSE)
+            {
+                // Bytes of a pipelined request would be lost; the client has to reconnect.
+                if (i + 1 < count || Client.available() > 0) KeepAlive = false;
+                return OutputEnd == 0;
+            }
+        }
+    }
+    return false;
+}
+
+const char *HttpConnection::FindArg(const char *text, const char *name) const
+{
+    size_t nameLength = strlen(name);
+    while (*text != '\0')
+    {
+        size_t pairLength = strcspn(text, "&");
+        if (pairLength >= nameLength && strncmp(text, name, nameLength) == 0 &&
+            (text[nameLength] == '=' || text[nameLength] == '&' || text[nameLength] == '\0'))
+        {
+            return text[nameLength] == '=' ? text + nameLength + 1 : text + nameLength;
+        }
+        text += pairLength;
+        if (*text == '&') text++;
+    }
+    return NULL;
+}
+
+bool HttpConnection::HasArg(const char *name) const
+{
+    if (QueryOffset != 0 && FindArg(Request + QueryOffset, name) != NULL) return true;
+    return FormBody && BodyOffset != 0 && FindArg(Request + BodyOffset, name) != NULL;
+}
+
+bool HttpConnection::GetArg(const char *name, char *value, size_t size) const
+{
+    const char *found = QueryOffset != 0 ? FindArg(Request + QueryOffset, name) : NULL;
+    if (found == NULL && FormBody && BodyOffset != 0) found = FindArg(Request + BodyOffset, name);
+    if (found == NULL) return false;
+    return UrlDecode(found, strcspn(found, "&"), value, size);
+}
+
+long HttpConnection::GetArgNumber(const char *name) const
+{
+    char value[16];
+    return GetArg(name, value, sizeof(value)) ? atol(value) : 0;
+}
+
+const char *HttpConnection::GetHeader(const char *name) const
+{
+    for (uint8_t i = 0; i < HeaderCount; i++)
+    {
+        if (strcasecmp(HeaderNames[i], name) == 0) return HeaderOffsets[i] != 0 ? Request + HeaderOffsets[i] : "";
+    }
+    return "";
+}
+
+bool HttpConnection::WriteHead(int code, const char *contentType, long contentLength, const char *headers)
+{
+    JsonWriter head(Output, sizeof(Output));
+    head.Printf("HTTP/1.1 %d %s\r\n", code, StatusText(code));
+    if (contentType != NULL) head.Printf("Content-Type: %s\r\n", contentType);
+    if (contentLength >= 0)
+    {
+        if (code != 304) head.Printf("Content-Length: %ld\r\n", contentLength);
+    }
+    else if (contentLength == HTTP_LENGTH_CHUNKED && Http11)
+    {
+        head.Raw("Transfer-Encoding: chunked\r\n");
+        Chunked = true;
+    }
+    else
+    {
+        // The end of the body is the end of the connection.
+        KeepAlive = false;
+    }
+    head.Raw(KeepAlive ? "Connection: keep-alive\r\n" : "Connection: close\r\n");
+    if (headers != NULL) head.Raw(headers);
+    head.Raw("\r\n");
+
+    OutputStart = 0;
+    OutputEnd = head.GetLength();
+    ProgressMillis = millis();
+    ResponseMicros = micros();
+    State = HTTP_STATE_RESPONSE;
+    return !head.HasOverflowed();
+}
+
+void HttpConnection::Fail(int code)
+{
+    KeepAlive = false;
+    Send(code, "text/plain", StatusText(code));
+}
+
+void HttpConnection::Send(int code, const char *contentType, const char *body, const char *headers)
+{
+    size_t length = body != NULL ? strlen(body) : 0;
+    if (!WriteHead(code, contentType, length, headers) || OutputEnd + length > sizeof(Output))
+    {
+        LOG_ERROR("HTTP %s: response does not fit", GetPath());
+        KeepAlive = false;
+        WriteHead(500, NULL, 0, NULL);
+        return;
+    }
+    memcpy(Output + OutputEnd, body, length);
+    OutputEnd += length;
+}
+
+void HttpConnection::SendFlash(int code, const char *contentType, PGM_P body, size_t length, const char *headers)
+{
+    if (!WriteHead(code, contentType, length, headers))
+    {
+        Fail(500);
+        return;
+    }
+    Body = HTTP_BODY_FLASH;
+    Flash = body;
+    FlashRemaining = length;
+    BodyDone = length == 0;
+}
+
+void HttpConnection::SendItems(int code, const char *contentType, HttpItemWriter items)
+{
+    WriteHead(code, contentType, HTTP_LENGTH_CHUNKED, NULL);
+    Body = HTTP_BODY_ITEMS;
+    Items = items;
+    Item = 0;
+    BodyDone = false;
+}
+
+void HttpConnection::BeginEventStream()
+{
+    WriteHead(200, "text/event-stream", HTTP_LENGTH_UNTIL_CLOSE, "Cache-Control: no-cache\r\n");
+    State = HTTP_STATE_STREAM;
+}
+
+// Fills the drained output buffer with the next piece of the body.
+void HttpConnection::Refill()
+{
+    OutputStart = 0;
+    OutputEnd = 0;
+    if (Body == HTTP_BODY_FLASH)
+    {
+        size_t count = FlashRemaining < sizeof(Output) ? FlashRemaining : sizeof(Output);
+        memcpy_P(Output, Flash, count);
+        Flash += count;
+        FlashRemaining -= count;
+        OutputEnd = count;
+        BodyDone = FlashRemaining == 0;
+        return;
+    }
+    if (Body != HTTP_BODY_ITEMS)
+    {
+        BodyDone = true;
+        return;
+    }
+
+    // The writer keeps the JSON nesting from one piece to the next.
+    if (WriterOpen) Writer.Consume();
+    else Writer = JsonWriter(Output + HTTP_CHUNK_HEAD_LENGTH, sizeof(Output) - HTTP_CHUNK_HEAD_LENGTH - HTTP_CHUNK_TAIL_LENGTH);
+    WriterOpen = true;
+    while (true)
+    {
+        // An item that does not fit is taken back and written first into the next piece.
+        JsonWriter before = Writer;
+        bool more = Items(Writer, Item);
+        if (Writer.HasOverflowed())
+        {
+            Writer = before;
+            if (Writer.GetLength() == 0)
+            {
+                LOG_ERROR("HTTP %s: item %lu does not fit", GetPath(), (unsigned long)Item);
+                Broken = true;
+                return;
+            }
+            break;
+        }
+        if (!more)
+        {
+            BodyDone = true;
+            break;
+        }
+        Item++;
+    }
+
+    size_t length = Writer.GetLength();
+    OutputStart = HTTP_CHUNK_HEAD_LENGTH;
+    OutputEnd = HTTP_CHUNK_HEAD_LENGTH + length;
+    if (!Chunked) return;
+    if (length > 0)
+    {
+        char size[HTTP_CHUNK_HEAD_LENGTH + 1];
+        int sizeLength = snprintf(size, sizeof(size), "%x\r\n", (unsigned)length);
+        OutputStart -= sizeLength;
+        memcpy(Output + OutputStart, size, sizeLength);
+        memcpy(Output + OutputEnd, "\r\n", 2);
+        OutputEnd += 2;
+    }
+    if (BodyDone)
+    {
+        memcpy(Output + OutputEnd, "0\r\n\r\n", 5);
+        OutputEnd += 5;
+    }
+}
+
+bool HttpConnection::SendOutput()
+{
+    while (OutputStart < OutputEnd || !BodyDone)
+    {
+        if (OutputStart == OutputEnd)
+        {
+            Refill();
+            if (Broken) return false;
+            continue;
+        }
+        // Never more than the send buffer takes, so write() returns at once.
+        int room = Client.availableForWrite();
+        if (room <= 0) return true;
+        size_t count = OutputEnd - OutputStart;
+        if ((size_t)room < count) count = room;
+        size_t written = Client.write((const uint8_t *)Output + OutputStart, count);
+        if (written == 0) return Client.connected();
+        OutputStart += written;
+        ProgressMillis = millis();
+    }
+    return true;
+}
+
+HttpServer::HttpServer(int port) : Listener(port)
+{
+}
+
+void HttpServer::On(const char *path, HttpMethod method, Handler handler)
+{
+    if (RouteCount < HTTP_HANDLERS_MAX) Routes[RouteCount++] = Route{path, method, handler};
+}
+
+void HttpServer::CollectHeader(const char *name)
+{
+    if (HeaderCount < HTTP_HEADERS_MAX) HeaderNames[HeaderCount++] = name;
+}
+
+void HttpServer::Begin()
+{
+    Listener.begin();
+    Listener.setNoDelay(true);
+}
+
+void HttpServer::Accept(unsigned long nowMillis)
+{
+    if (!Listener.hasClient()) return;
+
+    HttpConnection *slot = NULL;
+    HttpConnection *idle = NULL;
+    for (size_t i = 0; i < HTTP_CONNECTIONS_MAX && slot == NULL; i++)
+    {
+        HttpConnection &connection = Connections[i];
+        if (connection.State == HTTP_STATE_FREE) slot = &connection;
+        else if (connection.IsIdle() && (idle == NULL || nowMillis - connection.StartMillis > nowMillis - idle->StartMillis)) idle = &connection;
+    }
+    if (slot == NULL && idle != NULL)
+    {
+        Close(*idle);
+        slot = idle;
+    }
+
+    WiFiClient client = Listener.accept();
+    if (!client) return;
+    if (slot == NULL)
+    {
+        Stats.Rejected++;
+        client.write((const uint8_t *)Busy, sizeof(Busy) - 1);
+        client.stop(HTTP_CLOSE_WAIT_MILLIS);
+        return;
+    }
+    slot->Open(client, HeaderNames, HeaderCount);
+    slot->FreeHeapAtAccept = ESP.getFreeHeap();
+    Stats.Accepted++;
+}
+
+void HttpServer::Dispatch(HttpConnection &connection)
+{
+    Stats.Requests++;
+    if (connection.Requests > 0) Stats.KeepAliveRequests++;
+    if (connection.Requests < 255) connection.Requests++;
+
+    const char *path = connection.GetPath();
+    for (uint8_t i = 0; i < RouteCount; i++)
+    {
+        const Route &route = Routes[i];
+        if (strcmp(path, route.Path) != 0 || (route.Method != HTTP_METHOD_ANY && route.Method != connection.Method)) continue;
+        route.Function(connection);
+        if (connection.OutputEnd == 0) connection.Send(500, "text/plain", "No response");
+        return;
+    }
+    connection.Send(404, "text/plain", "Not found");
+}
+
+void HttpServer::Close(HttpConnection &connection)
+{
+    connection.Client.stop(HTTP_CLOSE_WAIT_MILLIS);
+    connection.Client = WiFiClient();
+    connection.State = HTTP_STATE_FREE;
+    connection.Items = nullptr;
+    // The heap given back when the connection goes is what it cost.
+    uint32_t freeHeap = ESP.getFreeHeap();
+    if (freeHeap > connection.FreeHeapAtAccept) Stats.HeapPerConnection = freeHeap - connection.FreeHeapAtAccept;
+}
+
+void HttpServer::Service(HttpConnection &connection, unsigned long nowMillis)
+{
+    if (connection.State == HTTP_STATE_HEAD || connection.State == HTTP_STATE_BODY)
+    {
+        if (connection.Read())
+        {
+            Dispatch(connection);
+        }
+        else if (connection.State == HTTP_STATE_RESPONSE)
+        {
+            Stats.BadRequests++;
+        }
+        else if (!connection.Client.connected())
+        {
+            Close(connection);
+            return;
+        }
+        else if (connection.IsIdle())
+        {
+            if (nowMillis - connection.StartMillis >= HTTP_KEEPALIVE_MILLIS) Close(connection);
+            return;
+        }
+        else
+        {
+            if (nowMillis - connection.StartMillis < HTTP_REQUEST_TIMEOUT_MILLIS) return;
+            Stats.Timeouts++;
+            connection.Fail(408);
+        }
+    }
+
+    if (connection.State == HTTP_STATE_STREAM)
+    {
+        // Nothing is expected from the browser; whatever comes is dropped.
+        uint8_t discard[32];
+        while (connection.Client.available() > 0 && connection.Client.read(discard, sizeof(discard)) > 0) {}
+    }
+
+    if (!connection.SendOutput() || !connection.Client.connected())
+    {
+        if (connection.State == HTTP_STATE_STREAM) Stats.StreamsDropped++;
+        Close(connection);
+        return;
+    }
+    if (connection.OutputStart < connection.OutputEnd || !connection.BodyDone)
+    {
+        if (nowMillis - connection.ProgressMillis < HTTP_SEND_TIMEOUT_MILLIS) return;
+        Stats.Timeouts++;
+        if (connection.State == HTTP_STATE_STREAM) Stats.StreamsDropped++;
+        Close(connection);
+        return;
+    }
+    if (connection.State != HTTP_STATE_RESPONSE) return;
+
+    // Response complete.
+    uint32_t responseMicros = micros() - connection.ResponseMicros;
+    Stats.LastResponseMicros = responseMicros;
+    if (responseMicros > Stats.MaxResponseMicros) Stats.MaxResponseMicros = responseMicros;
+    if (connection.KeepAlive) connection.StartRequest();
+    else Close(connection);
+}
+
+void HttpServer::Poll()
+{
+    unsigned long nowMillis = millis();
+    Accept(nowMillis);
+    for (size_t i = 0; i < HTTP_CONNECTIONS_MAX; i++)
+    {
+        if (Connections[i].State != HTTP_STATE_FREE) Service(Connections[i], nowMillis);
+    }
+}
+
+size_t HttpServer::Broadcast(const char *data, size_t length)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < HTTP_CONNECTIONS_MAX; i++)
+    {
+        HttpConnection &connection = Connections[i];
+        if (connection.State != HTTP_STATE_STREAM) continue;
+
+        size_t pending = connection.OutputEnd - connection.OutputStart;
+        if (pending == 0) connection.ProgressMillis = millis();
+        memmove(connection.Output, connection.Output + connection.OutputStart, pending);
+        connection.OutputStart = 0;
+        connection.OutputEnd = pending;
+        // A browser that cannot take the event is dropped; it reconnects and
+        // rebuilds the page from /levels.
+        if (pending + length > sizeof(connection.Output))
+        {
+            Stats.StreamsDropped++;
+            Close(connection);
+            continue;
+        }
+        memcpy(connection.Output + pending, data, length);
+        connection.OutputEnd += length;
+        if (!connection.SendOutput())
+        {
+            Stats.StreamsDropped++;
+            Close(connection);
+            continue;
+        }
+        count++;
+    }
+    return count;
+}
+
+size_t HttpServer::GetConnectionCount() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < HTTP_CONNECTIONS_MAX; i++)
+    {
+        if (Connections[i].State != HTTP_STATE_FREE) count++;
+    }
+    return count;
+}
+
+size_t HttpServer::GetStreamCount() const
+{
+    size_t count = 0;
+    for (size_t i = 0; i < HTTP_CONNECTIONS_MAX; i++)
+    {
+        if (Connections[i].State == HTTP_STATE_STREAM) count++;
+    }
+    return count;
+}
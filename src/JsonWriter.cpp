@@ -0,0 +1,238 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "JsonWriter.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+JsonWriter::JsonWriter(char *buffer, size_t size, JsonSink *sink)
+{
+    Buffer = buffer;
+    Size = size;
+    Sink = sink;
+    if (Size > 0) Buffer[0] = '\0';
+}
+
+void JsonWriter::Reset()
+{
+    Length = 0;
+    Overflowed = false;
+    Depth = 0;
+    HasElements = 0;
+    AfterKey = false;
+    if (Size > 0) Buffer[0] = '\0';
+}
+
+void JsonWriter::Consume()
+{
+    Length = 0;
+    Overflowed = false;
+    if (Size > 0) Buffer[0] = '\0';
+}
+
+void JsonWriter::Flush()
+{
+    if (Sink != NULL && Length > 0)
+    {
+        Sink->Write(Buffer, Length);
+        Length = 0;
+    }
+    if (Size > 0) Buffer[Length] = '\0';
+}
+
+void JsonWriter::Put(char c)
+{
+    // One byte stays free for the terminating NUL.
+    if (Length + 1 >= Size)
+    {
+        if (Sink == NULL || Size < 2)
+        {
+            Overflowed = true;
+            return;
+        }
+        Flush();
+    }
+    Buffer[Length++] = c;
+    Buffer[Length] = '\0';
+}
+
+void JsonWriter::Put(const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        size_t space = Size > Length + 1 ? Size - Length - 1 : 0;
+        if (space == 0)
+        {
+            if (Sink == NULL || Size < 2)
+            {
+                Overflowed = true;
+                return;
+            }
+            Flush();
+            continue;
+        }
+        size_t count = length < space ? length : space;
+        memcpy(Buffer + Length, data, count);
+        Length += count;
+        Buffer[Length] = '\0';
+        data += count;
+        length -= count;
+    }
+}
+
+void JsonWriter::Separator()
+{
+    if (AfterKey)
+    {
+        AfterKey = false;
+        return;
+    }
+    if (Depth == 0) return;
+
+    uint16_t bit = 1 << (Depth - 1);
+    if (HasElements & bit) Put(',');
+    HasElements |= bit;
+}
+
+void JsonWriter::Open(char c)
+{
+    Separator();
+    Put(c);
+    if (Depth < JSONWRITER_MAX_DEPTH)
+    {
+        Depth++;
+        HasElements &= ~(1 << (Depth - 1));
+    }
+}
+
+void JsonWriter::Close(char c)
+{
+    if (Depth > 0) Depth--;
+    Put(c);
+}
+
+void JsonWriter::Escaped(const char *value)
+{
+    Put('"');
+    const char *run = value;
+    for (const char *p = value; *p != '\0'; p++)
+    {
+        unsigned char c = (unsigned char)*p;
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        Put(run, p - run);
+        run = p + 1;
+        switch (c)
+        {
+        case '"': Put("\\\"", 2); break;
+        case '\\': Put("\\\\", 2); break;
+        case '\b': Put("\\b", 2); break;
+        case '\f': Put("\\f", 2); break;
+        case '\n': Put("\\n", 2); break;
+        case '\r': Put("\\r", 2); break;
+        case '\t': Put("\\t", 2); break;
+        default:
+        {
+            char escape[7];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            Put(escape, 6);
+        }
+        }
+    }
+    Put(run, strlen(run));
+    Put('"');
+}
+
+JsonWriter &JsonWriter::Key(const char *key)
+{
+    Separator();
+    Escaped(key);
+    Put(':');
+    AfterKey = true;
+    return *this;
+}
+
+JsonWriter &JsonWriter::Value(const char *value)
+{
+    Separator();
+    if (value == NULL)
+    {
+        Put("null", 4);
+    }
+    else
+    {
+        Escaped(value);
+    }
+    return *this;
+}
+
+JsonWriter &JsonWriter::Value(long value)
+{
+    char number[24];
+    Separator();
+    Put(number, snprintf(number, sizeof(number), "%ld", value));
+    return *this;
+}
+
+JsonWriter &JsonWriter::Value(unsigned long value)
+{
+    char number[24];
+    Separator();
+    Put(number, snprintf(number, sizeof(number), "%lu", value));
+    return *this;
+}
+
+JsonWriter &JsonWriter::Value(double value, uint8_t decimals)
+{
+    char number[32];
+    Separator();
+    int length = snprintf(number, sizeof(number), "%.*f", decimals, value);
+    Put(number, length < (int)sizeof(number) ? length : sizeof(number) - 1);
+    return *this;
+}
+
+JsonWriter &JsonWriter::Bool(bool value)
+{
+    Separator();
+    if (value)
+    {
+        Put("true", 4);
+    }
+    else
+    {
+        Put("false", 5);
+    }
+    return *this;
+}
+
+JsonWriter &JsonWriter::Raw(const char *text)
+{
+    Put(text, strlen(text));
+    return *this;
+}
+
+JsonWriter &JsonWriter::Printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    VPrintf(format, args);
+    va_end(args);
+    return *this;
+}
+
+JsonWriter &JsonWriter::VPrintf(const char *format, va_list args)
+{
+    char text[128];
+    int length = vsnprintf(text, sizeof(text), format, args);
+    if (length < 0) return *this;
+    if (length >= (int)sizeof(text))
+    {
+        length = sizeof(text) - 1;
+        Overflowed = true;
+    }
+    Put(text, length);
+    return *this;
+}
@@ -4,7 +4,25 @@
 */
 
 #include "Logging.h"
+#include <stdarg.h>
+#include <stdio.h>
 
-void Log(const String& message)
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+void LogFormat(const char* format, ...)
 {
+    char line[LOG_LINE_LENGTH];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+
+#ifdef ARDUINO
+    Serial1.println(line);
+#else
+    fputs(line, stderr);
+    fputc('\n', stderr);
+#endif
 }
@@ -4,77 +4,504 @@
 */
 
 #include "MqttBridge.h"
+#include <ctype.h>
 #include <ESP8266WiFi.h>
 #include <MQTT.h>
+#include "JsonWriter.h"
 #include "Logging.h"
 
-#define AREA_LEVEL_START 173
-#define AREA_LEVEL_END 178
+// Topics below the configurable prefix (default "airsystem"), see SETopicRouter.h:
+//   set/<name>    command for a register, "<value>" or "<value>:<id>"; area levels are clamped to 0-6
+//   state/<name>  retained value of a register
+//   ack/<name>    outcome of every command, {"id":...,"level":...,"result":...,"ms":...}
+//   state         retained snapshot of all known fan levels in one message, {"area-1":2,...}
+//   availability  retained, "online" while connected, "offline" as last will
+// Discovery: publish "first-last" (e.g. "0-255") to scan/set to start a continuous scan, "stop" to end it.
+// Trace: "dump" to trace/set publishes the trace to <prefix>/trace in several messages followed by "end";
+// "arm", "resume" and "clear" as described in SETrace.h.
 
-const char* AreaListSet[] = {"airsystem/set/area-1", "airsystem/set/area-2", "airsystem/set/area-3", "airsystem/set/area-4", "airsystem/set/area-5", "airsystem/set/area-6"};
-const char* AreaListState[] = {"airsystem/state/area-1", "airsystem/state/area-2", "airsystem/state/area-3", "airsystem/state/area-4", "airsystem/state/area-5", "airsystem/state/area-6"};
+// Home Assistant announces a restart here; discovery and state are then sent again.
+const char* HomeAssistantStatus = "homeassistant/status";
+const char* DiscoveryPrefix = "homeassistant/fan/";
 
-WiFiClient net;
+#define SCAN_STATUS_INTERVAL_MILLIS 10000
 
-MqttBridge::MqttBridge(const char hostname[], int port, SEController *sec) : Client(256)
+MqttBridge::MqttBridge(const char hostname[], int port, SEController *sec, SECommandArbiter *arbiter) : Topics(MQTT_DEFAULT_TOPIC_PREFIX), Tracker(sec, &Clock), Client(MQTT_BUFFER_LENGTH)
 {
     SEC = sec;
-    Client.begin(hostname, port, net);
-    ConnectToMQTT();
+    Arbiter = arbiter;
+    Source = Arbiter->AddSource("mqtt", MQTT_SOURCE_PRECEDENCE);
+    Hostname = hostname;
+    Port = port;
+    SetClientId(MQTT_DEFAULT_CLIENT_ID);
+    Net.setTimeout(MQTT_CONNECT_TIMEOUT_MILLIS);
+    Client.setTimeout(MQTT_CONNECT_TIMEOUT_MILLIS);
+    Client.begin(hostname, port, Net);
+    SetTopicPrefix(MQTT_DEFAULT_TOPIC_PREFIX);
+    // The broker keeps QoS 1 commands for a persistent session while the bridge reconnects.
+    Client.setCleanSession(false);
 
-    Client.onMessage([this](String &topic, String &payload) {
-        Log("Received from MQTT: " + topic + " - " + payload);
-        for (int index = 0; index < 6; index++)
+    // The advanced callback hands over the raw buffers instead of two String copies.
+    Client.onMessageAdvanced([this](MQTTClient *client, char topic[], char bytes[], int length) {
+        char payload[MQTT_PAYLOAD_LENGTH];
+        if (length < 0) length = 0;
+        if (length >= (int)sizeof(payload)) length = sizeof(payload) - 1;
+        memcpy(payload, bytes, length);
+        payload[length] = '\0';
+        OnMessage(topic, payload);
+    });
+
+    SEC->AddRegisterListener(this);
+}
+
+void MqttBridge::OnMessage(const char *topic, const char *payload)
+{
+    LOG_DEBUG("Received from MQTT: %s - %s", topic, payload);
+    if (strcmp(topic, HomeAssistantStatus) == 0)
+    {
+        if (strcmp(payload, "online") == 0)
         {
-            if (topic == AreaListSet[index])
-            {
-                int value = payload.toInt();
-                value = max(0, min(value, 6));
-                if (this->SEC != NULL)
-                {
-                    char valueStr[8];
-                    snprintf(valueStr, sizeof(valueStr), "%d", value);
-                    this->SEC->SendMessageResponse(AREA_LEVEL_START + index, valueStr);
-                    Log("Send to SEC Ventilation: " + topic + " - " + payload);
-                }
-            }
+            PendingDiscovery = (1 << SEAREA_COUNT) - 1;
+            SnapshotPending = true;
         }
-    });
+        return;
+    }
+    int route = Topics.Route(topic);
+    if (route < 0) return;
+    switch (SETopicRouter::Get(route).Action)
+    {
+    case SETOPIC_TRACE:
+    {
+        SETrace &trace = SEC->GetTrace();
+        if (strcmp(payload, "dump") == 0)
+        {
+            TraceDumpNext = trace.GetOldest();
+            TraceDumpEnd = trace.GetHead();
+            TraceDumping = true;
+        }
+        else if (strcmp(payload, "arm") == 0) trace.Arm();
+        else if (strcmp(payload, "resume") == 0) trace.Resume();
+        else if (strcmp(payload, "clear") == 0) trace.Clear();
+        break;
+    }
+    case SETOPIC_SCAN:
+    {
+        int first, last;
+        if (strcmp(payload, "stop") == 0)
+        {
+            SEC->StopScan();
+        }
+        else if (sscanf(payload, "%d-%d", &first, &last) == 2)
+        {
+            SEC->StartScan(first, last, true);
+        }
+        break;
+    }
+    case SETOPIC_SET_REGISTER:
+        OnSetRegister(SETopicRouter::Get(route).RegisterId, payload);
+        break;
+    }
+}
+
+void MqttBridge::OnSetRegister(int registerId, const char *payload)
+{
+    // "<value>" or "<value>:<id>"; the id is echoed on the ack topic.
+    const char *id = strchr(payload, ':');
+    size_t length = id != NULL ? id - payload : strlen(payload);
+    id = id != NULL ? id + 1 : "";
+
+    char valueStr[SECONTROLLER_VALUE_LENGTH];
+    int area = registerId - SEAREA_LEVEL_REGISTER;
+    if (area >= 0 && area < SEAREA_COUNT)
+    {
+        int value = atoi(payload);
+        value = max(0, min(value, SEAREA_MAX_LEVEL));
+        snprintf(valueStr, sizeof(valueStr), "%d", value);
+    }
+    else
+    {
+        // Other registers are checked against the register map by the controller.
+        if (length >= sizeof(valueStr)) length = sizeof(valueStr) - 1;
+        memcpy(valueStr, payload, length);
+        valueStr[length] = '\0';
+    }
+
+    if (!Tracker.Begin(registerId, valueStr, id))
+    {
+        LOG_DEBUG("Duplicate command ignored: %d - %s", registerId, payload);
+        return;
+    }
+    if (!Arbiter->Write(Source, registerId, valueStr))
+    {
+        Tracker.Reject(registerId);
+    }
+    LOG_DEBUG("Send to SEC Ventilation: %d - %s", registerId, valueStr);
+}
+
+void MqttBridge::OnRegisterChanged(SEController *controller, int registerId, const char *value)
+{
+    PublishState(registerId, value);
 
-    for (int index = 0; index < 6; index++)
+    int index = registerId - SEAREA_LEVEL_REGISTER;
+    if (index >= 0 && index < SEAREA_COUNT)
     {
-        Client.subscribe(AreaListSet[index]);
+        SnapshotPending = true;
     }
 
-    SEC->AddOnRegisterChanged([this](SEController * seController, int registerId, const char* value) {
-        int index = registerId - AREA_LEVEL_START;
-        if (index >= 0 && index < 6)
+    // A renamed area gets a new name in Home Assistant.
+    index = registerId - SEAREA_LABEL_REGISTER;
+    if (index >= 0 && index < SEAREA_COUNT)
+    {
+        PendingDiscovery |= 1 << index;
+    }
+}
+
+void MqttBridge::BeginConnect()
+{
+    Online = false;
+    Step = HostResolved ? MQTT_STEP_TCP : MQTT_STEP_RESOLVE;
+    Client.setTimeout(MQTT_CONNECT_TIMEOUT_MILLIS);
+}
+
+MqttConnectResult MqttBridge::ConnectStep()
+{
+    char topic[SETOPICROUTER_TOPIC_LENGTH];
+    bool done = true;
+    switch (Step)
+    {
+    case MQTT_STEP_RESOLVE:
+        // Resolved once; later attempts skip the DNS round trip.
+        done = WiFi.hostByName(Hostname, BrokerAddress, MQTT_CONNECT_TIMEOUT_MILLIS);
+        if (done) HostResolved = true;
+        break;
+    case MQTT_STEP_TCP:
+        Net.stop();
+        done = Net.connect(BrokerAddress, Port) > 0;
+        break;
+    case MQTT_STEP_SESSION:
+        // The socket is already open; the client only sends CONNECT and waits for CONNACK.
+        done = Client.connect(ClientId, true);
+        break;
+    // Renewed on every connect in case the broker dropped the session. One
+    // wildcard covers every register; unknown names are dropped by the router.
+    case MQTT_STEP_SUBSCRIBE_SET:
+        done = Topics.Format(topic, sizeof(topic), "set/+") && Client.subscribe(topic, 1);
+        break;
+    case MQTT_STEP_SUBSCRIBE_SCAN:
+        done = Topics.Format(topic, sizeof(topic), "scan/set") && Client.subscribe(topic);
+        break;
+    case MQTT_STEP_SUBSCRIBE_TRACE:
+        done = Topics.Format(topic, sizeof(topic), "trace/set") && Client.subscribe(topic);
+        break;
+    case MQTT_STEP_SUBSCRIBE_STATUS:
+        done = Client.subscribe(HomeAssistantStatus);
+        break;
+    case MQTT_STEP_ONLINE:
+        if (Topics.Format(topic, sizeof(topic), "availability")) done = Client.publish(topic, "online", true, 0);
+        if (!done) break;
+        Stats.Connects++;
+        ConnectedMillis = millis();
+        Consistent = false;
+        PublishStates();
+        // Discovery configs are retained by the broker; after boot they are sent once, later only on changes.
+        if (!DiscoverySent)
         {
-            Log("Publish new airsystem state to MQTT: " + String(AreaListState[index]) + " - " + value);
-            Client.publish(AreaListState[index], value);
+            PendingDiscovery = (1 << SEAREA_COUNT) - 1;
+            DiscoverySent = true;
         }
-    });
+        Client.setTimeout(MQTT_COMMAND_TIMEOUT_MILLIS);
+        Online = true;
+        break;
+    case MQTT_STEP_DONE:
+        return MQTT_CONNECT_DONE;
+    }
+
+    if (!done)
+    {
+        Net.stop();
+        return MQTT_CONNECT_FAILED;
+    }
+    Step = (MqttConnectStep)(Step + 1);
+    return Step == MQTT_STEP_DONE ? MQTT_CONNECT_DONE : MQTT_CONNECT_PENDING;
 }
 
-void MqttBridge::Poll()
+void MqttBridge::SetClientId(const char *clientId)
+{
+    strncpy(ClientId, clientId, sizeof(ClientId) - 1);
+    ClientId[sizeof(ClientId) - 1] = '\0';
+}
+
+void MqttBridge::SetTopicPrefix(const char *prefix)
 {
-    if (!Client.connected()) {
-        Log("MQTT connection lost, attempting to reconnect...");
-        ConnectToMQTT();
+    Topics.SetPrefix(prefix);
+
+    // Home Assistant ids of further units are derived from their prefix; the default unit keeps the plain id.
+    if (strcmp(prefix, MQTT_DEFAULT_TOPIC_PREFIX) == 0)
+    {
+        strcpy(DeviceId, "seventilation");
+    }
+    else
+    {
+        snprintf(DeviceId, sizeof(DeviceId), "seventilation_%s", Topics.GetPrefix());
+        for (char *c = DeviceId; *c != '\0'; c++)
+        {
+            if (!isalnum((unsigned char)*c)) *c = '_';
+        }
     }
+
+    // The client keeps its own copy of the will topic.
+    char topic[SETOPICROUTER_TOPIC_LENGTH];
+    if (Topics.Format(topic, sizeof(topic), "availability")) Client.setWill(topic, "offline", true, 1);
+}
+
+bool MqttBridge::IsConnected()
+{
+    return Online && Client.connected();
+}
+
+void MqttBridge::Poll()
+{
+    if (!IsConnected()) return;
     Client.loop();
+    Tracker.Poll();
+    PublishWriteReports();
+    if (SnapshotPending) PublishSnapshot();
+    if (DiscoverySent && Language != SEGetAreaLanguage()) PendingDiscovery = (1 << SEAREA_COUNT) - 1;
+    PublishDiscovery();
+    PublishScanResults();
+    PublishTrace();
+    PublishTelemetry();
 }
 
-MqttBridge::~MqttBridge() 
+void MqttBridge::PublishState(int registerId, const char *value)
 {
-    Client.disconnect();
+    int route = SETopicRouter::FindRegister(registerId);
+    if (route < 0) return;
+    char topic[SETOPICROUTER_TOPIC_LENGTH];
+    if (Topics.Format(topic, sizeof(topic), "state", route) == 0) return;
+    LOG_DEBUG("Publish new airsystem state to MQTT: %s - %s", topic, value);
+    Client.publish(topic, value, true, 0);
+}
+
+// All known values back to back after a (re)connect. The writes are small and
+// leave in few TCP segments, the snapshot alone is enough for Home Assistant.
+void MqttBridge::PublishStates()
+{
+    PublishSnapshot();
+    for (size_t route = 0; route < SETopicRouter::COUNT; route++)
+    {
+        const SETopicRoute &entry = SETopicRouter::Get(route);
+        if (entry.Action != SETOPIC_SET_REGISTER) continue;
+        const char *value = SEC->GetRegisterValue(entry.RegisterId);
+        if (value != NULL) PublishState(entry.RegisterId, value);
+    }
+}
+
+// One retained message with every known level; changes arriving within one poll share it.
+void MqttBridge::PublishSnapshot()
+{
+    SnapshotPending = false;
+
+    char payload[96];
+    JsonWriter json(payload, sizeof(payload));
+    json.BeginObject();
+    int known = 0;
+    for (int index = 0; index < SEAREA_COUNT; index++)
+    {
+        const char *value = SEC->GetRegisterValue(SEAREA_LEVEL_REGISTER + index);
+        if (value == NULL) continue;
+        char key[8];
+        snprintf(key, sizeof(key), "area-%d", index + 1);
+        json.Member(key, atoi(value));
+        known++;
+    }
+    json.EndObject();
+    char topic[SETOPICROUTER_TOPIC_LENGTH];
+    if (known == 0 || json.HasOverflowed() || Topics.Format(topic, sizeof(topic), "state") == 0) return;
+    Client.publish(topic, json.c_str(), json.GetLength(), true, 0);
+
+    // Time from connect until the broker holds the state of every area.
+    if (!Consistent && known == SEAREA_COUNT)
+    {
+        Consistent = true;
+        Stats.ConsistentMillis = millis() - ConnectedMillis;
+        LOG_INFO("MQTT state consistent %lu ms after connect", Stats.ConsistentMillis);
+    }
+}
+
+// Home Assistant fan entity per area: on/off and the levels 0-6 as preset modes,
+// both read from the snapshot. One config per call.
+void MqttBridge::PublishDiscovery()
+{
+    if (PendingDiscovery == 0) return;
+
+    int area = 0;
+    while (!(PendingDiscovery & (1 << area))) area++;
+    PendingDiscovery &= ~(1 << area);
+    Language = SEGetAreaLanguage();
+
+    char label[SEAREA_NAME_LENGTH];
+    char text[96];
+    char payload[MQTT_DISCOVERY_LENGTH];
+    JsonWriter json(payload, sizeof(payload));
+    json.BeginObject()
+        .Member("~", Topics.GetPrefix())
+        .Member("name", SEAreaLabel(*SEC, area, label, sizeof(label)));
+    snprintf(text, sizeof(text), "%s_area_%d", DeviceId, area + 1);
+    json.Member("uniq_id", (const char *)text)
+        .Member("avty_t", "~/availability")
+        .Member("stat_t", "~/state");
+    snprintf(text, sizeof(text), "{{'ON' if value_json['area-%d']|int>0 else 'OFF'}}", area + 1);
+    json.Member("stat_val_tpl", (const char *)text);
+    snprintf(text, sizeof(text), "~/set/area-%d", area + 1);
+    json.Member("cmd_t", (const char *)text)
+        .Member("pl_on", "1")
+        .Member("pl_off", "0")
+        .Member("pr_mode_cmd_t", (const char *)text)
+        .Member("pr_mode_stat_t", "~/state");
+    snprintf(text, sizeof(text), "{{value_json['area-%d']}}", area + 1);
+    json.Member("pr_mode_val_tpl", (const char *)text);
+    json.Key("pr_modes").BeginArray();
+    for (int level = 0; level <= SEAREA_MAX_LEVEL; level++)
+    {
+        char mode[4];
+        snprintf(mode, sizeof(mode), "%d", level);
+        json.Value((const char *)mode);
+    }
+    json.EndArray();
+    if (strcmp(Topics.GetPrefix(), MQTT_DEFAULT_TOPIC_PREFIX) == 0) snprintf(text, sizeof(text), "SEVentilation");
+    else snprintf(text, sizeof(text), "SEVentilation %s", Topics.GetPrefix());
+    json.Key("dev").BeginObject()
+        .Key("ids").BeginArray().Value((const char *)DeviceId).EndArray()
+        .Member("name", (const char *)text)
+        .Member("mdl", "SEC-Touch")
+        .EndObject();
+    json.EndObject();
+    if (json.HasOverflowed())
+    {
+        LOG_ERROR("Discovery config of area %d too long", area + 1);
+        return;
+    }
+
+    char topic[96];
+    snprintf(topic, sizeof(topic), "%s%s/area-%d/config", DiscoveryPrefix, DeviceId, area + 1);
+    // QoS 0: retained covers late subscribers, and the loop does not wait for a PUBACK.
+    Client.publish(topic, json.c_str(), json.GetLength(), true, 0);
+}
+
+void MqttBridge::PublishWriteReports()
+{
+    const SEWriteReport *report;
+    while ((report = Tracker.TakeReport()) != NULL)
+    {
+        int route = SETopicRouter::FindRegister(report->RegisterId);
+        char topic[SETOPICROUTER_TOPIC_LENGTH];
+        if (route < 0 || Topics.Format(topic, sizeof(topic), "ack", route) == 0) continue;
+
+        // Fan levels keep their numeric "level"; other registers echo the value as written.
+        int area = report->RegisterId - SEAREA_LEVEL_REGISTER;
+        char payload[96];
+        JsonWriter json(payload, sizeof(payload));
+        json.BeginObject().Member("id", (const char *)report->Id);
+        if (area >= 0 && area < SEAREA_COUNT) json.Member("level", atoi(report->Value));
+        else json.Member("value", (const char *)report->Value);
+        json.Member("result", SEWriteTracker::ResultName(report->Result))
+            .Member("ms", report->LatencyMillis)
+            .EndObject();
+        // QoS 0: a burst of reports must not wait for one PUBACK each.
+        if (!json.HasOverflowed()) Client.publish(topic, json.c_str(), json.GetLength(), false, 0);
+    }
 }
 
-void MqttBridge::ConnectToMQTT()
+void MqttBridge::SetMetrics(SEMetrics *metrics)
 {
-    while (!Client.connect("AirSystem")) {
-        Log("MQTT connection failed! Retrying...");
-        delay(1000);
+    Metrics = metrics;
+}
+
+void MqttBridge::PublishTelemetry()
+{
+    if (Metrics == NULL || millis() - LastTelemetryMillis < MQTT_TELEMETRY_INTERVAL_MILLIS) return;
+    LastTelemetryMillis = millis();
+
+    char payload[256];
+    JsonWriter json(payload, sizeof(payload));
+    Metrics->WriteTelemetry(json, *SEC);
+    char topic[SETOPICROUTER_TOPIC_LENGTH];
+    if (!json.HasOverflowed() && Topics.Format(topic, sizeof(topic), "telemetry"))
+    {
+        Client.publish(topic, json.c_str(), json.GetLength());
     }
-    Log("MQTT connected.");
 }
+
+void MqttBridge::PublishTrace()
+{
+    if (!TraceDumping) return;
+
+    // One message per call, filled with as many lines as fit; entries overwritten meanwhile are skipped.
+    SETrace &trace = SEC->GetTrace();
+    if (TraceDumpNext < trace.GetOldest()) TraceDumpNext = trace.GetOldest();
+
+    char payload[MQTT_TRACE_CHUNK_LENGTH];
+    size_t length = 0;
+    SETraceEntry entry;
+    while (TraceDumpNext < TraceDumpEnd && length + SETRACE_LINE_LENGTH <= sizeof(payload))
+    {
+        if (trace.Get(TraceDumpNext, entry))
+        {
+            length += SETrace::Format(TraceDumpNext, entry, payload + length, sizeof(payload) - length);
+        }
+        TraceDumpNext++;
+    }
+
+    char topic[SETOPICROUTER_TOPIC_LENGTH];
+    Topics.Format(topic, sizeof(topic), "trace");
+    if (length > 0)
+    {
+        Client.publish(topic, payload, length);
+    }
+    else
+    {
+        Client.publish(topic, "end");
+        TraceDumping = false;
+    }
+}
+
+void MqttBridge::PublishScanResults()
+{
+    SERegisterScanner &scanner = SEC->GetScanner();
+
+    // One result per call keeps the main loop short while a sweep finds many registers.
+    const SEScanResult *result = scanner.TakeUnreported();
+    if (result != NULL)
+    {
+        char topic[SETOPICROUTER_TOPIC_LENGTH];
+        char suffix[24];
+        snprintf(suffix, sizeof(suffix), "scan/register-%d", result->RegisterId);
+        if (Topics.Format(topic, sizeof(topic), suffix)) Client.publish(topic, result->Value);
+    }
+
+    if (scanner.IsActive() && millis() - LastScanStatusMillis >= SCAN_STATUS_INTERVAL_MILLIS)
+    {
+        LastScanStatusMillis = millis();
+        char status[160];
+        JsonWriter json(status, sizeof(status));
+        json.BeginObject()
+            .Member("registersPerSecond", scanner.GetRegistersPerSecond(millis()), 1)
+            .Member("requests", scanner.Stats.Requests)
+            .Member("answers", scanner.Stats.Answers)
+            .Member("timeouts", scanner.Stats.Timeouts)
+            .Member("found", (unsigned long)scanner.GetCount())
+            .EndObject();
+        char topic[SETOPICROUTER_TOPIC_LENGTH];
+        if (Topics.Format(topic, sizeof(topic), "scan/status")) Client.publish(topic, json.c_str());
+    }
+}
+
+MqttBridge::~MqttBridge()
+{
+    // The broker sends the will only for a lost connection, not after DISCONNECT.
+    char topic[SETOPICROUTER_TOPIC_LENGTH];
+    if (Client.connected() && Topics.Format(topic, sizeof(topic), "availability")) Client.publish(topic, "offline", true, 0);
+    Client.disconnect();
+}
+
@@ -0,0 +1,241 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "SEAreaNames.h"
+#include "SEProgmem.h"
+#include "SEStringPool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Index = value of the label register. The tables are only read by the
+// compiler; the firmware reads the pools built from them, which stay in flash.
+constexpr const char *AreaNamesDe[] = {
+    "", // 0
+    "Bereich 1", // 1
+    "Bereich 2", // 2
+    "Bereich 3", // 3
+    "Bereich 4", // 4
+    "Bereich 5", // 5
+    "Bereich 6", // 6
+    "Wohnzimmer", // 7
+    "Wohnzimmer 1", // 8
+    "Wohnzimmer 2", // 9
+    "Esszimmer", // 10
+    "Esszimmer 1", // 11
+    "Esszimmer 2", // 12
+    "Schlafzimmer", // 13
+    "Schlafzimmer 1", // 14
+    "Schlafzimmer 2", // 15
+    "Kinderzimmer", // 16
+    "Kinderzimmer 1", // 17
+    "Kinderzimmer 2", // 18
+    "Kinderzimmer 3", // 19
+    "Kinderzimmer 4", // 20
+    "Küche", // 21
+    "Küche 1", // 22
+    "Küche 2", // 23
+    "Bad", // 24
+    "Master Bad", // 25
+    "Gäste Bad", // 26
+    "WC", // 27
+    "Gäste WC", // 28
+    "Arbeitszimmer", // 29
+    "Arbeitszimmer 1", // 30
+    "Arbeitszimmer 2", // 31
+    "Hobbyraum", // 32
+    "Mehrzweckraum", // 33
+    "Abstellraum", // 34
+    "Kellerraum", // 35
+    "Kellerraum 1", // 36
+    "Kellerraum 2", // 37
+    "Kellerraum 3", // 38
+    "Dachboden", // 39
+    "Dachboden 1", // 40
+    "Dachboden 2", // 41
+    "Dachboden 3", // 42
+    "Büro", // 43
+    "Büro 1", // 44
+    "Büro 2", // 45
+    "Büro 3", // 46
+    "Büro 4", // 47
+    "Büro 6", // 48
+    "Chef Büro", // 49
+    "Abtl.Ltr. Büro", // 50
+    "Büro EK", // 51
+    "Büro AB", // 52
+    "Büro Entw.", // 53
+    "Büro Konstr.", // 54
+    "Büro Buchh.", // 55
+    "Speiseraum", // 56
+    "Besp. Raum", // 57
+    "Besp. Raum 1", // 58
+    "Besp. Raum 2", // 59
+    "Besp. Raum 3", // 60
+    "Louge", // 61
+    "Bibliothek", // 62
+    "Fitnessraum", // 63
+    "Wintergarten", // 64
+    "Bastelraum", // 65
+    "Ankleidez.", // 66
+    "HWR", // 67
+    "leer" // 68
+};
+
+// Same order as AreaNamesDe.
+constexpr const char *AreaNamesEn[] = {
+    "", // 0
+    "Area 1", // 1
+    "Area 2", // 2
+    "Area 3", // 3
+    "Area 4", // 4
+    "Area 5", // 5
+    "Area 6", // 6
+    "Living room", // 7
+    "Living room 1", // 8
+    "Living room 2", // 9
+    "Dining room", // 10
+    "Dining room 1", // 11
+    "Dining room 2", // 12
+    "Bedroom", // 13
+    "Bedroom 1", // 14
+    "Bedroom 2", // 15
+    "Kids room", // 16
+    "Kids room 1", // 17
+    "Kids room 2", // 18
+    "Kids room 3", // 19
+    "Kids room 4", // 20
+    "Kitchen", // 21
+    "Kitchen 1", // 22
+    "Kitchen 2", // 23
+    "Bathroom", // 24
+    "Master bath", // 25
+    "Guest bath", // 26
+    "Toilet", // 27
+    "Guest toilet", // 28
+    "Study", // 29
+    "Study 1", // 30
+    "Study 2", // 31
+    "Hobby room", // 32
+    "Utility room", // 33
+    "Storage room", // 34
+    "Basement", // 35
+    "Basement 1", // 36
+    "Basement 2", // 37
+    "Basement 3", // 38
+    "Attic", // 39
+    "Attic 1", // 40
+    "Attic 2", // 41
+    "Attic 3", // 42
+    "Office", // 43
+    "Office 1", // 44
+    "Office 2", // 45
+    "Office 3", // 46
+    "Office 4", // 47
+    "Office 6", // 48
+    "Manager office", // 49
+    "Head of dept.", // 50
+    "Purchasing", // 51
+    "Order office", // 52
+    "Development", // 53
+    "Design office", // 54
+    "Accounting", // 55
+    "Dining hall", // 56
+    "Meeting room", // 57
+    "Meeting room 1", // 58
+    "Meeting room 2", // 59
+    "Meeting room 3", // 60
+    "Lounge", // 61
+    "Library", // 62
+    "Fitness room", // 63
+    "Conservatory", // 64
+    "Craft room", // 65
+    "Dressing room", // 66
+    "Laundry room", // 67
+    "empty" // 68
+};
+
+#define AREA_NAME_COUNT (sizeof(AreaNamesDe) / sizeof(AreaNamesDe[0]))
+static_assert(sizeof(AreaNamesEn) / sizeof(AreaNamesEn[0]) == AREA_NAME_COUNT, "Every language needs all names");
+
+static const SEStringPool<SEStringPoolSize(AreaNamesDe), AREA_NAME_COUNT> AreaPoolDe PROGMEM =
+    SEBuildStringPool<SEStringPoolSize(AreaNamesDe)>(AreaNamesDe);
+static const SEStringPool<SEStringPoolSize(AreaNamesEn), AREA_NAME_COUNT> AreaPoolEn PROGMEM =
+    SEBuildStringPool<SEStringPoolSize(AreaNamesEn)>(AreaNamesEn);
+
+static const char FanDe[] PROGMEM = "Lüfter %d";
+static const char FanEn[] PROGMEM = "Fan %d";
+static const char UnknownDe[] PROGMEM = "Unbekannt";
+static const char UnknownEn[] PROGMEM = "Unknown";
+
+struct AreaLanguage
+{
+    const char *Code;
+    const char *Text;
+    const uint16_t *Offsets;
+    const char *Fan;
+    const char *Unknown;
+};
+
+// Indexed by SEAreaLanguage.
+static const AreaLanguage Languages[SEAREA_LANGUAGE_COUNT] = {
+    {"de", AreaPoolDe.Text, AreaPoolDe.Offsets, FanDe, UnknownDe},
+    {"en", AreaPoolEn.Text, AreaPoolEn.Offsets, FanEn, UnknownEn}};
+
+static SEAreaLanguage Language = SEAREA_LANGUAGE_DE;
+
+SEAreaLanguage SEGetAreaLanguage()
+{
+    return Language;
+}
+
+void SESetAreaLanguage(SEAreaLanguage language)
+{
+    if (language < SEAREA_LANGUAGE_COUNT) Language = language;
+}
+
+const char *SEAreaLanguageCode(SEAreaLanguage language)
+{
+    return language < SEAREA_LANGUAGE_COUNT ? Languages[language].Code : NULL;
+}
+
+bool SEParseAreaLanguage(const char *code, SEAreaLanguage &language)
+{
+    for (int i = 0; i < SEAREA_LANGUAGE_COUNT; i++)
+    {
+        if (strcmp(code, Languages[i].Code) == 0)
+        {
+            language = (SEAreaLanguage)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *SEAreaName(int nameIndex, char *buffer, size_t size)
+{
+    if (nameIndex < 0 || (size_t)nameIndex >= AREA_NAME_COUNT || size == 0) return NULL;
+    const AreaLanguage &language = Languages[Language];
+    strncpy_P(buffer, language.Text + pgm_read_word(&language.Offsets[nameIndex]), size - 1);
+    buffer[size - 1] = '\0';
+    return buffer;
+}
+
+const char *SEAreaLabel(const SEController &controller, int area, char *buffer, size_t size)
+{
+    const AreaLanguage &language = Languages[Language];
+    const char *value = controller.GetRegisterValue(SEAREA_LABEL_REGISTER + area);
+    if (value == NULL)
+    {
+        snprintf_P(buffer, size, language.Fan, area + 1);
+        return buffer;
+    }
+    if (SEAreaName(atoi(value), buffer, size) == NULL)
+    {
+        strncpy_P(buffer, language.Unknown, size - 1);
+        buffer[size - 1] = '\0';
+    }
+    return buffer;
+}
@@ -0,0 +1,127 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "SECacheStore.h"
+#include "Logging.h"
+#include "XModemCRC.h"
+#include <string.h>
+
+SECacheStore::SECacheStore(SEController *controller, SEStorage *storage, SEClock *clock)
+{
+    Controller = controller;
+    Storage = storage;
+    Clock = clock;
+    memset(&Stats, 0, sizeof(Stats));
+}
+
+size_t SECacheStore::Restore()
+{
+    uint8_t buffer[sizeof(Header) + SERegisterMap::COUNT * sizeof(Entry)];
+    size_t length = Storage->Load(buffer, sizeof(buffer));
+    if (length < sizeof(Header)) return 0;
+
+    Header header;
+    memcpy(&header, buffer, sizeof(header));
+    const uint8_t *entries = buffer + sizeof(Header);
+    if (header.Magic != SECACHESTORE_MAGIC || header.Count > SERegisterMap::COUNT ||
+        length != sizeof(Header) + header.Count * sizeof(Entry) ||
+        GetXModemCRC((const char *)entries, header.Count * sizeof(Entry)) != header.Crc)
+    {
+        LOG_WARN("Saved register cache is invalid, ignored");
+        return 0;
+    }
+
+    for (uint16_t i = 0; i < header.Count; i++)
+    {
+        Entry entry;
+        memcpy(&entry, entries + i * sizeof(Entry), sizeof(entry));
+        entry.Value[SEREGISTER_VALUE_LENGTH - 1] = '\0';
+        if (Controller->RestoreRegisterValue(entry.RegisterId, entry.Value)) Stats.Restored++;
+    }
+
+    // What is saved already need not be written again; a boot loop does not write at all.
+    Controller->TakeChangedRegisters();
+    Saved = true;
+    Attempted = true;
+    AttemptMillis = Clock->Millis();
+    SavedCrc = header.Crc;
+    SavedCount = header.Count;
+    LOG_INFO("Restored %lu registers from flash", Stats.Restored);
+    return Stats.Restored;
+}
+
+size_t SECacheStore::Encode(uint8_t *buffer, Header &header) const
+{
+    const SERegisterCache &cache = Controller->GetRegisterCache();
+    uint8_t *entries = buffer + sizeof(Header);
+    header.Magic = SECACHESTORE_MAGIC;
+    header.Count = 0;
+    for (size_t slot = 0; slot < SERegisterMap::COUNT; slot++)
+    {
+        const char *value = cache.Get(slot);
+        if (value == NULL) continue;
+        Entry entry;
+        memset(&entry, 0, sizeof(entry));
+        entry.RegisterId = SERegisterMap::Get(slot).Id;
+        strncpy(entry.Value, value, SEREGISTER_VALUE_LENGTH - 1);
+        memcpy(entries + header.Count * sizeof(Entry), &entry, sizeof(entry));
+        header.Count++;
+    }
+    header.Crc = GetXModemCRC((const char *)entries, header.Count * sizeof(Entry));
+    memcpy(buffer, &header, sizeof(header));
+    return sizeof(Header) + header.Count * sizeof(Entry);
+}
+
+void SECacheStore::CollectChanges(unsigned long now)
+{
+    if (Controller->TakeChangedRegisters() == 0) return;
+    if (!Changed) PendingSinceMillis = now;
+    ChangedMillis = now;
+    Changed = true;
+}
+
+void SECacheStore::Poll()
+{
+    unsigned long now = Clock->Millis();
+    CollectChanges(now);
+    if (!Changed) return;
+
+    bool quiet = now - ChangedMillis >= SECACHESTORE_DELAY_MILLIS;
+    bool overdue = now - PendingSinceMillis >= SECACHESTORE_INTERVAL_MILLIS;
+    if (!quiet && !overdue) return;
+    if (Attempted && now - AttemptMillis < SECACHESTORE_INTERVAL_MILLIS) return;
+    Flush();
+}
+
+void SECacheStore::Flush()
+{
+    CollectChanges(Clock->Millis());
+    if (!Changed) return;
+    Changed = false;
+
+    uint8_t buffer[sizeof(Header) + SERegisterMap::COUNT * sizeof(Entry)];
+    Header header;
+    size_t length = Encode(buffer, header);
+    if (Saved && header.Crc == SavedCrc && header.Count == SavedCount)
+    {
+        Stats.Skipped++;
+        return;
+    }
+
+    Attempted = true;
+    AttemptMillis = Clock->Millis();
+    if (!Storage->Save(buffer, length))
+    {
+        // Tried again after SECACHESTORE_INTERVAL_MILLIS.
+        Stats.Failures++;
+        Changed = true;
+        LOG_ERROR("Saving the register cache failed");
+        return;
+    }
+    Saved = true;
+    SavedCrc = header.Crc;
+    SavedCount = header.Count;
+    Stats.Saves++;
+}
@@ -0,0 +1,77 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "SECommandArbiter.h"
+#include "Logging.h"
+#include <string.h>
+
+SECommandArbiter::SECommandArbiter(SEController *controller, SEClock *clock)
+{
+    Controller = controller;
+    Clock = clock;
+    memset(Sources, 0, sizeof(Sources));
+    memset(&Stats, 0, sizeof(Stats));
+    for (size_t i = 0; i < SERegisterMap::COUNT; i++)
+    {
+        Owners[i].Source = SEARBITER_NO_SOURCE;
+        Owners[i].WriteMillis = 0;
+    }
+}
+
+int SECommandArbiter::AddSource(const char *name, uint8_t precedence)
+{
+    if (SourceCount >= SEARBITER_MAX_SOURCES) return -1;
+    Sources[SourceCount].Name = name;
+    Sources[SourceCount].Precedence = precedence;
+    return SourceCount++;
+}
+
+bool SECommandArbiter::Write(int source, int registerId, const char *value)
+{
+    if (source < 0 || source >= SourceCount) return false;
+
+    unsigned long nowMillis = Clock->Millis();
+    SEArbiterSource &writer = Sources[source];
+    writer.Writes++;
+    Stats.Writes++;
+
+    // Registers outside the map are not tracked and always accepted.
+    int slot = SERegisterMap::Find(registerId);
+    RegisterOwner *owner = slot >= 0 ? &Owners[slot] : NULL;
+
+    if (owner != NULL && owner->Source != SEARBITER_NO_SOURCE && owner->Source != source)
+    {
+        const SEArbiterSource &holder = Sources[owner->Source];
+        if (holder.Precedence > writer.Precedence && nowMillis - owner->WriteMillis < SEARBITER_HOLD_MILLIS)
+        {
+            LOG_INFO("Arbiter: %s write to register %d rejected, held by %s", writer.Name, registerId, holder.Name);
+            writer.Rejected++;
+            Stats.Rejected++;
+            return false;
+        }
+        if (Controller->HasPendingWrite(registerId)) Stats.Superseded++;
+    }
+
+    if (!Controller->SendMessageResponse(registerId, value))
+    {
+        Stats.Failed++;
+        return false;
+    }
+
+    if (owner != NULL)
+    {
+        owner->Source = (uint8_t)source;
+        owner->WriteMillis = nowMillis;
+    }
+    Stats.Accepted++;
+    return true;
+}
+
+int SECommandArbiter::GetOwner(int registerId) const
+{
+    int slot = SERegisterMap::Find(registerId);
+    if (slot < 0 || Owners[slot].Source == SEARBITER_NO_SOURCE) return -1;
+    return Owners[slot].Source;
+}
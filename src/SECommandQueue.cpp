@@ -0,0 +1,149 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "SECommandQueue.h"
+#include <string.h>
+
+SECommandQueue::SECommandQueue()
+{
+    memset(Used, 0, sizeof(Used));
+    memset(&Stats, 0, sizeof(Stats));
+}
+
+int SECommandQueue::Find(int registerId, bool isSet) const
+{
+    for (int i = 0; i < SECOMMANDQUEUE_CAPACITY; i++)
+    {
+        if (Used[i] && Entries[i].RegisterId == registerId && Entries[i].IsSet == isSet)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint8_t SECommandQueue::EffectivePriority(int index, unsigned long nowMillis) const
+{
+    uint8_t priority = Entries[index].Priority;
+    if (priority <= SECOMMAND_PRIORITY_CONFIRM) return priority;
+
+    unsigned long promotion = (nowMillis - Entries[index].QueuedMillis) / SECOMMANDQUEUE_AGING_MILLIS;
+    return promotion >= (unsigned long)(priority - SECOMMAND_PRIORITY_CONFIRM) ? (uint8_t)SECOMMAND_PRIORITY_CONFIRM : (uint8_t)(priority - promotion);
+}
+
+// The entry that would be sent last: lowest priority, newest within it.
+int SECommandQueue::FindLowestPriority() const
+{
+    int lowest = -1;
+    for (int i = 0; i < SECOMMANDQUEUE_CAPACITY; i++)
+    {
+        if (!Used[i]) continue;
+        if (lowest < 0 || Entries[i].Priority > Entries[lowest].Priority ||
+            (Entries[i].Priority == Entries[lowest].Priority && Sequence[i] - Sequence[lowest] < 0x80000000UL))
+        {
+            lowest = i;
+        }
+    }
+    return lowest;
+}
+
+bool SECommandQueue::Push(int registerId, bool isSet, const char *value, uint8_t priority, unsigned long nowMillis)
+{
+    int index = Find(registerId, isSet);
+    if (index >= 0)
+    {
+        if (isSet)
+        {
+            strncpy(Entries[index].Value, value, sizeof(Entries[index].Value) - 1);
+            Entries[index].Value[sizeof(Entries[index].Value) - 1] = '\0';
+        }
+        if (priority < Entries[index].Priority) Entries[index].Priority = priority;
+        Stats.Coalesced++;
+        return true;
+    }
+
+    if (Count >= SECOMMANDQUEUE_CAPACITY)
+    {
+        index = FindLowestPriority();
+        if (Entries[index].Priority <= priority)
+        {
+            Stats.Dropped++;
+            return false;
+        }
+        Used[index] = false;
+        Count--;
+        Stats.Evicted++;
+    }
+    else
+    {
+        for (index = 0; Used[index]; index++)
+        {
+        }
+    }
+
+    SECommand &command = Entries[index];
+    command.RegisterId = registerId;
+    command.IsSet = isSet;
+    command.Priority = priority;
+    command.QueuedMillis = nowMillis;
+    if (isSet)
+    {
+        strncpy(command.Value, value, sizeof(command.Value) - 1);
+        command.Value[sizeof(command.Value) - 1] = '\0';
+    }
+    else
+    {
+        command.Value[0] = '\0';
+    }
+    Sequence[index] = NextSequence++;
+    Used[index] = true;
+    Count++;
+
+    Stats.Enqueued++;
+    if (Count > Stats.MaxDepth) Stats.MaxDepth = Count;
+    return true;
+}
+
+bool SECommandQueue::Pop(SECommand &command, unsigned long nowMillis)
+{
+    int next = -1;
+    uint8_t nextPriority = SECOMMAND_PRIORITY_COUNT;
+    for (int i = 0; i < SECOMMANDQUEUE_CAPACITY; i++)
+    {
+        if (!Used[i]) continue;
+        uint8_t priority = EffectivePriority(i, nowMillis);
+        if (next < 0 || priority < nextPriority ||
+            (priority == nextPriority && Sequence[next] - Sequence[i] < 0x80000000UL))
+        {
+            next = i;
+            nextPriority = priority;
+        }
+    }
+    if (next < 0) return false;
+
+    command = Entries[next];
+    Used[next] = false;
+    Count--;
+
+    unsigned long waited = nowMillis - command.QueuedMillis;
+    Stats.Dequeued[command.Priority]++;
+    Stats.TotalWaitMillis[command.Priority] += waited;
+    if (waited > Stats.MaxWaitMillis[command.Priority]) Stats.MaxWaitMillis[command.Priority] = waited;
+    return true;
+}
+
+bool SECommandQueue::Contains(uint8_t priority) const
+{
+    for (int i = 0; i < SECOMMANDQUEUE_CAPACITY; i++)
+    {
+        if (Used[i] && Entries[i].Priority == priority) return true;
+    }
+    return false;
+}
+
+bool SECommandQueue::Contains(int registerId, bool isSet) const
+{
+    return Find(registerId, isSet) >= 0;
+}
@@ -4,259 +4,448 @@
 */
 
 #include "SEController.h"
-#include "XModemCRC.h"
+#include "SEFrameEncoder.h"
 #include "Logging.h"
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
-const int SEController::FAN_LEVEL_REGISTERS[SEController::FAN_LEVEL_COUNT] = {
-    173, 174, 175, 176, 177, 178
-};
+static const uint32_t AckLatencyBounds[SEHISTOGRAM_BOUNDS] = {2000, 4000, 6000, 8000, 10000, 15000, 25000, 50000};
+static const uint32_t QueueDepthBounds[SEHISTOGRAM_BOUNDS] = {1, 2, 3, 4, 6, 8, 12, 16};
 
-const int SEController::LABEL_REGISTERS[SEController::LABEL_COUNT] = {
-    78, 79, 80, 81, 82, 83
-};
+bool SEController::IsRequestInFlight()
+{
+    return InFlight.AwaitingAck || InFlight.RetransmitPending;
+}
+
+size_t SEController::EncodeMessage(char* buffer, size_t size, const SECommand &command)
+{
+    if (command.IsSet) return SEFrameEncoder::EncodeSet(buffer, size, command.RegisterId, command.Value);
+    return SEFrameEncoder::EncodeGet(buffer, size, command.RegisterId);
+}
 
-bool SEController::IsSendBufferEmpty()
+bool SEController::SendMessageResponse(int registerId, const char* content)
 {
-    return SendMessageBuffer[0] == '\0';
+    // Registers missing from the map are passed through unchecked.
+    int slot = SERegisterMap::Find(registerId);
+    if (slot >= 0 && !SERegisterMap::IsValidWrite(slot, content))
+    {
+        LOG_WARN("SendMessageResponse: register %d rejects value %s", registerId, content);
+        return false;
+    }
+
+    if (!CommandQueue.Push(registerId, true, content, SECOMMAND_PRIORITY_WRITE, Clock->Millis()))
+    {
+        LOG_WARN("SendMessageResponse: queue full, register %d dropped", registerId);
+        return false;
+    }
+    return true;
 }
 
-void SEController::SendMessageRequest(int commandId, int registerId)
+void SEController::ProcessMessageResponseIncome(int commandId, int registerId, const char* content)
 {
-    if (!IsSendBufferEmpty()) Log("SendMessageRequest but message buffer != null");
+    int slot = SERegisterMap::Find(registerId);
+    if (slot < 0) return;
 
-    int len = snprintf(SendMessageBuffer, sizeof(SendMessageBuffer), "%c%d%c%d%c", STX, commandId, TAB, registerId, TAB);
+    bool changed = RegisterCache.Update(slot, content, Clock->Millis());
+    PollScheduler.OnValue(registerId, changed, Clock->Millis());
 
-    unsigned short crc = GetXModemCRC(SendMessageBuffer, len);
-    len += snprintf(SendMessageBuffer + len, sizeof(SendMessageBuffer) - len, "%u%c", crc, ETX);
+    if (changed)
+    {
+        LOG_DEBUG("Register %d changed to %s", registerId, content);
+        for (unsigned int i = 0; i < RegisterListenerCount; i++)
+        {
+            RegisterListeners[i]->OnRegisterChanged(this, registerId, content);
+        }
+    }
 }
 
-void SEController::SendMessageResponse(int registerId, const char* content)
+void SEController::ProcessSendMessageAck()
 {
-    if (!IsSendBufferEmpty()) Log("SendMessageResponse but message buffer != null");
+    if (SendMessageAck && Clock->Millis() - PreviousSerialAvailable > SEND_ACK_DELAY_MILLIS)
+    {
+        SendMessageAck = false;
+        const uint8_t ackMessage[] = {STX, ACK, ETX};
+        WriteToBus(ackMessage, sizeof(ackMessage));
+        TraceEvent(SETRACE_TX_ACK, 0, 0);
+    }
+}
 
-    int len = snprintf(SendMessageBuffer, sizeof(SendMessageBuffer), "%c%d%c%d%c%s%c", STX, COMMANDID_SET, TAB, registerId, TAB, content, TAB);
+void SEController::TraceEvent(uint8_t event, int registerId, long value, uint8_t detail)
+{
+    Trace.Record(Clock->Micros(), event, registerId, value, detail);
+}
 
-    unsigned short crc = GetXModemCRC(SendMessageBuffer, len);
-    len += snprintf(SendMessageBuffer + len, sizeof(SendMessageBuffer) - len, "%u%c", crc, ETX);
+void SEController::TraceFrameErrors(const SEFrameErrors &before)
+{
+    const SEFrameErrors &after = Parser.Errors;
+    uint8_t kinds = 0;
+    if (after.Overflows != before.Overflows) kinds |= SETRACE_ERROR_OVERFLOW;
+    if (after.CrcMismatches != before.CrcMismatches) kinds |= SETRACE_ERROR_CRC;
+    if (after.Truncated != before.Truncated) kinds |= SETRACE_ERROR_TRUNCATED;
+    if (after.Malformed != before.Malformed) kinds |= SETRACE_ERROR_MALFORMED;
+    if (kinds == 0) return;
+
+    unsigned long count = (after.Overflows - before.Overflows) + (after.CrcMismatches - before.CrcMismatches) +
+                          (after.Truncated - before.Truncated) + (after.Malformed - before.Malformed);
+    TraceEvent(SETRACE_RX_ERROR, 0, count, kinds);
 }
 
-int SEController::getFanLevelRegisterIndex(int registerId)
+void SEController::ProcessMessage(const SEFrame &frame)
 {
-    for (int i = 0; i < FAN_LEVEL_COUNT; i++)
+    if (frame.IsAck)
     {
-        if (FAN_LEVEL_REGISTERS[i] == registerId)
+        TraceEvent(SETRACE_RX_ACK, InFlight.AwaitingAck ? InFlight.RegisterId : 0, 0);
+        if (InFlight.AwaitingAck) ProcessRequestCompleted();
+    }
+    else
+    {
+        TraceEvent(SETRACE_RX_VALUE, frame.RegisterId, strtol(frame.Value, NULL, 10));
+        SendMessageAck = true;
+
+        // The value frame answering a GET also proves the GET arrived, even if its ACK got lost.
+        if (InFlight.AwaitingAck && !InFlight.IsSet && InFlight.RegisterId == frame.RegisterId)
         {
-            return i;
+            ProcessRequestCompleted();
         }
+
+        ProcessMessageResponseIncome(frame.CommandId, frame.RegisterId, frame.Value);
+        bool scanAnswer = InFlight.Priority == SECOMMAND_PRIORITY_SCAN && InFlight.RegisterId == frame.RegisterId;
+        Scanner.OnValue(frame.RegisterId, frame.Value, scanAnswer, Clock->Millis());
+        ProcessWriteConfirmation(frame.RegisterId, frame.Value);
     }
-    return -1;
 }
 
-int SEController::getLabelRegisterIndex(int registerId)
+SEController::WriteConfirmation *SEController::FindConfirmation(int registerId, bool allocate)
 {
-    for (int i = 0; i < LABEL_COUNT; i++)
+    WriteConfirmation *freeSlot = NULL;
+    for (int i = 0; i < SECONTROLLER_CONFIRMATION_SLOTS; i++)
     {
-        if (LABEL_REGISTERS[i] == registerId)
-        {
-            return i;
-        }
+        if (Confirmations[i].RegisterId == registerId) return &Confirmations[i];
+        if (Confirmations[i].RegisterId < 0 && freeSlot == NULL) freeSlot = &Confirmations[i];
     }
-    return -1;
+    return allocate ? freeSlot : NULL;
 }
 
-void SEController::ProcessMessageResponseIncome(int commandId, int registerId, const char* content)
+void SEController::ProcessRequestCompleted()
 {
-    int index = getFanLevelRegisterIndex(registerId);
-    if (index >= 0)
+    InFlight.AwaitingAck = false;
+    AckLatencyMicros.Observe(Clock->Micros() - InFlight.SentMicros);
+
+    // A write only counts once the register reads back the written value.
+    if (InFlight.IsSet)
     {
-        if (strcmp(FanLevelValues[index], content) != 0)
+        PollScheduler.OnWrite(InFlight.RegisterId, Clock->Millis());
+        WriteConfirmation *confirmation = FindConfirmation(InFlight.RegisterId, true);
+        if (confirmation == NULL)
         {
-            Log("Fan value register " + String(registerId) + " changed to " + String(content));
-            strncpy(FanLevelValues[index], content, sizeof(FanLevelValues[index]) - 1);
-            FanLevelValues[index][sizeof(FanLevelValues[index]) - 1] = '\0';
-            for (unsigned int i = 0; i < OnRegisterChangedCount; i++)
-            {
-                OnRegisterChanged[i](this, registerId, content);
-            }
+            // No slot left to follow the read-back: report the write instead of leaving it open.
+            LOG_ERROR("Register %d: no confirmation slot for value %s", InFlight.RegisterId, InFlight.Value);
+            TraceEvent(SETRACE_WRITE_FAILED, InFlight.RegisterId, strtol(InFlight.Value, NULL, 10));
+            Stats.WritesFailed++;
+            NotifyWriteCompleted(InFlight.RegisterId, InFlight.Value, SEWRITE_FAILED);
+            return;
         }
-        return;
-    }
 
-    index = getLabelRegisterIndex(registerId);
-    if (index >= 0)
-    {
-        if (strcmp(LabelValues[index], content) != 0)
+        if (confirmation->RegisterId != InFlight.RegisterId || strcmp(confirmation->Value, InFlight.Value) != 0)
         {
-            Log("Fan value register " + String(registerId) + " changed to " + String(content));
-            strncpy(LabelValues[index], content, sizeof(LabelValues[index]) - 1);
-            LabelValues[index][sizeof(LabelValues[index]) - 1] = '\0';
-            for (unsigned int i = 0; i < OnRegisterChangedCount; i++)
+            // An older write still waiting for its read-back ends here, replaced by this one.
+            if (confirmation->RegisterId == InFlight.RegisterId)
             {
-                OnRegisterChanged[i](this, registerId, content);
+                NotifyWriteCompleted(confirmation->RegisterId, confirmation->Value, SEWRITE_SUPERSEDED);
             }
+            confirmation->RegisterId = InFlight.RegisterId;
+            strcpy(confirmation->Value, InFlight.Value);
+            confirmation->Attempts = 0;
         }
+        CommandQueue.Push(InFlight.RegisterId, false, NULL, SECOMMAND_PRIORITY_CONFIRM, Clock->Millis());
     }
 }
 
-void SEController::ProcessSendMessageAck()
+void SEController::ProcessWriteConfirmation(int registerId, const char* content)
 {
-    if (SendMessageAck && millis() - PreviousSerialAvailable > SEND_ACK_DELAY_MILLIS)
+    WriteConfirmation *confirmation = FindConfirmation(registerId, false);
+    if (confirmation == NULL) return;
+
+    if (strcmp(confirmation->Value, content) == 0)
     {
-        SendMessageAck = false;
-        SECSerial->write(STX);
-        SECSerial->write(ACK);
-        SECSerial->write(ETX);
+        TraceEvent(SETRACE_WRITE_CONFIRMED, registerId, strtol(content, NULL, 10));
+        Stats.WritesConfirmed++;
+        confirmation->RegisterId = -1;
+        NotifyWriteCompleted(registerId, confirmation->Value, SEWRITE_CONFIRMED);
+        return;
     }
-}
 
-void SEController::ProcessMessage(const char* message)
-{
-    if (message[0] == ACK && message[1] == '\0')
+    TraceEvent(SETRACE_WRITE_MISMATCH, registerId, strtol(content, NULL, 10));
+    Stats.WritesMismatched++;
+    confirmation->Attempts++;
+    if (confirmation->Attempts > SECONTROLLER_MAX_RETRIES)
     {
-        LastMessageAccepted = true;
-        PreviousMillisAckReceived = millis();
+        LOG_ERROR("Register %d did not take value %s", registerId, confirmation->Value);
+        TraceEvent(SETRACE_WRITE_FAILED, registerId, strtol(confirmation->Value, NULL, 10));
+        Stats.WritesFailed++;
+        confirmation->RegisterId = -1;
+        NotifyWriteCompleted(registerId, confirmation->Value, SEWRITE_FAILED);
+        return;
     }
-    else
+
+    // A newer write from a frontend supersedes the repetition.
+    if (CommandQueue.Contains(registerId, true))
     {
-        SendMessageAck = true;
-        int commandId = 0, registerId = 0;
-        char content[32] = {0};
+        confirmation->RegisterId = -1;
+        NotifyWriteCompleted(registerId, confirmation->Value, SEWRITE_SUPERSEDED);
+        return;
+    }
+    CommandQueue.Push(registerId, true, confirmation->Value, SECOMMAND_PRIORITY_WRITE, Clock->Millis());
+}
 
-        int numScanned = sscanf(message, "%d\t%d\t%31s", &commandId, &registerId, content);
+unsigned long SEController::AckTimeoutMillis(size_t frameLength)
+{
+    // Wire time of the request and of the STX ACK ETX answer (8N1, 10 bits per byte).
+    unsigned long wireMillis = ((frameLength + 3) * 10000UL + SECONTROLLER_BAUD - 1) / SECONTROLLER_BAUD;
+    return wireMillis + SECONTROLLER_ACK_TURNAROUND_MILLIS;
+}
+
+void SEController::ProcessAckTimeout(unsigned long currentMillis)
+{
+    if (!InFlight.AwaitingAck || currentMillis - InFlight.SentMillis <= InFlight.TimeoutMillis) return;
+
+    InFlight.AwaitingAck = false;
+    Stats.AckTimeouts++;
+    TraceEvent(SETRACE_ACK_TIMEOUT, InFlight.RegisterId, InFlight.Attempts);
 
-        if (numScanned == 3)
+    if (InFlight.Attempts > SECONTROLLER_MAX_RETRIES)
+    {
+        LOG_ERROR("Register %d: no ACK after %u attempts", InFlight.RegisterId, InFlight.Attempts);
+        TraceEvent(SETRACE_REQUEST_FAILED, InFlight.RegisterId, InFlight.Attempts, InFlight.Priority);
+        Stats.RequestsFailed++;
+
+        if (InFlight.Priority == SECOMMAND_PRIORITY_SCAN)
         {
-            ProcessMessageResponseIncome(commandId, registerId, content);
+            Scanner.OnTimeout(InFlight.RegisterId, currentMillis);
+            return;
         }
-        else
+        if (InFlight.IsSet)
         {
-            Log("ProcessMessage: sscanf failed");
+            TraceEvent(SETRACE_WRITE_FAILED, InFlight.RegisterId, strtol(InFlight.Value, NULL, 10));
+            Stats.WritesFailed++;
+            // A repeated write that was never acknowledged ends the confirmation as well.
+            WriteConfirmation *confirmation = FindConfirmation(InFlight.RegisterId, false);
+            if (confirmation != NULL && strcmp(confirmation->Value, InFlight.Value) == 0) confirmation->RegisterId = -1;
+            NotifyWriteCompleted(InFlight.RegisterId, InFlight.Value, SEWRITE_FAILED);
+            return;
         }
+
+        // A lost read-back is asked again until the confirmation runs out of attempts.
+        WriteConfirmation *confirmation = FindConfirmation(InFlight.RegisterId, false);
+        if (confirmation != NULL)
+        {
+            if (++confirmation->Attempts > SECONTROLLER_MAX_RETRIES)
+            {
+                TraceEvent(SETRACE_WRITE_FAILED, InFlight.RegisterId, strtol(confirmation->Value, NULL, 10));
+                Stats.WritesFailed++;
+                confirmation->RegisterId = -1;
+                NotifyWriteCompleted(InFlight.RegisterId, confirmation->Value, SEWRITE_FAILED);
+            }
+            else
+            {
+                CommandQueue.Push(InFlight.RegisterId, false, NULL, SECOMMAND_PRIORITY_CONFIRM, currentMillis);
+            }
+        }
+        return;
     }
+
+    InFlight.RetransmitPending = true;
 }
 
-void SEController::ProcessFanLevelRegisters()
+void SEController::WriteToBus(const uint8_t* buffer, size_t length)
 {
-    if (LastMessageAccepted && IsSendBufferEmpty())
-    {
-        int registerId = FAN_LEVEL_REGISTERS[FanLevelRegisterIndex];
-        SendMessageRequest(COMMANDID_GET, registerId);
-        FanLevelRegisterIndex = (FanLevelRegisterIndex + 1) % FAN_LEVEL_COUNT;
-        PreviousMillisProcessFanLevels = millis();
-    }
+    Transport->Write(buffer, length);
+    BusWindowBytes += length;
 }
 
-void SEController::ProcessLabelRegisters()
+void SEController::TransmitInFlight()
 {
-    if (LastMessageAccepted && IsSendBufferEmpty())
+    WriteToBus((const uint8_t*)InFlight.Frame, InFlight.Length);
+    InFlight.SentMillis = Clock->Millis();
+    InFlight.SentMicros = Clock->Micros();
+    InFlight.Attempts++;
+    InFlight.AwaitingAck = true;
+    InFlight.RetransmitPending = false;
+    Stats.RequestsSent++;
+    if (InFlight.IsSet)
     {
-        int registerId = LABEL_REGISTERS[LabelRegisterIndex];
-        SendMessageRequest(COMMANDID_GET, registerId);
-        LabelRegisterIndex++;
-
-        if (LabelRegisterIndex >= LABEL_COUNT)
-        {
-            LabelRegisterIndex = 0;
-            PreviousMillisProcessLabels = millis();
-        }
+        TraceEvent(SETRACE_TX_SET, InFlight.RegisterId, strtol(InFlight.Value, NULL, 10), InFlight.Attempts);
+    }
+    else
+    {
+        TraceEvent(SETRACE_TX_GET, InFlight.RegisterId, InFlight.Attempts, InFlight.Priority);
     }
 }
 
-void SEController::ProcessMessageSendBuffer()
+void SEController::ProcessPollScheduler(unsigned long currentMillis)
 {
-    if (!SendMessageAck && !IsSendBufferEmpty())
+    // Due times have millisecond resolution; checking more often than that is wasted work.
+    if (currentMillis == PreviousMillisPollScheduler) return;
+    PreviousMillisPollScheduler = currentMillis;
+
+    // Only one poll waits in the queue at a time, so writes never queue up behind a batch of reads.
+    if (CommandQueue.Contains((uint8_t)SECOMMAND_PRIORITY_POLL) || CommandQueue.Contains((uint8_t)SECOMMAND_PRIORITY_LABEL)) return;
+
+    const SEPollEntry *entry = PollScheduler.NextDue(currentMillis);
+    if (entry != NULL)
     {
-        SECSerial->write((uint8_t*)SendMessageBuffer, strlen(SendMessageBuffer));
-        SendMessageBuffer[0] = '\0';
-        LastMessageAccepted = false;
+        const SEPollGroup &group = PollScheduler.GetGroup(entry->Group);
+        int registerId = entry->RegisterId;
+        PollScheduler.OnPolled(registerId, currentMillis);
+        CommandQueue.Push(registerId, false, NULL, group.Priority, currentMillis);
     }
 }
 
-SEController::SEController(uint8_t rxPin, uint8_t txPin)
+void SEController::ProcessScanner(unsigned long currentMillis)
 {
-    SECSerial = new SoftwareSerial(rxPin, txPin);
-    SECSerial->begin(SECONTROLLER_BAUD);
-    SendMessageBuffer[0] = '\0';
-    ReceiveMessageBuffer[0] = '\0';
-
-    memset(FanLevelValues, 0, sizeof(FanLevelValues));
-    memset(LabelValues, 0, sizeof(LabelValues));
+    // Scan requests only fill gaps: anything else queued or on the wire goes first.
+    if (!Scanner.IsActive() || CommandQueue.Depth() > 0 || IsRequestInFlight()) return;
 
-    FanLevelRegisterIndex = 0;
-    LabelRegisterIndex = 0;
-    LastMessageAccepted = true;
-    PreviousMillisProcessFanLevels = millis();
-    PreviousMillisProcessLabels = millis() - LABEL_UPDATE_INTERVAL;
+    int registerId = Scanner.Next(currentMillis);
+    if (registerId >= 0)
+    {
+        CommandQueue.Push(registerId, false, NULL, SECOMMAND_PRIORITY_SCAN, currentMillis);
+    }
 }
 
-SEController::~SEController()
+void SEController::ProcessBusUtilization(unsigned long currentMillis)
 {
-    delete SECSerial;
-    SECSerial = NULL;
+    unsigned long windowMillis = currentMillis - BusWindowStartMillis;
+    if (windowMillis < BUS_UTILIZATION_WINDOW_MILLIS) return;
+
+    // 8N1: every byte occupies 10 bit times on the line.
+    BusUtilization = (BusWindowBytes * 10000.0f / SECONTROLLER_BAUD) / windowMillis;
+    BusBytes += BusWindowBytes;
+    BusWindowBytes = 0;
+    BusWindowStartMillis = currentMillis;
 }
 
-void SEController::AddOnRegisterChanged(RegisterChangedCallback callback)
+void SEController::ProcessMessageSendBuffer()
 {
-    if (OnRegisterChangedCount < ON_REGISTERCHANGED_MAX)
+    if (SendMessageAck) return;
+
+    if (InFlight.RetransmitPending)
     {
-        OnRegisterChanged[OnRegisterChangedCount] = callback;
-        OnRegisterChangedCount++;
+        Stats.Retransmits++;
+        TransmitInFlight();
+    }
+    else if (!InFlight.AwaitingAck)
+    {
+        SECommand command;
+        unsigned int depth = CommandQueue.Depth();
+        if (!CommandQueue.Pop(command, Clock->Millis())) return;
+        QueueDepth.Observe(depth);
+
+        InFlight.Length = EncodeMessage(InFlight.Frame, sizeof(InFlight.Frame), command);
+        InFlight.RegisterId = command.RegisterId;
+        InFlight.IsSet = command.IsSet;
+        InFlight.Priority = command.Priority;
+        strcpy(InFlight.Value, command.Value);
+        InFlight.TimeoutMillis = AckTimeoutMillis(InFlight.Length);
+        InFlight.Attempts = 0;
+        TransmitInFlight();
     }
 }
 
-void SEController::Poll()
+SEController::SEController(SETransport *transport, SEClock *clock)
+    : AckLatencyMicros(AckLatencyBounds), QueueDepth(QueueDepthBounds)
 {
-    if (SECSerial->available())
+    Transport = transport;
+    Clock = clock;
+    memset(&InFlight, 0, sizeof(InFlight));
+    memset(&Stats, 0, sizeof(Stats));
+    for (int i = 0; i < SECONTROLLER_CONFIRMATION_SLOTS; i++)
     {
-        PreviousSerialAvailable = millis();
-        char incomingByte = SECSerial->read();
+        Confirmations[i].RegisterId = -1;
+    }
 
-        if (incomingByte == STX)
-        {
-            InsideMessageFlag = true;
-            ReceivedSTXFlag = true;
-            ReceiveMessageBuffer[0] = '\0';
-        }
-        else if (incomingByte == ETX && InsideMessageFlag && ReceivedSTXFlag)
-        {
-            InsideMessageFlag = false;
-            ReceivedSTXFlag = false;
-            ProcessMessage(ReceiveMessageBuffer);
-        }
-        else if (InsideMessageFlag)
+    PollScheduler.SetGroup(POLL_GROUP_FAN_LEVEL, POLL_FAN_LEVEL_MIN_MILLIS, POLL_FAN_LEVEL_MAX_MILLIS, SECOMMAND_PRIORITY_POLL);
+    PollScheduler.SetGroup(POLL_GROUP_LABEL, POLL_LABEL_MIN_MILLIS, POLL_LABEL_MAX_MILLIS, SECOMMAND_PRIORITY_LABEL);
+    PollScheduler.SetGroup(POLL_GROUP_SETTING, POLL_SETTING_MIN_MILLIS, POLL_SETTING_MAX_MILLIS, SECOMMAND_PRIORITY_LABEL);
+    for (size_t slot = 0; slot < SERegisterMap::COUNT; slot++)
+    {
+        SERegisterDescriptor descriptor = SERegisterMap::Get(slot);
+        if ((descriptor.Access & SEREGISTER_READ) && descriptor.PollGroup != POLL_GROUP_NONE)
         {
-            size_t len = strlen(ReceiveMessageBuffer);
-            if (len < sizeof(ReceiveMessageBuffer) - 1)
-            {
-                ReceiveMessageBuffer[len] = incomingByte;
-                ReceiveMessageBuffer[len + 1] = '\0';
-            }
+            PollScheduler.AddRegister(descriptor.Id, descriptor.PollGroup, Clock->Millis());
         }
     }
+    BusWindowStartMillis = Clock->Millis();
+}
 
-    unsigned long currentMillis = millis();
+SEController::~SEController()
+{
+    Transport = NULL;
+    Clock = NULL;
+}
+
+bool SEController::HasPendingWrite(int registerId) const
+{
+    return CommandQueue.Contains(registerId, true);
+}
 
-    if (currentMillis - PreviousMillisProcessFanLevels > PROCESS_REQUESTREGISTER_DELAY_MILLIS)
+void SEController::NotifyWriteCompleted(int registerId, const char* value, SEWriteResult result)
+{
+    for (unsigned int i = 0; i < WriteListenerCount; i++)
     {
-        ProcessFanLevelRegisters();
+        WriteListeners[i]->OnWriteCompleted(this, registerId, value, result);
     }
+}
 
-    if ((currentMillis - PreviousMillisProcessLabels >= LABEL_UPDATE_INTERVAL) ||
-        (LabelRegisterIndex > 0 && LastMessageAccepted && IsSendBufferEmpty()))
+void SEController::AddWriteListener(SEWriteListener *listener)
+{
+    if (WriteListenerCount < ON_WRITECOMPLETED_MAX)
     {
-        ProcessLabelRegisters();
+        WriteListeners[WriteListenerCount] = listener;
+        WriteListenerCount++;
     }
+}
 
-    if (currentMillis - PreviousMillisAckReceived > RESET_ACK_MILLIS)
+void SEController::AddRegisterListener(SERegisterListener *listener)
+{
+    if (RegisterListenerCount < ON_REGISTERCHANGED_MAX)
     {
-        PreviousMillisAckReceived = currentMillis;
-        LastMessageAccepted = true;
+        RegisterListeners[RegisterListenerCount] = listener;
+        RegisterListenerCount++;
     }
+}
+
+void SEController::Poll()
+{
+    uint8_t chunk[SECONTROLLER_READ_CHUNK];
+    size_t count;
+    while ((count = Transport->ReadBytes(chunk, sizeof(chunk))) > 0)
+    {
+        SEFrameErrors errors = Parser.Errors;
+        PreviousSerialAvailable = Clock->Millis();
+        BusWindowBytes += count;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (Parser.Push(chunk[i]))
+            {
+                ProcessMessage(Parser.Frame());
+            }
+        }
+        TraceFrameErrors(errors);
+    }
+
+    unsigned long currentMillis = Clock->Millis();
+
+    ProcessAckTimeout(currentMillis);
+
+    ProcessPollScheduler(currentMillis);
+    ProcessScanner(currentMillis);
+    ProcessBusUtilization(currentMillis);
 
     ProcessSendMessageAck();
 
-    if (LastMessageAccepted)
+    if (!InFlight.AwaitingAck)
     {
         if (currentMillis - PreviousSerialAvailable > PROCESS_SENDBUFFER_DELAY_MILLIS)
         {
@@ -264,3 +453,111 @@ void SEController::Poll()
         }
     }
 }
+
+const char* SEController::GetRegisterValue(int registerId) const
+{
+    int slot = SERegisterMap::Find(registerId);
+    return slot < 0 ? NULL : RegisterCache.Get(slot);
+}
+
+unsigned long SEController::GetRegisterUpdatedMillis(int registerId) const
+{
+    int slot = SERegisterMap::Find(registerId);
+    return slot < 0 ? 0 : RegisterCache.GetUpdatedMillis(slot);
+}
+
+const SERegisterCache &SEController::GetRegisterCache() const
+{
+    return RegisterCache;
+}
+
+uint32_t SEController::TakeChangedRegisters()
+{
+    return RegisterCache.TakeDirty();
+}
+
+bool SEController::RestoreRegisterValue(int registerId, const char* value)
+{
+    int slot = SERegisterMap::Find(registerId);
+    if (slot < 0 || RegisterCache.IsValid(slot)) return false;
+    // Read time 0: not read from the bus since the start.
+    return RegisterCache.Update(slot, value, 0);
+}
+
+void SEController::StartScan(int firstRegister, int lastRegister, bool continuous)
+{
+    LOG_INFO("Scanning registers %d to %d", firstRegister, lastRegister);
+    TraceEvent(SETRACE_SCAN_START, firstRegister, lastRegister);
+    Scanner.Start(firstRegister, lastRegister, continuous, Clock->Millis());
+}
+
+void SEController::StopScan()
+{
+    TraceEvent(SETRACE_SCAN_STOP, 0, 0);
+    Scanner.Stop(Clock->Millis());
+}
+
+SERegisterScanner &SEController::GetScanner()
+{
+    return Scanner;
+}
+
+const SEFrameErrors &SEController::GetFrameErrors() const
+{
+    return Parser.Errors;
+}
+
+SETrace &SEController::GetTrace()
+{
+    return Trace;
+}
+
+unsigned long SEController::GetFramesReceived() const
+{
+    return Parser.FramesReceived;
+}
+
+const SEControllerStats &SEController::GetStats() const
+{
+    return Stats;
+}
+
+const SEHistogram &SEController::GetAckLatency() const
+{
+    return AckLatencyMicros;
+}
+
+const SEHistogram &SEController::GetQueueDepthHistogram() const
+{
+    return QueueDepth;
+}
+
+const SECommandQueueStats &SEController::GetQueueStats() const
+{
+    return CommandQueue.Stats;
+}
+
+unsigned int SEController::GetQueueDepth() const
+{
+    return CommandQueue.Depth();
+}
+
+void SEController::SetPollIntervals(uint8_t group, unsigned long minIntervalMillis, unsigned long maxIntervalMillis)
+{
+    PollScheduler.SetGroup(group, minIntervalMillis, maxIntervalMillis, PollScheduler.GetGroup(group).Priority);
+}
+
+const SEPollScheduler &SEController::GetPollScheduler() const
+{
+    return PollScheduler;
+}
+
+float SEController::GetBusUtilization() const
+{
+    return BusUtilization;
+}
+
+unsigned long SEController::GetBusBytes() const
+{
+    return BusBytes + BusWindowBytes;
+}
@@ -0,0 +1,122 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "SEFrameEncoder.h"
+#include "SEController.h"
+#include "SEProgmem.h"
+#include "XModemCRC.h"
+
+// Writes STX <command> TAB <register> TAB [<value> TAB] <crc> ETX. Everything
+// is constexpr, so the same code builds the GET frames in flash at compile time.
+class SEFrameWriter
+{
+private:
+    char *Buffer;
+    size_t Size;
+    size_t Length = 0;
+    unsigned short Crc = 0;
+    bool Overflow = false;
+
+    constexpr void Append(char value)
+    {
+        if (Length < Size) Buffer[Length++] = value;
+        else Overflow = true;
+    }
+
+    // Digits in reverse order; returns their count.
+    static constexpr int Digits(unsigned int value, char (&digits)[10])
+    {
+        int count = 0;
+        do
+        {
+            digits[count++] = (char)('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        return count;
+    }
+
+public:
+    constexpr SEFrameWriter(char *buffer, size_t size) : Buffer(buffer), Size(size) {}
+
+    constexpr void Put(char value)
+    {
+        Crc = UpdateXModemCRCShift(Crc, value);
+        Append(value);
+    }
+
+    constexpr void PutNumber(unsigned int value)
+    {
+        char digits[10] = {};
+        for (int i = Digits(value, digits); i > 0; i--) Put(digits[i - 1]);
+    }
+
+    constexpr void PutString(const char *value)
+    {
+        while (*value != '\0') Put(*value++);
+    }
+
+    // Appends the CRC of everything so far and ETX. Returns the frame length, 0 if it did not fit.
+    constexpr size_t Finish()
+    {
+        char digits[10] = {};
+        for (int i = Digits(Crc, digits); i > 0; i--) Append(digits[i - 1]);
+        Append(ETX);
+        return Overflow ? 0 : Length;
+    }
+};
+
+struct SEGetFrame
+{
+    char Bytes[SEFRAME_GET_LENGTH];
+    uint8_t Length;
+};
+
+static constexpr void WriteRequest(SEFrameWriter &writer, unsigned int commandId, unsigned int registerId)
+{
+    writer.Put(STX);
+    writer.PutNumber(commandId);
+    writer.Put(TAB);
+    writer.PutNumber(registerId);
+    writer.Put(TAB);
+}
+
+static constexpr SEFlashArray<SEGetFrame, SERegisterMap::COUNT> BuildGetFrames()
+{
+    SEFlashArray<SEGetFrame, SERegisterMap::COUNT> frames = {};
+    for (size_t slot = 0; slot < SERegisterMap::COUNT; slot++)
+    {
+        SEFrameWriter writer(frames.Items[slot].Bytes, SEFRAME_GET_LENGTH);
+        WriteRequest(writer, COMMANDID_GET, SE_REGISTER_DESCRIPTORS[slot].Id);
+        frames.Items[slot].Length = (uint8_t)writer.Finish();
+    }
+    return frames;
+}
+
+// Indexed by register slot.
+static const SEFlashArray<SEGetFrame, SERegisterMap::COUNT> GetFrames PROGMEM = BuildGetFrames();
+
+size_t SEFrameEncoder::EncodeGet(char *buffer, size_t size, int registerId)
+{
+    int slot = SERegisterMap::Find(registerId);
+    if (slot >= 0)
+    {
+        size_t length = pgm_read_byte(&GetFrames.Items[slot].Length);
+        if (length > size) return 0;
+        memcpy_P(buffer, GetFrames.Items[slot].Bytes, length);
+        return length;
+    }
+    SEFrameWriter writer(buffer, size);
+    WriteRequest(writer, COMMANDID_GET, registerId);
+    return writer.Finish();
+}
+
+size_t SEFrameEncoder::EncodeSet(char *buffer, size_t size, int registerId, const char *value)
+{
+    SEFrameWriter writer(buffer, size);
+    WriteRequest(writer, COMMANDID_SET, registerId);
+    writer.PutString(value);
+    writer.Put(TAB);
+    return writer.Finish();
+}
@@ -0,0 +1,114 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "SEFrameParser.h"
+#include "SEController.h"
+#include "XModemCRC.h"
+
+// Fields of a valid frame have at most 5 digits (CRC); 9 digits always fit into a long.
+#define FRAME_NUMBER_DIGITS_MAX 9
+
+static bool ParseNumber(const char *begin, const char *end, long &number)
+{
+    if (begin == end || end - begin > FRAME_NUMBER_DIGITS_MAX) return false;
+    number = 0;
+    for (const char *cursor = begin; cursor < end; cursor++)
+    {
+        if (*cursor < '0' || *cursor > '9') return false;
+        number = number * 10 + (*cursor - '0');
+    }
+    return true;
+}
+
+bool SEFrameParser::CompleteFrame()
+{
+    if (Overflow)
+    {
+        Errors.Overflows++;
+        return false;
+    }
+
+    if (Length == 1 && Buffer[0] == ACK)
+    {
+        Current.IsAck = true;
+        Current.CommandId = 0;
+        Current.RegisterId = 0;
+        Current.Value = Buffer + Length;
+        Current.ValueLength = 0;
+        Buffer[Length] = '\0';
+        FramesReceived++;
+        return true;
+    }
+
+    // command TAB register TAB value TAB [...] crc
+    long crc;
+    if (TabCount < 3 || !ParseNumber(Buffer + LastTab + 1, Buffer + Length, crc))
+    {
+        Errors.Malformed++;
+        return false;
+    }
+
+    if (crc != CrcAtLastTab)
+    {
+        Errors.CrcMismatches++;
+        return false;
+    }
+
+    if (!ParseNumber(Buffer, Buffer + FirstTabs[0], Current.CommandId) ||
+        !ParseNumber(Buffer + FirstTabs[0] + 1, Buffer + FirstTabs[1], Current.RegisterId) ||
+        FirstTabs[2] == FirstTabs[1] + 1)
+    {
+        Errors.Malformed++;
+        return false;
+    }
+
+    Current.IsAck = false;
+    Current.Value = Buffer + FirstTabs[1] + 1;
+    Current.ValueLength = FirstTabs[2] - FirstTabs[1] - 1;
+    Buffer[FirstTabs[2]] = '\0';
+    FramesReceived++;
+    return true;
+}
+
+bool SEFrameParser::Push(uint8_t value)
+{
+    if (value == STX)
+    {
+        if (InsideFrame) Errors.Truncated++;
+        InsideFrame = true;
+        Overflow = false;
+        Length = 0;
+        TabCount = 0;
+        Crc = UpdateXModemCRC(0, STX);
+        return false;
+    }
+
+    if (!InsideFrame) return false;
+
+    if (value == ETX)
+    {
+        InsideFrame = false;
+        return CompleteFrame();
+    }
+
+    // One byte stays free for the terminator written by CompleteFrame().
+    if (Length >= sizeof(Buffer) - 1)
+    {
+        Overflow = true;
+        return false;
+    }
+
+    if (value == TAB)
+    {
+        if (TabCount < 3) FirstTabs[TabCount] = Length;
+        TabCount++;
+        LastTab = Length;
+        CrcAtLastTab = UpdateXModemCRC(Crc, TAB);
+    }
+
+    Crc = UpdateXModemCRC(Crc, value);
+    Buffer[Length++] = (char)value;
+    return false;
+}
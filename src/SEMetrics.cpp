@@ -0,0 +1,239 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "SEMetrics.h"
+#include <stdarg.h>
+#include <stdio.h>
+
+#ifdef ARDUINO
+#include <Arduino.h>
+#endif
+
+static const uint32_t LoopBounds[SEHISTOGRAM_BOUNDS] = {100, 250, 500, 1000, 2500, 5000, 10000, 50000};
+
+SEMetrics::SEMetrics() : LoopMicros(LoopBounds)
+{
+}
+
+void SEMetrics::OnLoop(uint32_t loopMicros, unsigned long nowMillis)
+{
+    LoopMicros.Observe(loopMicros);
+
+#ifdef ARDUINO
+    if (!HeapSampled || nowMillis - LastHeapSampleMillis >= SEMETRICS_HEAP_SAMPLE_MILLIS)
+    {
+        LastHeapSampleMillis = nowMillis;
+        SampleHeap(ESP.getFreeHeap(), ESP.getMaxFreeBlockSize());
+    }
+#endif
+}
+
+void SEMetrics::SampleHeap(uint32_t freeHeap, uint32_t maxFreeBlock)
+{
+    FreeHeap = freeHeap;
+    MaxFreeBlock = maxFreeBlock;
+    if (!HeapSampled || freeHeap < FreeHeapMin) FreeHeapMin = freeHeap;
+    if (!HeapSampled || maxFreeBlock < MaxFreeBlockMin) MaxFreeBlockMin = maxFreeBlock;
+    HeapSampled = true;
+}
+
+// Passes either all lines of the export to the writer or only the selected
+// one, so the text can also be produced a line at a time between two polls.
+// Every Printf() is exactly one line, which also keeps it within the
+// formatting buffer of JsonWriter.
+class SEPrometheusLines
+{
+private:
+    JsonWriter &Out;
+    uint32_t Selected;
+    uint32_t Line = 0;
+
+public:
+    SEPrometheusLines(JsonWriter &out, uint32_t selected) : Out(out), Selected(selected) {}
+
+    void Printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+    {
+        if (Selected == SEMETRICS_ALL_LINES || Line == Selected)
+        {
+            va_list args;
+            va_start(args, format);
+            Out.VPrintf(format, args);
+            va_end(args);
+        }
+        Line++;
+    }
+
+    bool HasSelected() const { return Selected == SEMETRICS_ALL_LINES || Line > Selected; }
+};
+
+static void WriteHeader(SEPrometheusLines &out, const char *name, const char *type, const char *help)
+{
+    out.Printf("# HELP %s %s\n", name, help);
+    out.Printf("# TYPE %s %s\n", name, type);
+}
+
+// Values are recorded in microseconds; scale 1000000 exports them in seconds as Prometheus expects.
+// Labels are empty or e.g. unit="airsystem".
+static void WriteHistogramSeries(SEPrometheusLines &out, const char *name, const char *labels, const SEHistogram &histogram, uint32_t scale)
+{
+    const char *separator = *labels ? "," : "";
+    uint32_t cumulative = 0;
+    for (size_t bucket = 0; bucket < SEHISTOGRAM_BOUNDS; bucket++)
+    {
+        cumulative += histogram.GetBucket(bucket);
+        uint32_t bound = histogram.GetBound(bucket);
+        if (scale == 1)
+        {
+            out.Printf("%s_bucket{%s%sle=\"%lu\"} %lu\n", name, labels, separator, (unsigned long)bound, (unsigned long)cumulative);
+        }
+        else
+        {
+            out.Printf("%s_bucket{%s%sle=\"%lu.%06lu\"} %lu\n", name, labels, separator, (unsigned long)(bound / scale),
+                       (unsigned long)(bound % scale), (unsigned long)cumulative);
+        }
+    }
+    out.Printf("%s_bucket{%s%sle=\"+Inf\"} %lu\n", name, labels, separator, (unsigned long)histogram.GetCount());
+    char sum[32];
+    if (scale == 1)
+    {
+        snprintf(sum, sizeof(sum), "%llu", (unsigned long long)histogram.GetSum());
+    }
+    else
+    {
+        snprintf(sum, sizeof(sum), "%llu.%06lu", (unsigned long long)(histogram.GetSum() / scale), (unsigned long)(histogram.GetSum() % scale));
+    }
+    out.Printf(*labels ? "%s_sum{%s} %s\n" : "%s_sum%s %s\n", name, labels, sum);
+    out.Printf(*labels ? "%s_count{%s} %lu\n" : "%s_count%s %lu\n", name, labels, (unsigned long)histogram.GetCount());
+}
+
+typedef const SEHistogram &(*SEUnitHistogram)(const SEUnitScheduler &units, size_t unit);
+typedef unsigned long (*SEUnitValue)(const SEController &controller);
+
+static void WriteUnitHistogram(SEPrometheusLines &out, const char *name, const char *help, const SEUnitScheduler &units, SEUnitHistogram histogram, uint32_t scale)
+{
+    WriteHeader(out, name, "histogram", help);
+    for (size_t unit = 0; unit < units.GetCount(); unit++)
+    {
+        char labels[SEMETRICS_LABEL_LENGTH];
+        snprintf(labels, sizeof(labels), "unit=\"%s\"", units.GetName(unit));
+        WriteHistogramSeries(out, name, labels, histogram(units, unit), scale);
+    }
+}
+
+static void WriteUnitMetric(SEPrometheusLines &out, const char *name, const char *type, const char *help, const SEUnitScheduler &units, SEUnitValue value)
+{
+    WriteHeader(out, name, type, help);
+    for (size_t unit = 0; unit < units.GetCount(); unit++)
+    {
+        out.Printf("%s{unit=\"%s\"} %lu\n", name, units.GetName(unit), value(*units.GetController(unit)));
+    }
+}
+
+static void WriteMetric(SEPrometheusLines &out, const char *name, const char *type, const char *help, unsigned long value)
+{
+    WriteHeader(out, name, type, help);
+    out.Printf("%s %lu\n", name, value);
+}
+
+void SEMetrics::WritePrometheus(JsonWriter &out, const SEUnitScheduler &units) const
+{
+    SEPrometheusLines lines(out, SEMETRICS_ALL_LINES);
+    WritePrometheusLines(lines, units);
+}
+
+bool SEMetrics::WritePrometheusLine(JsonWriter &out, const SEUnitScheduler &units, uint32_t line) const
+{
+    SEPrometheusLines lines(out, line);
+    WritePrometheusLines(lines, units);
+    return lines.HasSelected();
+}
+
+void SEMetrics::WritePrometheusLines(SEPrometheusLines &out, const SEUnitScheduler &units) const
+{
+    WriteHeader(out, "seventilation_loop_duration_seconds", "histogram", "Duration of one main loop iteration.");
+    WriteHistogramSeries(out, "seventilation_loop_duration_seconds", "", LoopMicros, 1000000);
+    WriteUnitHistogram(out, "seventilation_poll_gap_seconds", "Time between two polls of a unit.", units,
+                       [](const SEUnitScheduler &units, size_t unit) -> const SEHistogram & { return units.GetGapMicros(unit); }, 1000000);
+    WriteUnitHistogram(out, "seventilation_ack_latency_seconds", "Request sent until acknowledged by the SEC-Touch.", units,
+                       [](const SEUnitScheduler &units, size_t unit) -> const SEHistogram & { return units.GetController(unit)->GetAckLatency(); }, 1000000);
+    WriteUnitHistogram(out, "seventilation_queue_depth", "Queued requests seen by each request taken from the queue.", units,
+                       [](const SEUnitScheduler &units, size_t unit) -> const SEHistogram & { return units.GetController(unit)->GetQueueDepthHistogram(); }, 1);
+
+    WriteUnitMetric(out, "seventilation_requests_total", "counter", "Requests sent, retransmits included.", units,
+                    [](const SEController &controller) { return controller.GetStats().RequestsSent; });
+    WriteUnitMetric(out, "seventilation_ack_timeouts_total", "counter", "Requests not acknowledged in time.", units,
+                    [](const SEController &controller) { return controller.GetStats().AckTimeouts; });
+    WriteUnitMetric(out, "seventilation_retransmits_total", "counter", "Requests sent again after an ACK timeout.", units,
+                    [](const SEController &controller) { return controller.GetStats().Retransmits; });
+    WriteUnitMetric(out, "seventilation_requests_failed_total", "counter", "Requests without ACK after all retries.", units,
+                    [](const SEController &controller) { return controller.GetStats().RequestsFailed; });
+    WriteUnitMetric(out, "seventilation_frames_received_total", "counter", "Valid frames received.", units,
+                    [](const SEController &controller) { return controller.GetFramesReceived(); });
+
+    WriteHeader(out, "seventilation_frame_errors_total", "counter", "Received frames that were discarded.");
+    for (size_t unit = 0; unit < units.GetCount(); unit++)
+    {
+        const char *name = units.GetName(unit);
+        const SEFrameErrors &errors = units.GetController(unit)->GetFrameErrors();
+        out.Printf("seventilation_frame_errors_total{unit=\"%s\",kind=\"overflow\"} %lu\n", name, errors.Overflows);
+        out.Printf("seventilation_frame_errors_total{unit=\"%s\",kind=\"crc\"} %lu\n", name, errors.CrcMismatches);
+        out.Printf("seventilation_frame_errors_total{unit=\"%s\",kind=\"truncated\"} %lu\n", name, errors.Truncated);
+        out.Printf("seventilation_frame_errors_total{unit=\"%s\",kind=\"malformed\"} %lu\n", name, errors.Malformed);
+    }
+
+    WriteHeader(out, "seventilation_writes_total", "counter", "Acknowledged writes by read-back result.");
+    for (size_t unit = 0; unit < units.GetCount(); unit++)
+    {
+        const char *name = units.GetName(unit);
+        const SEControllerStats &stats = units.GetController(unit)->GetStats();
+        out.Printf("seventilation_writes_total{unit=\"%s\",result=\"confirmed\"} %lu\n", name, stats.WritesConfirmed);
+        out.Printf("seventilation_writes_total{unit=\"%s\",result=\"mismatched\"} %lu\n", name, stats.WritesMismatched);
+        out.Printf("seventilation_writes_total{unit=\"%s\",result=\"failed\"} %lu\n", name, stats.WritesFailed);
+    }
+
+    WriteUnitMetric(out, "seventilation_queue_dropped_total", "counter", "Requests dropped because the queue was full.", units,
+                    [](const SEController &controller) { return controller.GetQueueStats().Dropped; });
+    WriteUnitMetric(out, "seventilation_bus_bytes_total", "counter", "Bytes on the bus in both directions.", units,
+                    [](const SEController &controller) { return controller.GetBusBytes(); });
+    WriteHeader(out, "seventilation_bus_utilization", "gauge", "Share of the line time in use.");
+    for (size_t unit = 0; unit < units.GetCount(); unit++)
+    {
+        out.Printf("seventilation_bus_utilization{unit=\"%s\"} %.3f\n", units.GetName(unit), units.GetController(unit)->GetBusUtilization());
+    }
+
+    if (HeapSampled)
+    {
+        WriteMetric(out, "seventilation_free_heap_bytes", "gauge", "Free heap.", FreeHeap);
+        WriteMetric(out, "seventilation_free_heap_min_bytes", "gauge", "Lowest free heap seen.", FreeHeapMin);
+        WriteMetric(out, "seventilation_max_free_block_bytes", "gauge", "Largest allocatable block.", MaxFreeBlock);
+        WriteMetric(out, "seventilation_max_free_block_min_bytes", "gauge", "Smallest largest allocatable block seen.", MaxFreeBlockMin);
+    }
+}
+
+void SEMetrics::WriteTelemetry(JsonWriter &json, const SEController &controller) const
+{
+    const SEControllerStats &stats = controller.GetStats();
+    const SEFrameErrors &errors = controller.GetFrameErrors();
+    const SEHistogram &ack = controller.GetAckLatency();
+
+    json.BeginObject()
+        .Member("loopMeanUs", LoopMicros.GetMean())
+        .Member("loopMaxUs", LoopMicros.GetMax())
+        .Member("ackMeanUs", ack.GetMean())
+        .Member("ackMaxUs", ack.GetMax())
+        .Member("requests", stats.RequestsSent)
+        .Member("ackTimeouts", stats.AckTimeouts)
+        .Member("failed", stats.RequestsFailed)
+        .Member("frameErrors", errors.Overflows + errors.CrcMismatches + errors.Truncated + errors.Malformed)
+        .Member("queueMax", controller.GetQueueDepthHistogram().GetMax())
+        .Member("bus", controller.GetBusUtilization(), 3);
+    if (HeapSampled)
+    {
+        json.Member("heap", FreeHeap)
+            .Member("heapMin", FreeHeapMin)
+            .Member("maxBlock", MaxFreeBlock);
+    }
+    json.EndObject();
+}
@@ -0,0 +1,107 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "SEPollScheduler.h"
+#include <string.h>
+
+SEPollScheduler::SEPollScheduler()
+{
+    memset(Groups, 0, sizeof(Groups));
+}
+
+SEPollEntry *SEPollScheduler::Find(int registerId)
+{
+    for (size_t i = 0; i < Count; i++)
+    {
+        if (Entries[i].RegisterId == registerId) return &Entries[i];
+    }
+    return NULL;
+}
+
+void SEPollScheduler::SetGroup(uint8_t group, unsigned long minIntervalMillis, unsigned long maxIntervalMillis, uint8_t priority)
+{
+    if (group >= SEPOLL_MAX_GROUPS) return;
+    Groups[group].MinIntervalMillis = minIntervalMillis;
+    Groups[group].MaxIntervalMillis = maxIntervalMillis < minIntervalMillis ? minIntervalMillis : maxIntervalMillis;
+    Groups[group].Priority = priority;
+
+    for (size_t i = 0; i < Count; i++)
+    {
+        SEPollEntry &entry = Entries[i];
+        if (entry.Group != group) continue;
+        if (entry.IntervalMillis < Groups[group].MinIntervalMillis) entry.IntervalMillis = Groups[group].MinIntervalMillis;
+        if (entry.IntervalMillis > Groups[group].MaxIntervalMillis) entry.IntervalMillis = Groups[group].MaxIntervalMillis;
+    }
+}
+
+bool SEPollScheduler::AddRegister(int registerId, uint8_t group, unsigned long nowMillis)
+{
+    if (Count >= SEPOLL_MAX_REGISTERS || group >= SEPOLL_MAX_GROUPS || Find(registerId) != NULL) return false;
+
+    SEPollEntry &entry = Entries[Count++];
+    memset(&entry, 0, sizeof(entry));
+    entry.RegisterId = registerId;
+    entry.Group = group;
+    entry.IntervalMillis = Groups[group].MinIntervalMillis;
+    entry.DueMillis = nowMillis;
+    return true;
+}
+
+const SEPollEntry *SEPollScheduler::NextDue(unsigned long nowMillis) const
+{
+    const SEPollEntry *next = NULL;
+    unsigned long nextOverdue = 0;
+    for (size_t i = 0; i < Count; i++)
+    {
+        unsigned long overdue = nowMillis - Entries[i].DueMillis;
+        if ((long)overdue < 0) continue;
+        if (next == NULL || overdue > nextOverdue)
+        {
+            next = &Entries[i];
+            nextOverdue = overdue;
+        }
+    }
+    return next;
+}
+
+void SEPollScheduler::OnPolled(int registerId, unsigned long nowMillis)
+{
+    SEPollEntry *entry = Find(registerId);
+    if (entry == NULL) return;
+
+    // Provisional: if the answer never arrives, the register is simply polled again.
+    entry->DueMillis = nowMillis + entry->IntervalMillis;
+    entry->Polls++;
+}
+
+void SEPollScheduler::OnValue(int registerId, bool changed, unsigned long nowMillis)
+{
+    SEPollEntry *entry = Find(registerId);
+    if (entry == NULL) return;
+
+    const SEPollGroup &group = Groups[entry->Group];
+    if (changed || !entry->HasValue)
+    {
+        entry->IntervalMillis = group.MinIntervalMillis;
+        entry->LastChangeMillis = nowMillis;
+        entry->Changes++;
+    }
+    else if (entry->IntervalMillis < group.MaxIntervalMillis)
+    {
+        entry->IntervalMillis = entry->IntervalMillis * 2 > group.MaxIntervalMillis ? group.MaxIntervalMillis : entry->IntervalMillis * 2;
+    }
+    entry->HasValue = true;
+    entry->LastValueMillis = nowMillis;
+    entry->DueMillis = nowMillis + entry->IntervalMillis;
+}
+
+void SEPollScheduler::OnWrite(int registerId, unsigned long nowMillis)
+{
+    SEPollEntry *entry = Find(registerId);
+    if (entry == NULL) return;
+
+    entry->IntervalMillis = Groups[entry->Group].MinIntervalMillis;
+    entry->DueMillis = nowMillis + entry->IntervalMillis;
+}
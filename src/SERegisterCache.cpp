@@ -0,0 +1,39 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "SERegisterCache.h"
+#include <string.h>
+
+SERegisterCache::SERegisterCache()
+{
+    memset(Values, 0, sizeof(Values));
+    memset(UpdatedMillis, 0, sizeof(UpdatedMillis));
+}
+
+bool SERegisterCache::Update(size_t slot, const char *value, unsigned long nowMillis)
+{
+    if (slot >= SERegisterMap::COUNT) return false;
+
+    UpdatedMillis[slot] = nowMillis;
+    if (IsValid(slot) && strncmp(Values[slot], value, SEREGISTER_VALUE_LENGTH - 1) == 0) return false;
+
+    strncpy(Values[slot], value, SEREGISTER_VALUE_LENGTH - 1);
+    Values[slot][SEREGISTER_VALUE_LENGTH - 1] = '\0';
+    ValidMask |= 1UL << slot;
+    DirtyMask |= 1UL << slot;
+    return true;
+}
+
+const char *SERegisterCache::Get(size_t slot) const
+{
+    return slot < SERegisterMap::COUNT && IsValid(slot) ? Values[slot] : NULL;
+}
+
+uint32_t SERegisterCache::TakeDirty()
+{
+    uint32_t dirty = DirtyMask;
+    DirtyMask = 0;
+    return dirty;
+}
@@ -0,0 +1,76 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "SERegisterMap.h"
+#include "SEProgmem.h"
+#include <stdlib.h>
+
+#define SEREGISTER_NO_SLOT 0xFF
+#define SEREGISTER_FLAGS_DIGITS 4
+
+static_assert(SERegisterMap::COUNT < SEREGISTER_NO_SLOT, "Register slots must fit into a byte");
+
+static constexpr SEFlashArray<uint8_t, SERegisterMap::MAX_REGISTER_ID + 1> BuildSlotIndex()
+{
+    SEFlashArray<uint8_t, SERegisterMap::MAX_REGISTER_ID + 1> slots = {};
+    for (size_t id = 0; id <= (size_t)SERegisterMap::MAX_REGISTER_ID; id++)
+    {
+        slots.Items[id] = SEREGISTER_NO_SLOT;
+    }
+    for (size_t slot = 0; slot < SERegisterMap::COUNT; slot++)
+    {
+        slots.Items[SE_REGISTER_DESCRIPTORS[slot].Id] = (uint8_t)slot;
+    }
+    return slots;
+}
+
+static constexpr SEFlashArray<SERegisterDescriptor, SERegisterMap::COUNT> BuildDescriptors()
+{
+    SEFlashArray<SERegisterDescriptor, SERegisterMap::COUNT> descriptors = {};
+    for (size_t slot = 0; slot < SERegisterMap::COUNT; slot++)
+    {
+        descriptors.Items[slot] = SE_REGISTER_DESCRIPTORS[slot];
+    }
+    return descriptors;
+}
+
+static const SEFlashArray<uint8_t, SERegisterMap::MAX_REGISTER_ID + 1> SlotIndex PROGMEM = BuildSlotIndex();
+static const SEFlashArray<SERegisterDescriptor, SERegisterMap::COUNT> FlashDescriptors PROGMEM = BuildDescriptors();
+
+int SERegisterMap::Find(int registerId)
+{
+    if (registerId < 0 || registerId > MAX_REGISTER_ID) return -1;
+    uint8_t slot = pgm_read_byte(&SlotIndex.Items[registerId]);
+    return slot == SEREGISTER_NO_SLOT ? -1 : slot;
+}
+
+SERegisterDescriptor SERegisterMap::Get(size_t slot)
+{
+    SERegisterDescriptor descriptor;
+    memcpy_P(&descriptor, &FlashDescriptors.Items[slot], sizeof(descriptor));
+    return descriptor;
+}
+
+bool SERegisterMap::IsValidWrite(size_t slot, const char *value)
+{
+    SERegisterDescriptor descriptor = Get(slot);
+    if (!(descriptor.Access & SEREGISTER_WRITE) || value == NULL || value[0] == '\0') return false;
+    if (descriptor.Type == SEREGISTER_TYPE_FLAGS)
+    {
+        // Four upper-case hex digits as the SEC-Touch reports them, so the read-back compares equal.
+        for (int i = 0; i < SEREGISTER_FLAGS_DIGITS; i++)
+        {
+            char digit = value[i];
+            if (!((digit >= '0' && digit <= '9') || (digit >= 'A' && digit <= 'F'))) return false;
+        }
+        return value[SEREGISTER_FLAGS_DIGITS] == '\0';
+    }
+
+    // strtol() would skip leading white space, a TAB included.
+    if (value[0] != '-' && (value[0] < '0' || value[0] > '9')) return false;
+    char *end;
+    long number = strtol(value, &end, 10);
+    return *end == '\0' && number >= descriptor.Min && number <= descriptor.Max;
+}
@@ -0,0 +1,136 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "SERegisterScanner.h"
+#include <string.h>
+
+SERegisterScanner::SERegisterScanner()
+{
+    memset(Results, 0, sizeof(Results));
+    memset(&Stats, 0, sizeof(Stats));
+}
+
+SEScanResult *SERegisterScanner::Find(int registerId)
+{
+    for (size_t i = 0; i < Count; i++)
+    {
+        if (Results[i].RegisterId == registerId) return &Results[i];
+    }
+    return NULL;
+}
+
+void SERegisterScanner::Start(int firstRegister, int lastRegister, bool continuous, unsigned long nowMillis)
+{
+    if (firstRegister < 0 || lastRegister < firstRegister) return;
+
+    FirstRegister = firstRegister;
+    LastRegister = lastRegister;
+    NextRegister = firstRegister;
+    Continuous = continuous;
+    BackoffMillis = 0;
+    StartMillis = nowMillis;
+    LastRequestMillis = nowMillis - IntervalMillis;
+    Stats.Requests = 0;
+    Active = true;
+}
+
+void SERegisterScanner::Stop(unsigned long nowMillis)
+{
+    if (!Active) return;
+    Active = false;
+    StopMillis = nowMillis;
+}
+
+int SERegisterScanner::Next(unsigned long nowMillis)
+{
+    if (!Active) return -1;
+
+    unsigned long pause = BackoffMillis > IntervalMillis ? BackoffMillis : IntervalMillis;
+    if (nowMillis - LastRequestMillis < pause) return -1;
+
+    if (NextRegister > LastRegister)
+    {
+        Stats.Sweeps++;
+        if (!Continuous)
+        {
+            Stop(nowMillis);
+            return -1;
+        }
+        NextRegister = FirstRegister;
+    }
+
+    LastRequestMillis = nowMillis;
+    Stats.Requests++;
+    return NextRegister++;
+}
+
+void SERegisterScanner::OnValue(int registerId, const char *value, bool scanAnswer, unsigned long nowMillis)
+{
+    if (!IsInRange(registerId)) return;
+
+    if (scanAnswer)
+    {
+        Stats.Answers++;
+        BackoffMillis = 0;
+    }
+
+    SEScanResult *result = Find(registerId);
+    if (result == NULL)
+    {
+        if (Count >= SESCAN_MAX_RESULTS)
+        {
+            Stats.ResultsDropped++;
+            return;
+        }
+        result = &Results[Count++];
+        result->RegisterId = registerId;
+        result->FirstSeenMillis = nowMillis;
+        result->LastChangeMillis = nowMillis;
+    }
+    else if (strncmp(result->Value, value, SEREGISTER_VALUE_LENGTH - 1) != 0)
+    {
+        result->Changes++;
+        result->LastChangeMillis = nowMillis;
+    }
+    else
+    {
+        result->Reads++;
+        return;
+    }
+
+    result->Reads++;
+    strncpy(result->Value, value, SEREGISTER_VALUE_LENGTH - 1);
+    result->Value[SEREGISTER_VALUE_LENGTH - 1] = '\0';
+    result->Reported = false;
+}
+
+void SERegisterScanner::OnTimeout(int registerId, unsigned long nowMillis)
+{
+    if (!IsInRange(registerId)) return;
+
+    Stats.Timeouts++;
+    BackoffMillis = BackoffMillis == 0 ? SESCAN_BACKOFF_MIN_MILLIS : BackoffMillis * 2;
+    if (BackoffMillis > SESCAN_BACKOFF_MAX_MILLIS) BackoffMillis = SESCAN_BACKOFF_MAX_MILLIS;
+    LastRequestMillis = nowMillis;
+}
+
+float SERegisterScanner::GetRegistersPerSecond(unsigned long nowMillis) const
+{
+    unsigned long elapsed = (Active ? nowMillis : StopMillis) - StartMillis;
+    return elapsed > 0 ? Stats.Requests * 1000.0f / elapsed : 0;
+}
+
+const SEScanResult *SERegisterScanner::TakeUnreported()
+{
+    for (size_t i = 0; i < Count; i++)
+    {
+        if (!Results[i].Reported)
+        {
+            Results[i].Reported = true;
+            return &Results[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,135 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "SETopicRouter.h"
+#include "SEProgmem.h"
+#include "SERegisterMap.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SETOPICROUTER_NO_ROUTE 0xFF
+
+static_assert((SETOPICROUTER_SLOTS & (SETOPICROUTER_SLOTS - 1)) == 0, "SETOPICROUTER_SLOTS must be a power of two");
+static_assert(SETopicRouter::COUNT * 2 <= SETOPICROUTER_SLOTS, "Too many routes for SETOPICROUTER_SLOTS");
+
+static constexpr const char *SetGroup = "set/";
+
+// Hash of the topic below the prefix: set/<name> for registers, the name itself otherwise.
+static constexpr uint32_t RouteHash(const SETopicRoute &route)
+{
+    return route.Action == SETOPIC_SET_REGISTER ? SETopicHash(route.Name, SETopicHash(SetGroup)) : SETopicHash(route.Name);
+}
+
+struct SERouteTable
+{
+    uint32_t Hashes[SETOPICROUTER_SLOTS];
+    uint8_t Routes[SETOPICROUTER_SLOTS];
+    uint8_t RegisterRoutes[SERegisterMap::COUNT]; // register slot -> route
+};
+
+static constexpr SERouteTable BuildRouteTable()
+{
+    SERouteTable table = {};
+    for (size_t slot = 0; slot < SETOPICROUTER_SLOTS; slot++)
+    {
+        table.Routes[slot] = SETOPICROUTER_NO_ROUTE;
+    }
+    for (size_t slot = 0; slot < SERegisterMap::COUNT; slot++)
+    {
+        table.RegisterRoutes[slot] = SETOPICROUTER_NO_ROUTE;
+    }
+    for (size_t route = 0; route < SETopicRouter::COUNT; route++)
+    {
+        uint32_t hash = RouteHash(SE_TOPIC_ROUTES[route]);
+        size_t slot = hash & (SETOPICROUTER_SLOTS - 1);
+        while (table.Routes[slot] != SETOPICROUTER_NO_ROUTE)
+        {
+            slot = (slot + 1) & (SETOPICROUTER_SLOTS - 1);
+        }
+        table.Hashes[slot] = hash;
+        table.Routes[slot] = (uint8_t)route;
+
+        if (SE_TOPIC_ROUTES[route].Action == SETOPIC_SET_REGISTER)
+        {
+            for (size_t registerSlot = 0; registerSlot < SERegisterMap::COUNT; registerSlot++)
+            {
+                if (SE_REGISTER_DESCRIPTORS[registerSlot].Id == SE_TOPIC_ROUTES[route].RegisterId)
+                {
+                    table.RegisterRoutes[registerSlot] = (uint8_t)route;
+                }
+            }
+        }
+    }
+    return table;
+}
+
+static const SERouteTable RouteTable PROGMEM = BuildRouteTable();
+
+SETopicRouter::SETopicRouter(const char *prefix)
+{
+    SetPrefix(prefix);
+}
+
+void SETopicRouter::SetPrefix(const char *prefix)
+{
+    strncpy(Prefix, prefix, sizeof(Prefix) - 1);
+    Prefix[sizeof(Prefix) - 1] = '\0';
+    PrefixLength = strlen(Prefix);
+}
+
+int SETopicRouter::Route(const char *topic) const
+{
+    if (strncmp(topic, Prefix, PrefixLength) != 0 || topic[PrefixLength] != '/') return -1;
+    return Find(topic + PrefixLength + 1);
+}
+
+int SETopicRouter::Find(const char *suffix)
+{
+    uint32_t hash = SETopicHash(suffix);
+    size_t slot = hash & (SETOPICROUTER_SLOTS - 1);
+    for (size_t probes = 0; probes < SETOPICROUTER_SLOTS; probes++)
+    {
+        uint8_t route = pgm_read_byte(&RouteTable.Routes[slot]);
+        if (route == SETOPICROUTER_NO_ROUTE) return -1;
+        if (pgm_read_dword(&RouteTable.Hashes[slot]) == hash)
+        {
+            // Confirm the match; two topics may share a hash.
+            const SETopicRoute &candidate = SE_TOPIC_ROUTES[route];
+            // Register routes are named without their "set/" group. A mismatch
+            // keeps probing, the route may sit further along the chain.
+            const char *name = suffix;
+            if (candidate.Action == SETOPIC_SET_REGISTER)
+            {
+                name = strncmp(suffix, SetGroup, 4) == 0 ? suffix + 4 : NULL;
+            }
+            if (name != NULL && strcmp(name, candidate.Name) == 0) return route;
+        }
+        slot = (slot + 1) & (SETOPICROUTER_SLOTS - 1);
+    }
+    return -1;
+}
+
+int SETopicRouter::FindRegister(int registerId)
+{
+    int slot = SERegisterMap::Find(registerId);
+    if (slot < 0) return -1;
+    uint8_t route = pgm_read_byte(&RouteTable.RegisterRoutes[slot]);
+    return route == SETOPICROUTER_NO_ROUTE ? -1 : route;
+}
+
+static size_t Finish(int length, size_t size)
+{
+    return length < 0 || (size_t)length >= size ? 0 : (size_t)length;
+}
+
+size_t SETopicRouter::Format(char *buffer, size_t size, const char *group, int route) const
+{
+    return Finish(snprintf(buffer, size, "%s/%s/%s", Prefix, group, SE_TOPIC_ROUTES[route].Name), size);
+}
+
+size_t SETopicRouter::Format(char *buffer, size_t size, const char *suffix) const
+{
+    return Finish(snprintf(buffer, size, "%s/%s", Prefix, suffix), size);
+}
@@ -0,0 +1,66 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "SETrace.h"
+#include <stdio.h>
+
+static_assert((SETRACE_CAPACITY & (SETRACE_CAPACITY - 1)) == 0, "SETRACE_CAPACITY must be a power of two");
+
+static const char *const EventNames[SETRACE_EVENT_COUNT] = {
+    "?",
+    "tx-get",
+    "tx-set",
+    "tx-ack",
+    "rx-ack",
+    "rx-value",
+    "rx-error",
+    "ack-timeout",
+    "request-failed",
+    "write-confirmed",
+    "write-mismatch",
+    "write-failed",
+    "scan-start",
+    "scan-stop",
+};
+
+void SETrace::Arm()
+{
+    Armed = true;
+    FreezeAt = 0;
+}
+
+void SETrace::Resume()
+{
+    Armed = false;
+    Frozen = false;
+    FreezeAt = 0;
+}
+
+void SETrace::Clear()
+{
+    Head = 0;
+    Resume();
+}
+
+bool SETrace::Get(uint32_t sequence, SETraceEntry &entry) const
+{
+    if (sequence >= Head || sequence < GetOldest()) return false;
+    entry = Entries[sequence & (SETRACE_CAPACITY - 1)];
+    // The writer may have lapped the reader while copying.
+    return sequence >= GetOldest();
+}
+
+const char *SETrace::EventName(uint8_t event)
+{
+    return event < SETRACE_EVENT_COUNT ? EventNames[event] : EventNames[0];
+}
+
+size_t SETrace::Format(uint32_t sequence, const SETraceEntry &entry, char *buffer, size_t size)
+{
+    int length = snprintf(buffer, size, "%lu %lu %s %u %ld %u\n", (unsigned long)sequence, (unsigned long)entry.Micros,
+                          EventName(entry.Event), (unsigned)entry.RegisterId, (long)entry.Value, (unsigned)entry.Detail);
+    if (length < 0) return 0;
+    return (size_t)length < size ? (size_t)length : size - 1;
+}
@@ -0,0 +1,42 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "SEUnitScheduler.h"
+
+// One byte takes about 350 us at 28800 baud; the UART buffers hold many of them.
+static const uint32_t GapBounds[SEHISTOGRAM_BOUNDS] = {100, 250, 500, 1000, 2500, 5000, 10000, 50000};
+
+SEUnitScheduler::Unit::Unit() : Name(NULL), Controller(NULL), GapMicros(GapBounds), LastPollMicros(0), Polls(0)
+{
+}
+
+SEUnitScheduler::SEUnitScheduler(SEClock *clock)
+{
+    Clock = clock;
+}
+
+int SEUnitScheduler::Add(const char *name, SEController *controller)
+{
+    if (Count >= SEUNITSCHEDULER_MAX_UNITS) return -1;
+    Units[Count].Name = name;
+    Units[Count].Controller = controller;
+    return Count++;
+}
+
+void SEUnitScheduler::Poll()
+{
+    if (Count == 0) return;
+
+    for (uint8_t i = 0; i < Count; i++)
+    {
+        Unit &unit = Units[(Next + i) % Count];
+        unsigned long now = Clock->Micros();
+        if (unit.Polls > 0) unit.GapMicros.Observe(now - unit.LastPollMicros);
+        unit.LastPollMicros = now;
+        unit.Polls++;
+        unit.Controller->Poll();
+    }
+    Next = (Next + 1) % Count;
+}
@@ -0,0 +1,141 @@
+/*
+  This file is part of the SEVentilation to MQTT project.
+  Copyright (C) 2023 Dr. Manuel Siekmann. All rights reserved.
+*/
+
+#include "SEWriteTracker.h"
+#include <string.h>
+
+static const uint32_t LatencyBounds[SEHISTOGRAM_BOUNDS] = {50, 100, 200, 300, 500, 1000, 2000, 5000};
+
+SEWriteTracker::SEWriteTracker(SEController *controller, SEClock *clock) : LatencyMillis(LatencyBounds)
+{
+    Controller = controller;
+    Clock = clock;
+    memset(Entries, 0, sizeof(Entries));
+    memset(Reports, 0, sizeof(Reports));
+    memset(&Stats, 0, sizeof(Stats));
+    controller->AddWriteListener(this);
+}
+
+static void CopyText(char *destination, const char *source, size_t size)
+{
+    strncpy(destination, source != NULL ? source : "", size - 1);
+    destination[size - 1] = '\0';
+}
+
+bool SEWriteTracker::Begin(int registerId, const char *value, const char *id)
+{
+    int slot = SERegisterMap::Find(registerId);
+    if (slot < 0) return true;
+
+    if (id == NULL) id = "";
+    unsigned long nowMillis = Clock->Millis();
+    Entry &entry = Entries[slot];
+
+    if (entry.Used && nowMillis - entry.ReceivedMillis < SEWRITETRACKER_DEDUP_MILLIS)
+    {
+        const char *current = Controller->GetRegisterValue(registerId);
+        bool same = id[0] != '\0' ? strncmp(entry.Id, id, SEWRITETRACKER_ID_LENGTH - 1) == 0
+                                  : entry.Id[0] == '\0' && strcmp(entry.Value, value) == 0 &&
+                                        (entry.Pending || (current != NULL && strcmp(current, value) == 0));
+        if (same)
+        {
+            // The sender did not get the outcome yet; it is sent again once known.
+            Stats.Duplicates++;
+            if (!entry.Pending) QueueReport(slot, entry.Result, entry.CompletedMillis - entry.ReceivedMillis);
+            return false;
+        }
+    }
+
+    if (entry.Used && entry.Pending) Complete(slot, SETRACKED_SUPERSEDED);
+
+    CopyText(entry.Id, id, sizeof(entry.Id));
+    CopyText(entry.Value, value, sizeof(entry.Value));
+    entry.ReceivedMillis = nowMillis;
+    entry.Used = true;
+    entry.Pending = true;
+    Stats.Writes++;
+    return true;
+}
+
+void SEWriteTracker::Reject(int registerId)
+{
+    int slot = SERegisterMap::Find(registerId);
+    if (slot >= 0 && Entries[slot].Pending) Complete(slot, SETRACKED_REJECTED);
+}
+
+void SEWriteTracker::OnWriteCompleted(SEController *controller, int registerId, const char *value, SEWriteResult result)
+{
+    int slot = SERegisterMap::Find(registerId);
+    if (slot < 0 || !Entries[slot].Pending) return;
+
+    if (strcmp(Entries[slot].Value, value) == 0)
+    {
+        static const uint8_t results[] = {SETRACKED_CONFIRMED, SETRACKED_FAILED, SETRACKED_SUPERSEDED};
+        Complete(slot, results[result]);
+    }
+    else if (result == SEWRITE_CONFIRMED)
+    {
+        // Another frontend's value reached the register after ours was queued.
+        Complete(slot, SETRACKED_SUPERSEDED);
+    }
+}
+
+void SEWriteTracker::Poll()
+{
+    unsigned long nowMillis = Clock->Millis();
+    for (size_t slot = 0; slot < SERegisterMap::COUNT; slot++)
+    {
+        if (Entries[slot].Pending && nowMillis - Entries[slot].ReceivedMillis >= SEWRITETRACKER_TIMEOUT_MILLIS)
+        {
+            Complete(slot, SETRACKED_TIMEOUT);
+        }
+    }
+}
+
+void SEWriteTracker::Complete(size_t slot, uint8_t result)
+{
+    Entry &entry = Entries[slot];
+    entry.Pending = false;
+    entry.Result = result;
+    entry.CompletedMillis = Clock->Millis();
+    unsigned long latency = entry.CompletedMillis - entry.ReceivedMillis;
+
+    Stats.Results[result]++;
+    if (result == SETRACKED_CONFIRMED) LatencyMillis.Observe(latency);
+    QueueReport(slot, result, latency);
+}
+
+void SEWriteTracker::QueueReport(size_t slot, uint8_t result, unsigned long latencyMillis)
+{
+    if (ReportCount == SEWRITETRACKER_REPORTS)
+    {
+        ReportHead = (ReportHead + 1) % SEWRITETRACKER_REPORTS;
+        ReportCount--;
+        Stats.ReportsDropped++;
+    }
+
+    SEWriteReport &report = Reports[(ReportHead + ReportCount) % SEWRITETRACKER_REPORTS];
+    report.RegisterId = SERegisterMap::Get(slot).Id;
+    memcpy(report.Id, Entries[slot].Id, sizeof(report.Id));
+    memcpy(report.Value, Entries[slot].Value, sizeof(report.Value));
+    report.Result = result;
+    report.LatencyMillis = latencyMillis;
+    ReportCount++;
+}
+
+const SEWriteReport *SEWriteTracker::TakeReport()
+{
+    if (ReportCount == 0) return NULL;
+    const SEWriteReport *report = &Reports[ReportHead];
+    ReportHead = (ReportHead + 1) % SEWRITETRACKER_REPORTS;
+    ReportCount--;
+    return report;
+}
+
+const char *SEWriteTracker::ResultName(uint8_t result)
+{
+    static const char *const names[] = {"confirmed", "failed", "superseded", "rejected", "timeout"};
+    return result <= SETRACKED_TIMEOUT ? names[result] : "unknown";
+}
@@ -4,270 +4,377 @@
 */
 
 #include "WebInterface.h"
+#include "JsonWriter.h"
 #include "Logging.h"
+#include "SEAreaNames.h"
+#include "WebPage.h"
 #include <ESP8266WiFi.h>
 
-#define AREA_LEVEL_START 173
-#define AREA_LEVEL_END 178
-#define LABEL_REGISTER_START 78
-#define LABEL_REGISTER_END 83
-#define MAX_LEVEL 6
-
-const int NAME_MAPPING_COUNT = 70;
-const char* NAME_MAPPING[NAME_MAPPING_COUNT] = {
-    "", // 0
-    "Bereich 1", // 1
-    "Bereich 2", // 2
-    "Bereich 3", // 3
-    "Bereich 4", // 4
-    "Bereich 5", // 5
-    "Bereich 6", // 6
-    "Wohnzimmer", // 7
-    "Wohnzimmer 1", // 8
-    "Wohnzimmer 2", // 9
-    "Esszimmer", // 10
-    "Esszimmer 1", // 11
-    "Esszimmer 2", // 12
-    "Schlafzimmer", // 13
-    "Schlafzimmer 1", // 14
-    "Schlafzimmer 2", // 15
-    "Kinderzimmer", // 16
-    "Kinderzimmer 1", // 17
-    "Kinderzimmer 2", // 18
-    "Kinderzimmer 3", // 19
-    "Kinderzimmer 4", // 20
-    "Küche", // 21
-    "Küche 1", // 22
-    "Küche 2", // 23
-    "Bad", // 24
-    "Master Bad", // 25
-    "Gäste Bad", // 26
-    "WC", // 27
-    "Gäste WC", // 28
-    "Arbeitszimmer", // 29
-    "Arbeitszimmer 1", // 30
-    "Arbeitszimmer 2", // 31
-    "Hobbyraum", // 32
-    "Mehrzweckraum", // 33
-    "Abstellraum", // 34
-    "Kellerraum", // 35
-    "Kellerraum 1", // 36
-    "Kellerraum 2", // 37
-    "Kellerraum 3", // 38
-    "Dachboden", // 39
-    "Dachboden 1", // 40
-    "Dachboden 2", // 41
-    "Dachboden 3", // 42
-    "Büro", // 43
-    "Büro 1", // 44
-    "Büro 2", // 45
-    "Büro 3", // 46
-    "Büro 4", // 47
-    "Büro 6", // 48
-    "Chef Büro", // 49
-    "Abtl.Ltr. Büro", // 50
-    "Büro EK", // 51
-    "Büro AB", // 52
-    "Büro Entw.", // 53
-    "Büro Konstr.", // 54
-    "Büro Buchh.", // 55
-    "Speiseraum", // 56
-    "Besp. Raum", // 57
-    "Besp. Raum 1", // 58
-    "Besp. Raum 2", // 59
-    "Besp. Raum 3", // 60
-    "Louge", // 61
-    "Bibliothek", // 62
-    "Fitnessraum", // 63
-    "Wintergarten", // 64
-    "Bastelraum", // 65
-    "Ankleidez.", // 66
-    "HWR", // 67
-    "leer" // 68
-};
-
-WebInterface::WebInterface(SEController* sec) : server(80), SEC(sec) {
-    for (int i = 0; i < FAN_COUNT; i++) {
-        fanLevels[i] = 0;
-        fanLabels[i] = "Lüfter " + String(i + 1);
-    }
+WebInterface::WebInterface(SEController* sec, SECommandArbiter* arbiter, int port) : server(port), SEC(sec), arbiter(arbiter) {
+    source = arbiter->AddSource("web", WEB_SOURCE_PRECEDENCE);
 }
 
 void WebInterface::begin() {
-    server.on("/", std::bind(&WebInterface::handleRoot, this));
-    server.on("/setlevel", HTTP_POST, std::bind(&WebInterface::handleSetLevel, this));
-    server.on("/levels", HTTP_GET, std::bind(&WebInterface::handleGetLevels, this));
-    server.on("/restart", HTTP_POST, std::bind(&WebInterface::handleRestart, this));
-    server.begin();
+    using namespace std::placeholders;
+    server.On("/", HTTP_METHOD_ANY, std::bind(&WebInterface::handleRoot, this, _1));
+    server.On("/setlevel", HTTP_METHOD_POST, std::bind(&WebInterface::handleSetLevel, this, _1));
+    server.On("/levels", HTTP_METHOD_GET, std::bind(&WebInterface::handleGetLevels, this, _1));
+    server.On("/restart", HTTP_METHOD_POST, std::bind(&WebInterface::handleRestart, this, _1));
+    server.On("/scan", HTTP_METHOD_GET, std::bind(&WebInterface::handleGetScan, this, _1));
+    server.On("/scan", HTTP_METHOD_POST, std::bind(&WebInterface::handleSetScan, this, _1));
+    server.On("/events", HTTP_METHOD_GET, std::bind(&WebInterface::handleEvents, this, _1));
+    server.On("/stats", HTTP_METHOD_GET, std::bind(&WebInterface::handleStats, this, _1));
+    server.On("/trace", HTTP_METHOD_GET, std::bind(&WebInterface::handleGetTrace, this, _1));
+    server.On("/trace", HTTP_METHOD_POST, std::bind(&WebInterface::handleSetTrace, this, _1));
+    server.On("/metrics", HTTP_METHOD_GET, std::bind(&WebInterface::handleMetrics, this, _1));
+    server.On("/language", HTTP_METHOD_POST, std::bind(&WebInterface::handleSetLanguage, this, _1));
+
+    // Only headers named here are kept by the server.
+    server.CollectHeader("If-None-Match");
+    server.Begin();
 
-    SEC->AddOnRegisterChanged(std::bind(&WebInterface::onRegisterChanged, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    SEC->AddRegisterListener(this);
 }
 
 void WebInterface::loop() {
-    server.handleClient();
+    server.Poll();
+    flushEvents();
+    // The answer to /restart goes out first.
+    if (restartPending && millis() - restartMillis >= WEB_RESTART_DELAY_MILLIS) {
+        ESP.restart();
+    }
+}
+
+void WebInterface::OnRegisterChanged(SEController* controller, int registerId, const char* value) {
+    // Runs inside SEController::Poll(); the network write is left to loop().
+    if (registerId >= SEAREA_LEVEL_REGISTER && registerId < SEAREA_LEVEL_REGISTER + FAN_COUNT) {
+        pendingLevels |= 1 << (registerId - SEAREA_LEVEL_REGISTER);
+    } else if (registerId >= SEAREA_LABEL_REGISTER && registerId < SEAREA_LABEL_REGISTER + FAN_COUNT) {
+        pendingLabels |= 1 << (registerId - SEAREA_LABEL_REGISTER);
+    }
 }
 
-void WebInterface::handleRoot() {
-    String html = "<!DOCTYPE html><html><head><meta charset=\"UTF-8\">";
-    html += "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">";
-    html += "<title>Lüftersteuerung</title>";
-    html += "<style>";
-
-    html += "body { font-family: Arial, sans-serif; background-color: #f0f0f0; margin: 0; padding: 20px; }";
-    html += "h1 { color: #333; }";
-    html += ".container { max-width: 600px; margin: 0 auto; background-color: #fff; padding: 20px; border-radius: 5px; }";
-    html += ".fan-control { margin-bottom: 25px; }";
-    html += ".fan-label { font-size: 16px; color: #555; margin-bottom: 5px; }";
-    html += ".slider { -webkit-appearance: none; width: 100%; height: 15px; border-radius: 5px; background: #d3d3d3; outline: none; opacity: 0.7; transition: opacity .2s; }";
-    html += ".slider:hover { opacity: 1; }";
-    html += ".slider::-webkit-slider-thumb { -webkit-appearance: none; appearance: none; width: 25px; height: 25px; border-radius: 50%; background: #4CAF50; cursor: pointer; }";
-    html += ".slider::-moz-range-thumb { width: 25px; height: 25px; border-radius: 50%; background: #4CAF50; cursor: pointer; }";
-    html += ".fan-status { font-size: 14px; color: #777; margin-top: 5px; }";
-    html += ".restart-button { margin-top: 20px; padding: 10px 20px; background-color: #f44336; color: #fff; border: none; border-radius: 5px; cursor: pointer; }";
-    html += ".restart-button:hover { background-color: #d32f2f; }";
-    html += "</style>";
-    html += "</head><body>";
-    html += "<div class=\"container\">";
-    html += "<h1>Lüftersteuerung</h1>";
-
-    html += "<div id=\"fans\"></div>";
-
-    html += "<script>";
-    html += "function updateFans() {";
-    html += "fetch('/levels').then(response => response.json()).then(data => {";
-    html += "let fansDiv = document.getElementById('fans');";
-    html += "fansDiv.innerHTML = '';";
-    html += "for (let i = 0; i < data.length; i++) {";
-    html += "let fan = data[i];";
-    html += "let fanDiv = document.createElement('div');";
-    html += "fanDiv.className = 'fan-control';";
-    html += "let label = document.createElement('div');";
-    html += "label.className = 'fan-label';";
-    html += "label.innerText = fan.label;";
-    html += "fanDiv.appendChild(label);";
-    html += "let slider = document.createElement('input');";
-    html += "slider.type = 'range';";
-    html += "slider.min = '0';";
-    html += "slider.max = fan.maxLevel;";
-    html += "slider.value = fan.level;";
-    html += "slider.className = 'slider';";
-    html += "slider.onchange = function() { setLevel(i, this.value); };";
-    html += "fanDiv.appendChild(slider);";
-    html += "let status = document.createElement('div');";
-    html += "status.className = 'fan-status';";
-    html += "status.innerHTML = 'Stufe: ' + fan.level;";
-    html += "fanDiv.appendChild(status);";
-    html += "fansDiv.appendChild(fanDiv);";
-    html += "}";
-    html += "});";
-    html += "}";
-
-    html += "function setLevel(index, level) {";
-    html += "fetch('/setlevel', { method: 'POST', headers: { 'Content-Type': 'application/x-www-form-urlencoded' }, body: 'fan=' + index + '&level=' + level }).then(() => {";
-    html += "updateFans();";
-    html += "});";
-    html += "}";
-
-    html += "function restartDevice() {";
-    html += "if (confirm('Möchten Sie das Gerät wirklich neu starten?')) {";
-    html += "fetch('/restart', { method: 'POST' }).then(() => {";
-    html += "alert('Gerät wird neu gestartet...');";
-    html += "});";
-    html += "}";
-    html += "}";
-
-    html += "setInterval(updateFans, 1000);";
-    html += "window.onload = function() {";
-    html += "updateFans();";
-    html += "setTimeout(updateFans, 500);";
-    html += "};";
-    html += "</script>";
-
-    html += "</div>";
-    html += "</body></html>";
-    server.send(200, "text/html", html);
+// Server-Sent Events: the connection is kept open and every level or label
+// change is pushed as one "data:" line holding only the changed fields.
+void WebInterface::handleEvents(HttpConnection& request) {
+    if (server.GetStreamCount() >= EVENT_CLIENTS_MAX) {
+        eventStats.Rejected++;
+        request.Send(503, "text/plain", "Too many clients");
+        return;
+    }
+    request.BeginEventStream();
+    eventStats.Accepted++;
 }
 
-void WebInterface::handleSetLevel() {
-    if (server.hasArg("fan") && server.hasArg("level")) {
-        int index = server.arg("fan").toInt();
-        int level = server.arg("level").toInt();
-        if (index >= 0 && index < FAN_COUNT) {
-            if (level >= 0 && level <= MAX_LEVEL) {
-                fanLevels[index] = level;
-
-                int registerId = AREA_LEVEL_START + index;
-                char valueStr[8];
-                snprintf(valueStr, sizeof(valueStr), "%d", level);
-                SEC->SendMessageResponse(registerId, valueStr);
-            }
+void WebInterface::sendEvent(const char* data, size_t length) {
+    // The server drops a browser that cannot take the event; it reconnects and
+    // rebuilds the page from /levels.
+    eventStats.EventsSent += server.Broadcast(data, length);
+}
+
+void WebInterface::flushEvents() {
+    char event[128];
+    char label[SEAREA_NAME_LENGTH];
+    for (int i = 0; i < FAN_COUNT && (pendingLevels | pendingLabels) != 0; i++) {
+        uint8_t bit = 1 << i;
+        if (!((pendingLevels | pendingLabels) & bit)) continue;
+
+        JsonWriter json(event, sizeof(event));
+        json.Raw("data: ").BeginObject().Member("index", i);
+        if (pendingLevels & bit) {
+            json.Member("level", getFanLevel(i));
+        }
+        if (pendingLabels & bit) {
+            json.Member("label", getFanLabel(i, label, sizeof(label)));
+        }
+        json.EndObject().Raw("\n\n");
+        if (!json.HasOverflowed()) {
+            sendEvent(json.c_str(), json.GetLength());
         }
+        pendingLevels &= ~bit;
+        pendingLabels &= ~bit;
+    }
+
+    // A comment line every now and then detects clients that went away silently.
+    if (millis() - lastKeepAliveMillis >= EVENT_KEEPALIVE_MILLIS) {
+        lastKeepAliveMillis = millis();
+        sendEvent(":\n\n", 3);
     }
-    server.send(200, "text/plain", "OK");
 }
 
-void WebInterface::handleGetLevels() {
-    String json = "[";
-    for (int i = 0; i < FAN_COUNT; i++) {
-        if (i > 0) json += ",";
-        json += "{";
-        json += "\"index\":" + String(i) + ",";
-        json += "\"level\":" + String(fanLevels[i]) + ",";
-        json += "\"maxLevel\":" + String(MAX_LEVEL) + ",";
-        json += "\"label\":\"" + escapeJsonString(fanLabels[i]) + "\"";
-        json += "}";
+void WebInterface::handleStats(HttpConnection& request) {
+    request.SendItems(200, "application/json", [this](JsonWriter& json, uint32_t item) {
+        return writeStats(json, item);
+    });
+}
+
+bool WebInterface::writeStats(JsonWriter& json, uint32_t item) {
+    const HttpServerStats& http = server.GetStats();
+    switch (item) {
+    case 0:
+        json.BeginObject();
+        json.Key("events").BeginObject()
+            .Member("clients", (unsigned long)server.GetStreamCount())
+            .Member("maxClients", EVENT_CLIENTS_MAX)
+            .Member("accepted", eventStats.Accepted)
+            .Member("rejected", eventStats.Rejected)
+            .Member("dropped", http.StreamsDropped)
+            .Member("eventsSent", eventStats.EventsSent)
+            .EndObject();
+        json.Key("page").BeginObject()
+            .Member("bytes", WEB_PAGE_LENGTH)
+            .Member("uncompressedBytes", WEB_PAGE_UNCOMPRESSED_LENGTH)
+            .Member("requests", pageStats.Requests)
+            .Member("notModified", pageStats.NotModified)
+            .EndObject();
+        return true;
+    case 1:
+        json.Key("http").BeginObject()
+            .Member("connections", (unsigned long)server.GetConnectionCount())
+            .Member("maxConnections", HTTP_CONNECTIONS_MAX)
+            .Member("bufferBytes", (unsigned long)sizeof(HttpConnection))
+            .Member("heapPerConnection", http.HeapPerConnection)
+            .Member("accepted", http.Accepted)
+            .Member("rejected", http.Rejected)
+            .Member("requests", http.Requests)
+            .Member("keepAliveRequests", http.KeepAliveRequests)
+            .Member("timeouts", http.Timeouts)
+            .Member("badRequests", http.BadRequests)
+            .Member("lastResponseMicros", http.LastResponseMicros)
+            .Member("maxResponseMicros", http.MaxResponseMicros)
+            .EndObject();
+        return true;
+    case 2:
+        json.Member("language", SEAreaLanguageCode(SEGetAreaLanguage()))
+            .Member("freeHeap", ESP.getFreeHeap());
+        json.EndObject();
+        return true;
+    default:
+        return false;
     }
-    json += "]";
-    server.send(200, "application/json", json);
 }
 
-void WebInterface::onRegisterChanged(SEController* seController, int registerId, const char* value) {
-    if (registerId >= AREA_LEVEL_START && registerId <= AREA_LEVEL_END) {
-        int index = registerId - AREA_LEVEL_START;
-        if (index >= 0 && index < FAN_COUNT) {
-            fanLevels[index] = atoi(value);
-        }
+// The page is web/index.html, gzip-compressed into flash at build time by
+// scripts/embed_web.py. Browsers revalidate it with If-None-Match on every
+// visit and get an empty 304 as long as the firmware is unchanged.
+void WebInterface::handleRoot(HttpConnection& request) {
+    pageStats.Requests++;
+    if (strcmp(request.GetHeader("If-None-Match"), WEB_PAGE_ETAG) == 0) {
+        pageStats.NotModified++;
+        request.Send(304, NULL, NULL, "ETag: " WEB_PAGE_ETAG "\r\nCache-Control: no-cache\r\n");
+    } else {
+        request.SendFlash(200, "text/html", (PGM_P)WEB_PAGE_GZ, WEB_PAGE_LENGTH,
+                          "ETag: " WEB_PAGE_ETAG "\r\nCache-Control: no-cache\r\nContent-Encoding: gzip\r\n");
+    }
+}
+
+// 400 for a missing or out-of-range fan or level, 409 when the arbiter keeps
+// the write from the bus (register held by MQTT, or the queue is full).
+void WebInterface::handleSetLevel(HttpConnection& request) {
+    if (!request.HasArg("fan") || !request.HasArg("level")) {
+        request.Send(400, "text/plain", "fan and level required");
+        return;
+    }
+    int index = request.GetArgNumber("fan");
+    int level = request.GetArgNumber("level");
+    if (index < 0 || index >= FAN_COUNT || level < 0 || level > SEAREA_MAX_LEVEL) {
+        request.Send(400, "text/plain", "fan or level out of range");
+        return;
+    }
+    int registerId = SEAREA_LEVEL_REGISTER + index;
+    char valueStr[8];
+    snprintf(valueStr, sizeof(valueStr), "%d", level);
+    if (!arbiter->Write(source, registerId, valueStr)) {
+        request.Send(409, "text/plain", "not applied, register held or queue full");
+        return;
     }
-    else if (registerId >= LABEL_REGISTER_START && registerId <= LABEL_REGISTER_END) {
-        int index = registerId - LABEL_REGISTER_START;
-        if (index >= 0 && index < FAN_COUNT) {
-            int nameIndex = atoi(value);
-            if (nameIndex >= 0 && nameIndex < NAME_MAPPING_COUNT) {
-                fanLabels[index] = NAME_MAPPING[nameIndex];
-            } else {
-                fanLabels[index] = "Unbekannt";
-            }
+    request.Send(200, "text/plain", "OK");
+}
+
+// lang=de|en switches the room names for all frontends; open pages get the
+// new labels as events.
+void WebInterface::handleSetLanguage(HttpConnection& request) {
+    char code[4];
+    SEAreaLanguage language;
+    if (!request.GetArg("lang", code, sizeof(code)) || !SEParseAreaLanguage(code, language)) {
+        request.Send(400, "text/plain", "lang must be de or en");
+        return;
+    }
+    if (language != SEGetAreaLanguage()) {
+        SESetAreaLanguage(language);
+        pendingLabels = (1 << FAN_COUNT) - 1;
+        const char* saved = SEAreaLanguageCode(language);
+        if (languageStorage != NULL && !languageStorage->Save((const uint8_t*)saved, strlen(saved))) {
+            LOG_ERROR("Language %s not saved", saved);
         }
     }
+    request.Send(200, "text/plain", "OK");
 }
 
-void WebInterface::handleRestart() {
-    server.send(200, "text/plain", "Gerät wird neu gestartet...");
-    delay(100);
-    ESP.restart();
+void WebInterface::setLanguageStorage(SEStorage* storage) {
+    languageStorage = storage;
+    char code[4];
+    size_t length = storage->Load((uint8_t*)code, sizeof(code) - 1);
+    code[length] = '\0';
+    SEAreaLanguage language;
+    if (length > 0 && SEParseAreaLanguage(code, language)) {
+        SESetAreaLanguage(language);
+        pendingLabels = (1 << FAN_COUNT) - 1;
+    }
 }
 
-String WebInterface::escapeJsonString(const String& input) {
-    String output = "";
-    for (unsigned int i = 0; i < input.length(); i++) {
-        char c = input.charAt(i);
-        if (c == '\"') {
-            output += "\\\"";
-        } else if (c == '\\') {
-            output += "\\\\";
-        } else if (c == '\b') {
-            output += "\\b";
-        } else if (c == '\f') {
-            output += "\\f";
-        } else if (c == '\n') {
-            output += "\\n";
-        } else if (c == '\r') {
-            output += "\\r";
-        } else if (c == '\t') {
-            output += "\\t";
-        } else {
-            output += c;
+void WebInterface::handleGetLevels(HttpConnection& request) {
+    request.SendItems(200, "application/json", [this](JsonWriter& json, uint32_t item) {
+        return writeLevels(json, item);
+    });
+}
+
+// [ , one object per area, ]
+bool WebInterface::writeLevels(JsonWriter& json, uint32_t item) {
+    char label[SEAREA_NAME_LENGTH];
+    if (item == 0) {
+        json.BeginArray();
+    } else if (item <= FAN_COUNT) {
+        int i = item - 1;
+        json.BeginObject()
+            .Member("index", i)
+            .Member("level", getFanLevel(i))
+            .Member("maxLevel", SEAREA_MAX_LEVEL)
+            .Member("label", getFanLabel(i, label, sizeof(label)))
+            .EndObject();
+    } else if (item == FAN_COUNT + 1) {
+        json.EndArray();
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Starts a register discovery scan (first, last, optional continuous=1) or ends it (stop).
+void WebInterface::handleSetScan(HttpConnection& request) {
+    if (request.HasArg("stop")) {
+        SEC->StopScan();
+    } else if (request.HasArg("first") && request.HasArg("last")) {
+        SEC->StartScan(request.GetArgNumber("first"), request.GetArgNumber("last"), request.GetArgNumber("continuous") == 1);
+    } else {
+        request.Send(400, "text/plain", "first and last required");
+        return;
+    }
+    request.Send(200, "text/plain", "OK");
+}
+
+void WebInterface::setMetrics(SEMetrics* metrics, const SEUnitScheduler* units) {
+    this->metrics = metrics;
+    this->units = units;
+}
+
+// One line per item; the values of a line are current when it is written.
+void WebInterface::handleMetrics(HttpConnection& request) {
+    if (metrics == NULL) {
+        request.Send(404, "text/plain", "metrics disabled");
+        return;
+    }
+    request.SendItems(200, "text/plain; version=0.0.4", [this](JsonWriter& text, uint32_t item) {
+        return metrics->WritePrometheusLine(text, *units, item);
+    });
+}
+
+// Plain text, one entry per line: sequence micros event register value detail.
+void WebInterface::handleGetTrace(HttpConnection& request) {
+    uint32_t head = SEC->GetTrace().GetHead();
+    request.SendItems(200, "text/plain", [this, head](JsonWriter& text, uint32_t item) {
+        return writeTrace(text, item, head);
+    });
+}
+
+// Item 0 is the state, then one per entry up to head, as far as the trace still holds them.
+bool WebInterface::writeTrace(JsonWriter& text, uint32_t item, uint32_t head) {
+    SETrace& trace = SEC->GetTrace();
+    if (item == 0) {
+        text.Printf("# %s%s\n", trace.IsFrozen() ? "frozen" : "running", trace.IsArmed() ? ", armed" : "");
+        return true;
+    }
+    if (item > SETRACE_CAPACITY) return false;
+
+    // Wraps below 0 while the trace is not full yet; Get() rejects those.
+    uint32_t sequence = head - SETRACE_CAPACITY + item - 1;
+    SETraceEntry entry;
+    if (trace.Get(sequence, entry)) {
+        char line[SETRACE_LINE_LENGTH];
+        SETrace::Format(sequence, entry, line, sizeof(line));
+        text.Raw(line);
+    }
+    return true;
+}
+
+// action=arm freezes the trace shortly after the next failed request, resume and clear restart it.
+void WebInterface::handleSetTrace(HttpConnection& request) {
+    char action[8] = "";
+    request.GetArg("action", action, sizeof(action));
+    SETrace& trace = SEC->GetTrace();
+    if (strcmp(action, "arm") == 0) {
+        trace.Arm();
+    } else if (strcmp(action, "resume") == 0) {
+        trace.Resume();
+    } else if (strcmp(action, "clear") == 0) {
+        trace.Clear();
+    } else {
+        request.Send(400, "text/plain", "action must be arm, resume or clear");
+        return;
+    }
+    request.Send(200, "text/plain", "OK");
+}
+
+void WebInterface::handleGetScan(HttpConnection& request) {
+    size_t count = SEC->GetScanner().GetCount();
+    request.SendItems(200, "application/json", [this, count](JsonWriter& json, uint32_t item) {
+        return writeScan(json, item, count);
+    });
+}
+
+// The counters, then one item per result found when the request came in.
+bool WebInterface::writeScan(JsonWriter& json, uint32_t item, size_t count) {
+    SERegisterScanner& scanner = SEC->GetScanner();
+    if (item == 0) {
+        json.BeginObject()
+            .Member("active", scanner.IsActive())
+            .Member("registersPerSecond", scanner.GetRegistersPerSecond(millis()), 1)
+            .Member("requests", scanner.Stats.Requests)
+            .Member("answers", scanner.Stats.Answers)
+            .Member("timeouts", scanner.Stats.Timeouts)
+            .Member("sweeps", scanner.Stats.Sweeps);
+        json.Key("registers").BeginArray();
+    } else if (item <= count) {
+        // A new scan may have cleared the results in the meantime.
+        if (item - 1 < scanner.GetCount()) {
+            const SEScanResult& result = scanner.GetResult(item - 1);
+            json.BeginObject()
+                .Member("register", result.RegisterId)
+                .Member("value", (const char*)result.Value)
+                .Member("reads", result.Reads)
+                .Member("changes", result.Changes)
+                .Member("lastChangeMillis", result.LastChangeMillis)
+                .EndObject();
         }
+    } else if (item == count + 1) {
+        json.EndArray().EndObject();
+    } else {
+        return false;
     }
-    return output;
+    return true;
+}
+
+int WebInterface::getFanLevel(int index) {
+    const char* value = SEC->GetRegisterValue(SEAREA_LEVEL_REGISTER + index);
+    return value != NULL ? atoi(value) : 0;
+}
+
+const char* WebInterface::getFanLabel(int index, char* buffer, size_t size) {
+    return SEAreaLabel(*SEC, index, buffer, size);
+}
+
+void WebInterface::handleRestart(HttpConnection& request) {
+    request.Send(200, "text/plain", "Gerät wird neu gestartet...");
+    restartPending = true;
+    restartMillis = millis();
 }
@@ -4,8 +4,16 @@
 */
 
 #include <ESP8266WiFi.h>
+#include <LittleFS.h>
 #include "SEController.h"
+#include "ArduinoPlatform.h"
+#include "ConnectionManager.h"
+#include "SECommandArbiter.h"
+#include "HardwareUartTransport.h"
 #include "MqttBridge.h"
+#include "SECacheStore.h"
+#include "SEMetrics.h"
+#include "SEUnitScheduler.h"
 #include "Logging.h"
 #include "WebInterface.h"
 
@@ -16,45 +24,107 @@
 #define MQTT_HOST "nodered"
 #define MQTT_PORT 1883
 
-SEController *SEC;
-MqttBridge *MQTT;
-// WebInterface *WebUI;
+// The first SEC-Touch is served by UART0 on D7 (RX) / D8 (TX). Define
+// SEC_SOFTWARE_SERIAL to keep the original SoftwareSerial wiring on D1/D2.
+// #define SEC_SOFTWARE_SERIAL
+
+struct UnitConfig
+{
+    const char *Name;  // MQTT topic prefix, Prometheus unit label and client id suffix
+    int8_t RxPin;      // -1: the first unit on UART0 (or D1/D2 with SEC_SOFTWARE_SERIAL)
+    int8_t TxPin;
+};
+
+// One entry per SEC-Touch; further units run on SoftwareSerial, which at
+// 28800 baud leaves room for about three ports next to the hardware UART.
+// D5/D6 are free in both wirings; D1/D2 only without SEC_SOFTWARE_SERIAL.
+static const UnitConfig Units[] = {
+    {"airsystem", -1, -1},
+    // {"airsystem-2", D5, D6},
+    // {"airsystem-3", D1, D2},
+};
+#define UNIT_COUNT (sizeof(Units) / sizeof(Units[0]))
+static_assert(UNIT_COUNT <= SEUNITSCHEDULER_MAX_UNITS, "more units than SEUnitScheduler can poll");
+
+SEController *SEC[UNIT_COUNT];
+MqttBridge *MQTT[UNIT_COUNT];
+SECacheStore *Store[UNIT_COUNT];
+SEUnitScheduler *Scheduler;
+WebInterface *WebUI;
+ConnectionManager *Connection;
+SEMetrics Metrics;
+
+static SETransport *CreateTransport(const UnitConfig &unit)
+{
+    if (unit.RxPin >= 0) return new SoftwareSerialTransport(unit.RxPin, unit.TxPin, SECONTROLLER_BAUD);
+#ifdef SEC_SOFTWARE_SERIAL
+    return new SoftwareSerialTransport(D1, D2, SECONTROLLER_BAUD);
+#else
+    return new HardwareUartTransport(SECONTROLLER_BAUD);
+#endif
+}
 
 void setup()
 {
-    Serial.begin(115200);
-    WiFi.hostname(HOSTNAME);
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-    while (WiFi.status() != WL_CONNECTED)
+#if LOG_LEVEL > LOG_LEVEL_NONE
+    // Log output goes to the TX-only UART1 on D4, the controller keeps UART0.
+    Serial1.begin(115200);
+#endif
+    // Holds the register cache of every unit; formatted on first use.
+    bool storageMounted = LittleFS.begin();
+    SEClock *clock = new ArduinoClock();
+    Scheduler = new SEUnitScheduler(clock);
+    // WiFi and MQTT come up in the background; the controllers are served from the first loop().
+    Connection = new ConnectionManager(HOSTNAME, WIFI_SSID, WIFI_PASSWORD);
+
+    for (size_t unit = 0; unit < UNIT_COUNT; unit++)
     {
-        delay(500);
-        Log("Attempting to connect to WiFi...");
-    }
-    WiFi.setAutoReconnect(true);
-    WiFi.persistent(true);
-    Log("---- Setup: WiFi connected ----");
-
-    SEC = new SEController(D1, D2);
-    MQTT = new MqttBridge(MQTT_HOST, MQTT_PORT, SEC);
-    // WebUI = new WebInterface(SEC);
-    // WebUI->begin();
-}
+        SEC[unit] = new SEController(CreateTransport(Units[unit]), clock);
+        // Last known levels and labels are served from the first loop(); the file follows the position in Units.
+        char path[16];
+        snprintf(path, sizeof(path), "/cache-%u.bin", (unsigned)unit);
+        Store[unit] = new SECacheStore(SEC[unit], new LittleFSStorage(path), clock);
+        if (storageMounted) Store[unit]->Restore();
+        Scheduler->Add(Units[unit].Name, SEC[unit]);
+        SECommandArbiter *arbiter = new SECommandArbiter(SEC[unit], clock);
+
+        char clientId[MQTT_CLIENT_ID_LENGTH];
+        snprintf(clientId, sizeof(clientId), "%s-%s", HOSTNAME, Units[unit].Name);
+        MQTT[unit] = new MqttBridge(MQTT_HOST, MQTT_PORT, SEC[unit], arbiter);
+        MQTT[unit]->SetClientId(clientId);
+        MQTT[unit]->SetTopicPrefix(Units[unit].Name);
+        MQTT[unit]->SetMetrics(&Metrics);
+        Connection->AddMqttBridge(MQTT[unit]);
 
-void checkWiFiConnection() {
-    if (WiFi.status() != WL_CONNECTED) {
-        Log("WiFi disconnected, attempting to reconnect...");
-        WiFi.reconnect();
-        while (WiFi.status() != WL_CONNECTED) {
-            delay(500);
-            Log("Reconnecting to WiFi...");
+        // The local web interface controls the first unit.
+        if (unit == 0)
+        {
+            WebUI = new WebInterface(SEC[unit], arbiter);
+            WebUI->begin();
+            WebUI->setMetrics(&Metrics, Scheduler);
+            if (storageMounted) WebUI->setLanguageStorage(new LittleFSStorage("/language.txt"));
         }
-        Log("WiFi reconnected.");
     }
 }
 
 void loop()
 {
-    checkWiFiConnection();
-    SEC->Poll();
-    MQTT->Poll(); // alternative: WebUI->loop();
+    unsigned long start = micros();
+
+    // The controllers are polled after each frontend, so the time between two
+    // polls is bounded by the slowest frontend, not by the sum of all.
+    Connection->Poll();
+    Scheduler->Poll();
+    for (size_t unit = 0; unit < UNIT_COUNT; unit++)
+    {
+        MQTT[unit]->Poll();
+        Scheduler->Poll();
+    }
+    WebUI->loop();
+    for (size_t unit = 0; unit < UNIT_COUNT; unit++)
+    {
+        Store[unit]->Poll();
+    }
+
+    Metrics.OnLoop(micros() - start, millis());
 }